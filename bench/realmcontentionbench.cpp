@@ -0,0 +1,227 @@
+#include "realm_p.h"
+#include "wamprouter_p.h"
+#include "wamprouterworker.h"
+#include "wamproutersession.h"
+#include "wamptransport.h"
+#include "random.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <cstdio>
+
+// Publish-path contention benchmark for a realm. Publisher threads run RealmPrivate::publish,
+// the path PUBLISH takes after decoding: atom lookup, subscription snapshot, EVENT encoding
+// and hand-off to each subscriber session's outbound queue. Subscribers are real router
+// sessions draining into a transport that discards what it is given. One writer thread
+// subscribes and unsubscribes at the configured read/write ratio. Prints publications/s and
+// delivered events/s per publisher thread count as JSON.
+
+using namespace QFlow;
+
+namespace {
+
+class NullTransport : public WampTransport
+{
+public:
+    NullTransport() : WampTransport()
+    {
+    }
+    void send(const QByteArray& message, bool /*binary*/) override
+    {
+        _bytes.fetch_add(quint64(message.size()), std::memory_order_relaxed);
+        _messages.fetch_add(1, std::memory_order_relaxed);
+    }
+    void sendBatch(const QList<FrameBatcher::Frame>& frames) override
+    {
+        for(const FrameBatcher::Frame& frame: frames)
+        {
+            _bytes.fetch_add(quint64(frame.size()), std::memory_order_relaxed);
+        }
+        _messages.fetch_add(quint64(frames.size()), std::memory_order_relaxed);
+    }
+    bool writesBatches() const override
+    {
+        return true;
+    }
+    qint64 bytesToWrite() const override
+    {
+        return 0;
+    }
+    QString subprotocol() const override
+    {
+        return KEY_WAMP_MSGPACK_SUB;
+    }
+    QHostAddress peerAddress() const override
+    {
+        return QHostAddress(QHostAddress::LocalHost);
+    }
+    void close() override
+    {
+    }
+    quint64 messages() const
+    {
+        return _messages.load();
+    }
+private:
+    std::atomic<quint64> _bytes{0};
+    std::atomic<quint64> _messages{0};
+};
+
+// QThread::create needs Qt 5.10
+class FunctionThread : public QThread
+{
+public:
+    explicit FunctionThread(std::function<void()> function) : _function(function)
+    {
+    }
+protected:
+    void run() override
+    {
+        _function();
+    }
+private:
+    std::function<void()> _function;
+};
+
+QString topicUri(int topic)
+{
+    return QString("bench.topic.%1").arg(topic);
+}
+
+WampRouterSubscriptionPointer subscribe(RealmPrivate& realm, int topic, WampRouterSession* session)
+{
+    QString uri = topicUri(topic);
+    WampRouterSubscriptionPointer subscription(new WampRouterSubscription(uri, realm._atoms.intern(uri), UriMatch::Exact,
+                                                                          Random::generate(), session));
+    realm.insertSubscription(subscription);
+    return subscription;
+}
+
+QJsonObject run(WampRouterWorker* worker, int threadCount, int topics, int subscribersPerTopic, int readsPerWrite,
+                qint64 durationMs, int payloadSize)
+{
+    RealmPrivate realm;
+    QList<NullTransport*> transports;
+    QList<WampRouterSession*> sessions;
+    for(int s=0; s<subscribersPerTopic; s++)
+    {
+        NullTransport* transport = new NullTransport();
+        transports.append(transport);
+        sessions.append(new WampRouterSession(transport, KEY_WAMP_MSGPACK_SUB, worker));
+    }
+    for(int t=0; t<topics; t++)
+    {
+        for(WampRouterSession* session: sessions) subscribe(realm, t, session);
+    }
+    QStringList uris;
+    for(int t=0; t<topics; t++) uris.append(topicUri(t));
+    QVariantList args{QString(payloadSize, QChar('x'))};
+
+    std::atomic<bool> running(true);
+    std::atomic<quint64> reads(0);
+    std::atomic<quint64> writes(0);
+    QList<QThread*> threads;
+    for(int i=0; i<threadCount; i++)
+    {
+        threads.append(new FunctionThread([&, i]() {
+            quint32 topic = quint32(i);
+            while(running.load(std::memory_order_relaxed))
+            {
+                for(int r=0; r<100; r++)
+                {
+                    topic = topic * 1664525u + 1013904223u;
+                    realm.publish(uris.at(int(topic % quint32(topics))), args);
+                }
+                reads.fetch_add(100, std::memory_order_relaxed);
+            }
+        }));
+    }
+    FunctionThread writer([&]() {
+        int topic = 0;
+        while(running.load(std::memory_order_relaxed))
+        {
+            // pace the writer to one mutation per readsPerWrite publications
+            if(readsPerWrite > 0 && reads.load(std::memory_order_relaxed) < writes.load(std::memory_order_relaxed) * readsPerWrite)
+            {
+                QThread::yieldCurrentThread();
+                continue;
+            }
+            WampRouterSubscriptionPointer subscription = subscribe(realm, topic, sessions.first());
+            realm.takeSubscription(subscription->subscriptionId());
+            topic = (topic + 1) % topics;
+            writes.fetch_add(2, std::memory_order_relaxed);
+        }
+    });
+    quint64 deliveredBefore = 0;
+    for(NullTransport* transport: transports) deliveredBefore += transport->messages();
+    QElapsedTimer timer;
+    timer.start();
+    for(QThread* thread: threads) thread->start();
+    writer.start();
+    QThread::msleep(unsigned(durationMs));
+    running = false;
+    for(QThread* thread: threads) thread->wait();
+    writer.wait();
+    qint64 elapsedNs = timer.nsecsElapsed();
+    quint64 delivered = 0;
+    for(NullTransport* transport: transports) delivered += transport->messages();
+    quint64 dropped = 0;
+    for(WampRouterSession* session: sessions) dropped += session->droppedMessages();
+    qDeleteAll(threads);
+    qDeleteAll(sessions);
+    double seconds = elapsedNs / 1e9;
+    return QJsonObject{{"threads", threadCount}, {"topics", topics},
+                       {"subscribers_per_topic", subscribersPerTopic}, {"payload_size", payloadSize},
+                       {"publications_per_sec", reads.load() / seconds}, {"writes_per_sec", writes.load() / seconds},
+                       {"events_delivered_per_sec", (delivered - deliveredBefore) / seconds},
+                       {"events_dropped", double(dropped)}};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Realm publish path contention benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Measuring time per case in milliseconds.", "ms", "500");
+    QCommandLineOption topicsOption("topics", "Number of topics.", "count", "1000");
+    QCommandLineOption subscribersOption("subscribers", "Subscriber sessions, each subscribed to every topic.", "count", "4");
+    QCommandLineOption ratioOption("reads-per-write", "Approximate publications per table mutation, 0 writes flat out.", "count", "1000");
+    QCommandLineOption payloadOption("payload-size", "Size of the published string argument in bytes.", "bytes", "64");
+    parser.addOption(durationOption);
+    parser.addOption(topicsOption);
+    parser.addOption(subscribersOption);
+    parser.addOption(ratioOption);
+    parser.addOption(payloadOption);
+    parser.process(app);
+    qint64 duration = parser.value(durationOption).toLongLong();
+    int topics = qMax(1, parser.value(topicsOption).toInt());
+    int subscribers = qMax(1, parser.value(subscribersOption).toInt());
+    int ratio = parser.value(ratioOption).toInt();
+    int payloadSize = qMax(0, parser.value(payloadOption).toInt());
+
+    // sessions only need the router settings, no server is started
+    WampRouter router;
+    WampRouterPrivate settings(&router);
+    settings._threadPoolSize = 0;
+    WampRouterWorker worker;
+    worker._router = &settings;
+
+    QJsonArray results;
+    for(int threads=1; threads<=QThread::idealThreadCount(); threads*=2)
+    {
+        results.append(run(&worker, threads, topics, subscribers, ratio, duration, payloadSize));
+    }
+    QJsonObject report{{"benchmark", "wamp_bench_realm_contention"}, {"qt_version", qVersion()},
+                       {"ideal_thread_count", QThread::idealThreadCount()}, {"results", results}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
@@ -0,0 +1,305 @@
+#include "wampmessageserializer.h"
+#include "wampmessage.h"
+#include "wamp_symbols.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QUrl>
+#include <msgpack.hpp>
+#include <sstream>
+#include <atomic>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Round-trips a corpus of representative WAMP frames through every serializer and prints
+// ns/op, bytes/op and allocations/op as JSON, so runs can be diffed across commits.
+// The legacy-* entries reproduce the serialization paths the serializers used to take.
+
+namespace {
+std::atomic<quint64> allocations(0);
+}
+
+// Qt containers allocate with malloc, so on glibc malloc itself is counted. Elsewhere only
+// operator new is seen and allocs_per_op undercounts.
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+void* operator new(size_t size)
+{
+    void* ptr = std::malloc(size ? size : 1);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+#else
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size ? size : 1);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+#endif
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace QFlow;
+
+namespace {
+
+struct Frame
+{
+    QString name;
+    QVariantList message;
+};
+
+QList<Frame> corpus()
+{
+    QList<Frame> frames;
+
+    QVariantMap roles{{"publisher", QVariantMap()}, {"subscriber", QVariantMap()},
+                      {"caller", QVariantMap()}, {"callee", QVariantMap()}};
+    QVariantMap helloDetails{{"roles", roles}, {"authid", "device-0042"},
+                             {"authmethods", QVariantList{"wampcra", "anonymous"}}};
+    frames.append({"hello", {(int)WampMsgCode::HELLO, "realm1", helloDetails}});
+
+    frames.append({"call_small", {(int)WampMsgCode::CALL, 7814135ULL, QVariantMap(), "com.myapp.user.new",
+                                  QVariantList{"johnny", 42}, QVariantMap{{"firstname", "John"}, {"surname", "Doe"}}}});
+
+    QVariantList readings;
+    QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(1500000000123LL, Qt::UTC);
+    for(int i=0; i<8; i++)
+    {
+        readings.append(QVariantMap{{"channel", i}, {"value", 21.5 + i * 0.25}, {"valid", i % 3 != 0},
+                                    {"timestamp", timestamp.addMSecs(i * 250)}});
+    }
+    QVariantMap sensor{{"id", "sensor/7/temperature"}, {"readings", readings},
+                       {"meta", QVariantMap{{"unit", "C"}, {"location", QVariantMap{{"building", "B2"}, {"floor", 3}}}}}};
+    frames.append({"event_nested", {(int)WampMsgCode::EVENT, 5512315355ULL, 4429313566ULL, QVariantMap(),
+                                    QVariantList{sensor}, QVariantMap{{"sequence", 1234}}}});
+
+    QByteArray blob(1024 * 1024, Qt::Uninitialized);
+    for(int i=0; i<blob.size(); i++) blob[i] = char(i * 31);
+    frames.append({"yield_1mb", {(int)WampMsgCode::YIELD, 6131533ULL, QVariantMap(), QVariantList{blob}}});
+    return frames;
+}
+
+// JsonMessageSerializer::serialize before the streaming writer
+QVariant legacyToBase64(const QVariant& var)
+{
+    if((QMetaType::Type)var.type() == QMetaType::QByteArray)
+    {
+        return QVariant(var.toByteArray().toBase64());
+    }
+    else if((QMetaType::Type)var.type() == QMetaType::QVariantList)
+    {
+        QVariantList list = var.toList();
+        for(int i=0; i<list.length(); i++) list[i] = legacyToBase64(list[i]);
+        return QVariant(list);
+    }
+    else if((QMetaType::Type)var.type() == QMetaType::QVariantMap)
+    {
+        QVariantMap map = var.toMap();
+        for(QString key: map.keys()) map[key] = legacyToBase64(map[key]);
+        return QVariant(map);
+    }
+    return var;
+}
+QByteArray legacyJsonSerialize(const QVariantList& arr)
+{
+    QVariant listVarBase64 = legacyToBase64(QVariant(arr));
+    QJsonDocument doc(QJsonArray::fromVariantList(listVarBase64.toList()));
+    return doc.toJson();
+}
+
+// MsgpackMessageSerializer::serialize before packing into QByteArray
+void legacyPack(msgpack::packer<std::stringstream>& o, const QVariant& v)
+{
+    switch((QMetaType::Type)v.type())
+    {
+    case QMetaType::Bool:
+        o.pack(v.toBool());
+        break;
+    case QMetaType::QString:
+        o.pack(v.toString().toStdString());
+        break;
+    case QMetaType::Int:
+        o.pack_int(v.toInt());
+        break;
+    case QMetaType::ULongLong:
+        o.pack_unsigned_long_long(v.toULongLong());
+        break;
+    case QMetaType::Double:
+        o.pack_double(v.toDouble());
+        break;
+    case QMetaType::QByteArray:
+    {
+        QByteArray arr = v.toByteArray();
+        o.pack_bin(arr.length());
+        o.pack_bin_body(arr.data(), arr.length());
+        break;
+    }
+    case QMetaType::QVariantList:
+    {
+        QVariantList list = v.toList();
+        o.pack_array(list.length());
+        for(QVariant var: list) legacyPack(o, var);
+        break;
+    }
+    case QMetaType::QVariantMap:
+    {
+        QVariantMap map = v.toMap();
+        o.pack_map(map.count());
+        for(QString key: map.keys())
+        {
+            o.pack(key.toStdString());
+            legacyPack(o, map[key]);
+        }
+        break;
+    }
+    case QMetaType::QDateTime:
+        o.pack(v.toDateTime().toUTC().toString(Qt::ISODate).toStdString());
+        break;
+    default:
+        o.pack_int(v.toInt());
+    }
+}
+QByteArray legacyMsgpackSerialize(const QVariantList& arr)
+{
+    std::stringstream buffer;
+    msgpack::packer<std::stringstream> packer(buffer);
+    legacyPack(packer, QVariant(arr));
+    return QByteArray::fromStdString(buffer.str());
+}
+
+struct Result
+{
+    QString serializer;
+    QString frame;
+    QString operation;
+    qint64 iterations;
+    double nsPerOp;
+    double bytesPerOp;
+    double allocsPerOp;
+};
+
+// Runs op in batches until minTimeMs has passed; op returns the number of bytes it produced or consumed.
+Result measure(const QString& serializer, const QString& frame, const QString& operation,
+               qint64 minTimeMs, const std::function<int()>& op)
+{
+    op();
+    qint64 iterations = 0;
+    qint64 bytes = 0;
+    quint64 allocs = 0;
+    qint64 elapsed = 0;
+    qint64 batch = 1;
+    QElapsedTimer timer;
+    while(elapsed < minTimeMs * 1000000)
+    {
+        quint64 allocsBefore = allocations.load(std::memory_order_relaxed);
+        timer.start();
+        for(qint64 i=0; i<batch; i++) bytes += op();
+        elapsed += timer.nsecsElapsed();
+        allocs += allocations.load(std::memory_order_relaxed) - allocsBefore;
+        iterations += batch;
+        batch *= 2;
+    }
+    return {serializer, frame, operation, iterations, double(elapsed) / iterations,
+            double(bytes) / iterations, double(allocs) / iterations};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serializer micro-benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption minTimeOption("min-time", "Minimum measuring time per case in milliseconds.", "ms", "200");
+    QCommandLineOption filterOption("filter", "Only run cases whose serializer/frame/operation contains text.", "text");
+    parser.addOption(minTimeOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+    qint64 minTimeMs = parser.value(minTimeOption).toLongLong();
+    QString filter = parser.value(filterOption);
+
+    QList<Result> results;
+    auto run = [&](const QString& serializer, const QString& frame, const QString& operation, const std::function<int()>& op) {
+        if(!filter.isEmpty() && !QString("%1/%2/%3").arg(serializer, frame, operation).contains(filter)) return;
+        results.append(measure(serializer, frame, operation, minTimeMs, op));
+    };
+
+    QList<Frame> frames = corpus();
+    for(const QString& name: WampMessageSerializer::subprotocols())
+    {
+        QScopedPointer<WampMessageSerializer> serializer(WampMessageSerializer::create(name));
+        for(const Frame& frame: frames)
+        {
+            QByteArray encoded = serializer->serialize(frame.message);
+            run(name, frame.name, "serialize", [&]() {
+                return serializer->serialize(frame.message).size();
+            });
+            run(name, frame.name, "deserialize", [&]() {
+                return serializer->deserialize(encoded).size() > 0 ? encoded.size() : 0;
+            });
+            run(name, frame.name, "decode", [&]() {
+                return serializer->decode(encoded) ? encoded.size() : 0;
+            });
+            run(name, frame.name, "decode_passthrough", [&]() {
+                return serializer->decode(encoded, true) ? encoded.size() : 0;
+            });
+        }
+    }
+    for(const Frame& frame: frames)
+    {
+        run("legacy-" + KEY_WAMP_JSON_SUB, frame.name, "serialize", [&]() {
+            return legacyJsonSerialize(frame.message).size();
+        });
+        run("legacy-" + KEY_WAMP_MSGPACK_SUB, frame.name, "serialize", [&]() {
+            return legacyMsgpackSerialize(frame.message).size();
+        });
+    }
+
+    QJsonArray resultArray;
+    for(const Result& result: results)
+    {
+        resultArray.append(QJsonObject{{"serializer", result.serializer}, {"frame", result.frame},
+                                       {"operation", result.operation}, {"iterations", double(result.iterations)},
+                                       {"ns_per_op", result.nsPerOp}, {"bytes_per_op", result.bytesPerOp},
+                                       {"allocs_per_op", result.allocsPerOp}});
+    }
+    QJsonObject report{{"benchmark", "wamp_bench_serializer"}, {"qt_version", qVersion()},
+                       {"min_time_ms", double(minTimeMs)}, {"results", resultArray}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "sessionthreadpool.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSemaphore>
+#include <QFile>
+#include <cstdio>
+
+// Compares the router's two session threading models: one QThread per session against
+// SessionThreadPool. Each simulated session receives queued messages the way
+// WampRouterSessionPrivate receives socket frames. Prints setup time, message throughput,
+// resident memory and teardown time as JSON.
+
+using namespace QFlow;
+
+namespace {
+
+class BenchSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BenchSession(QSemaphore* done) : QObject(), _done(done), _handled(0)
+    {
+    }
+public Q_SLOTS:
+    void onMessage(const QByteArray& message)
+    {
+        _handled += message.size();
+        _done->release();
+    }
+private:
+    QSemaphore* _done;
+    qint64 _handled;
+};
+
+qint64 residentKiB()
+{
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly)) return -1;
+    for(QByteArray line: status.readAll().split('\n'))
+    {
+        if(line.startsWith("VmRSS:")) return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return -1;
+}
+
+QJsonObject run(const QString& mode, int sessionCount, int messages, int poolSize, WampRouter::SessionAssignment assignment)
+{
+    QSemaphore done;
+    QList<BenchSession*> sessions;
+    QList<QThread*> threads;
+    QScopedPointer<SessionThreadPool> pool;
+    qint64 rssBefore = residentKiB();
+
+    QElapsedTimer timer;
+    timer.start();
+    if(poolSize > 0) pool.reset(new SessionThreadPool(poolSize, assignment));
+    for(int i=0; i<sessionCount; i++)
+    {
+        BenchSession* session = new BenchSession(&done);
+        if(pool)
+        {
+            session->moveToThread(pool->acquire(qulonglong(i) * 2654435761ULL));
+        }
+        else
+        {
+            QThread* thread = new QThread();
+            thread->start();
+            session->moveToThread(thread);
+            threads.append(thread);
+        }
+        sessions.append(session);
+    }
+    qint64 setupNs = timer.nsecsElapsed();
+    qint64 rssAfter = residentKiB();
+
+    QByteArray frame(64, 'x');
+    timer.start();
+    for(int m=0; m<messages; m++)
+    {
+        for(BenchSession* session: sessions)
+        {
+            QMetaObject::invokeMethod(session, "onMessage", Qt::QueuedConnection, Q_ARG(QByteArray, frame));
+        }
+    }
+    done.acquire(sessionCount * messages);
+    qint64 deliverNs = timer.nsecsElapsed();
+
+    timer.start();
+    for(BenchSession* session: sessions)
+    {
+        QMetaObject::invokeMethod(session, "deleteLater", Qt::BlockingQueuedConnection);
+        if(pool) pool->release(session->thread());
+    }
+    for(QThread* thread: threads) thread->quit();
+    for(QThread* thread: threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    pool.reset();
+    qint64 teardownNs = timer.nsecsElapsed();
+
+    qint64 total = qint64(sessionCount) * messages;
+    return QJsonObject{{"mode", mode}, {"sessions", sessionCount}, {"threads", poolSize > 0 ? poolSize : sessionCount},
+                       {"messages", double(total)}, {"setup_ms", setupNs / 1e6},
+                       {"ns_per_message", double(deliverNs) / total}, {"messages_per_sec", total / (deliverNs / 1e9)},
+                       {"rss_delta_kib", double(rssAfter - rssBefore)}, {"teardown_ms", teardownNs / 1e6}};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Router session threading benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption sessionsOption("sessions", "Comma separated session counts.", "list", "1000,10000");
+    QCommandLineOption messagesOption("messages", "Messages delivered to every session.", "count", "100");
+    QCommandLineOption poolOption("pool-size", "Threads in the pool, 0 for the number of cores.", "count", "0");
+    QCommandLineOption skipPerSessionOption("skip-per-session", "Only measure the pool.");
+    parser.addOption(sessionsOption);
+    parser.addOption(messagesOption);
+    parser.addOption(poolOption);
+    parser.addOption(skipPerSessionOption);
+    parser.process(app);
+    int messages = parser.value(messagesOption).toInt();
+    int poolSize = parser.value(poolOption).toInt();
+    if(poolSize <= 0) poolSize = QThread::idealThreadCount();
+
+    QJsonArray results;
+    for(QString count: parser.value(sessionsOption).split(',', QString::SkipEmptyParts))
+    {
+        int sessionCount = count.toInt();
+        if(!parser.isSet(skipPerSessionOption))
+        {
+            results.append(run("per_session_thread", sessionCount, messages, 0, WampRouter::LeastLoaded));
+        }
+        results.append(run("pool_least_loaded", sessionCount, messages, poolSize, WampRouter::LeastLoaded));
+        results.append(run("pool_session_hash", sessionCount, messages, poolSize, WampRouter::SessionHash));
+    }
+    QJsonObject report{{"benchmark", "wamp_bench_session_threads"}, {"qt_version", qVersion()},
+                       {"ideal_thread_count", QThread::idealThreadCount()}, {"results", results}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
+
+#include "sessionthreadbench.moc"
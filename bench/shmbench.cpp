@@ -0,0 +1,159 @@
+#include "shmserver.h"
+#include "shmtransport.h"
+#include "rawsocketserver.h"
+#include "rawsockettransport.h"
+#include "wamp_symbols.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QEventLoop>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <cstdio>
+
+// Echoes messages between two processes of this machine, once through the shared memory transport
+// and once through RawSocket over a Unix domain socket. The benchmark starts a copy of itself as the
+// echo server. Each case keeps a fixed number of messages in flight: 1 measures round trip latency,
+// larger windows measure throughput. Prints messages/sec, MB/sec and mean round trip as JSON.
+
+using namespace QFlow;
+
+namespace {
+
+// Server side transports echo every message back
+class EchoServer : public QObject
+{
+    Q_OBJECT
+public:
+    EchoServer(const QString& shmPath, const QString& unixPath) : QObject()
+    {
+        QObject::connect(&_shmServer, &ShmServer::newTransport, this, &EchoServer::echo);
+        QLocalServer::removeServer(shmPath);
+        _shmServer.listen(shmPath);
+        QObject::connect(&_rawSocketServer, &RawSocketServer::newConnection, this, &EchoServer::echo);
+        _rawSocketServer.listen(unixPath);
+    }
+public Q_SLOTS:
+    void echo(WampTransport* transport)
+    {
+        transport->setParent(this);
+        QObject::connect(transport, &WampTransport::messageReceived, transport, [transport](const QByteArray& message) {
+            transport->send(message, true);
+        });
+        QObject::connect(transport, &WampTransport::closed, transport, &QObject::deleteLater);
+    }
+private:
+    ShmServer _shmServer;
+    RawSocketServer _rawSocketServer;
+};
+
+WampTransport* connectTransport(const QString& name, const QString& path, int ringSize)
+{
+    if(name == "shm") return new ShmTransport(path, {KEY_WAMP_MSGPACK_SUB}, ringSize);
+    QLocalSocket* socket = new QLocalSocket();
+    socket->connectToServer(path);
+    return new RawSocketTransport(socket, {KEY_WAMP_MSGPACK_SUB});
+}
+
+QJsonObject run(const QString& name, const QString& path, int ringSize, int messages, int window, int messageSize)
+{
+    QScopedPointer<WampTransport> transport(connectTransport(name, path, ringSize));
+    QEventLoop loop;
+    QByteArray message(messageSize, 'x');
+    int sent = 0;
+    int received = 0;
+    QElapsedTimer timer;
+    QObject::connect(transport.data(), &WampTransport::opened, [&]() {
+        timer.start();
+        for(; sent < window && sent < messages; sent++) transport->send(message, true);
+    });
+    QObject::connect(transport.data(), &WampTransport::messageReceived, [&](const QByteArray&) {
+        received++;
+        if(received == messages) loop.quit();
+        else if(sent < messages)
+        {
+            transport->send(message, true);
+            sent++;
+        }
+    });
+    QObject::connect(transport.data(), &WampTransport::closed, &loop, &QEventLoop::quit);
+    QTimer::singleShot(0, transport.data(), SLOT(open()));
+    loop.exec();
+    qint64 elapsedNs = timer.nsecsElapsed();
+    transport->close();
+    double seconds = elapsedNs / 1e9;
+    return QJsonObject{{"transport", name}, {"window", window}, {"message_bytes", messageSize},
+                       {"messages", received}, {"messages_per_sec", received / seconds},
+                       {"mb_per_sec", double(received) * messageSize / seconds / (1024 * 1024)},
+                       {"mean_round_trip_us", window == 1 ? elapsedNs / 1e3 / qMax(1, received) : 0.0}};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Shared memory against Unix domain socket transport benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption messagesOption("messages", "Messages echoed per case.", "count", "2000");
+    QCommandLineOption windowOption("windows", "Comma separated messages in flight.", "list", "1,16");
+    QCommandLineOption sizeOption("sizes", "Comma separated message sizes in bytes.", "list", "64,65536,4194304");
+    QCommandLineOption ringOption("ring", "Shared memory ring size per direction in bytes.", "bytes",
+                                  QString::number(DEFAULT_SHM_RING_SIZE));
+    QCommandLineOption serveOption("serve", "Run as the echo server of another benchmark process.");
+    parser.addOption(messagesOption);
+    parser.addOption(windowOption);
+    parser.addOption(sizeOption);
+    parser.addOption(ringOption);
+    parser.addOption(serveOption);
+    parser.process(app);
+    // the server is told the benchmark's pid, both derive the socket names from it
+    QString id = parser.isSet(serveOption) ? parser.positionalArguments().value(0) : QString::number(app.applicationPid());
+    QString shmPath = QString("wamp-bench-shm-%1").arg(id);
+    QString unixPath = shmPath + "-unix";
+
+    if(parser.isSet(serveOption))
+    {
+        EchoServer server(shmPath, unixPath);
+        fputs("ready\n", stdout);
+        fflush(stdout);
+        // the benchmark closes our stdin when it is done
+        QSocketNotifier* input = new QSocketNotifier(fileno(stdin), QSocketNotifier::Read, &app);
+        QObject::connect(input, SIGNAL(activated(int)), &app, SLOT(quit()));
+        return app.exec();
+    }
+
+    QProcess server;
+    server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    server.start(app.applicationFilePath(), {"--serve", QString::number(app.applicationPid())});
+    if(!server.waitForReadyRead(10000))
+    {
+        fputs("echo server did not start\n", stderr);
+        return 1;
+    }
+    int messages = parser.value(messagesOption).toInt();
+    int ringSize = parser.value(ringOption).toInt();
+    QJsonArray results;
+    for(QString size: parser.value(sizeOption).split(',', QString::SkipEmptyParts))
+    {
+        for(QString window: parser.value(windowOption).split(',', QString::SkipEmptyParts))
+        {
+            results.append(run("shm", shmPath, ringSize, messages, window.toInt(), size.toInt()));
+            results.append(run("unix", unixPath, ringSize, messages, window.toInt(), size.toInt()));
+        }
+    }
+    server.closeWriteChannel();
+    server.waitForFinished(5000);
+    QJsonObject report{{"benchmark", "wamp_bench_shm"}, {"qt_version", qVersion()}, {"ring_bytes", ringSize},
+                       {"results", results}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
+
+#include "shmbench.moc"
@@ -0,0 +1,137 @@
+#include "rawsocketserver.h"
+#include "rawsockettransport.h"
+#include "websockettransport.h"
+#include "websocketserver.h"
+#include "websocketconnection.h"
+#include "wamp_symbols.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QEventLoop>
+#include <QTcpSocket>
+#include <QTimer>
+#include <cstdio>
+
+// Echoes binary messages over loopback through the WebSocket and the RawSocket transport.
+// Each case keeps a fixed number of messages in flight: 1 measures round trip latency,
+// larger windows measure throughput. Prints messages/sec and mean round trip as JSON.
+
+using namespace QFlow;
+
+namespace {
+
+// Server side transports echo every message back
+class EchoServer : public QObject
+{
+    Q_OBJECT
+public:
+    EchoServer(quint16 webSocketPort, quint16 rawSocketPort) : QObject()
+    {
+        _webSocketServer.setHost("127.0.0.1");
+        _webSocketServer.setPort(webSocketPort);
+        QObject::connect(&_webSocketServer, SIGNAL(newConnection(WebSocketConnection*)), this, SLOT(onWebSocket(WebSocketConnection*)));
+        _webSocketServer.init();
+        QObject::connect(&_rawSocketServer, &RawSocketServer::newConnection, this, &EchoServer::echo);
+        _rawSocketServer.listen(QHostAddress::LocalHost, rawSocketPort);
+    }
+public Q_SLOTS:
+    void onWebSocket(WebSocketConnection* con)
+    {
+        con->selectSubprotocol(KEY_WAMP_MSGPACK_SUB);
+        con->accept(true);
+        echo(new WebSocketTransport(con, this));
+    }
+    void echo(WampTransport* transport)
+    {
+        transport->setParent(this);
+        QObject::connect(transport, &WampTransport::messageReceived, transport, [transport](const QByteArray& message) {
+            transport->send(message, true);
+        });
+    }
+private:
+    WebSocketServer _webSocketServer;
+    RawSocketServer _rawSocketServer;
+};
+
+WampTransport* connectTransport(const QString& name, quint16 port)
+{
+    if(name == "rawsocket")
+    {
+        QTcpSocket* socket = new QTcpSocket();
+        socket->connectToHost(QHostAddress::LocalHost, port);
+        return new RawSocketTransport(socket, {KEY_WAMP_MSGPACK_SUB});
+    }
+    return new WebSocketTransport(QUrl(QString("ws://127.0.0.1:%1").arg(port)), {KEY_WAMP_MSGPACK_SUB});
+}
+
+QJsonObject run(const QString& name, quint16 port, int messages, int window, int messageSize)
+{
+    QScopedPointer<WampTransport> transport(connectTransport(name, port));
+    QEventLoop loop;
+    QByteArray message(messageSize, 'x');
+    int sent = 0;
+    int received = 0;
+    QElapsedTimer timer;
+    QObject::connect(transport.data(), &WampTransport::opened, [&]() {
+        timer.start();
+        for(; sent < window && sent < messages; sent++) transport->send(message, true);
+    });
+    QObject::connect(transport.data(), &WampTransport::messageReceived, [&](const QByteArray&) {
+        received++;
+        if(received == messages) loop.quit();
+        else if(sent < messages)
+        {
+            transport->send(message, true);
+            sent++;
+        }
+    });
+    QObject::connect(transport.data(), &WampTransport::closed, &loop, &QEventLoop::quit);
+    QTimer::singleShot(0, transport.data(), SLOT(open()));
+    loop.exec();
+    qint64 elapsedNs = timer.nsecsElapsed();
+    transport->close();
+    return QJsonObject{{"transport", name}, {"window", window}, {"message_bytes", messageSize},
+                       {"messages", received}, {"messages_per_sec", received / (elapsedNs / 1e9)},
+                       {"mean_round_trip_us", window == 1 ? elapsedNs / 1e3 / qMax(1, received) : 0.0}};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("WebSocket against RawSocket transport benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption messagesOption("messages", "Messages echoed per case.", "count", "100000");
+    QCommandLineOption windowOption("windows", "Comma separated messages in flight.", "list", "1,64");
+    QCommandLineOption sizeOption("sizes", "Comma separated message sizes in bytes.", "list", "64,4096");
+    QCommandLineOption portOption("port", "First of the two loopback ports to listen on.", "port", "18080");
+    parser.addOption(messagesOption);
+    parser.addOption(windowOption);
+    parser.addOption(sizeOption);
+    parser.addOption(portOption);
+    parser.process(app);
+    int messages = parser.value(messagesOption).toInt();
+    quint16 webSocketPort = quint16(parser.value(portOption).toInt());
+    quint16 rawSocketPort = webSocketPort + 1;
+
+    EchoServer server(webSocketPort, rawSocketPort);
+    QJsonArray results;
+    for(QString size: parser.value(sizeOption).split(',', QString::SkipEmptyParts))
+    {
+        for(QString window: parser.value(windowOption).split(',', QString::SkipEmptyParts))
+        {
+            results.append(run("websocket", webSocketPort, messages, window.toInt(), size.toInt()));
+            results.append(run("rawsocket", rawSocketPort, messages, window.toInt(), size.toInt()));
+        }
+    }
+    QJsonObject report{{"benchmark", "wamp_bench_transport"}, {"qt_version", qVersion()}, {"results", results}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
+
+#include "transportbench.moc"
@@ -0,0 +1,145 @@
+#include "framebatcher.h"
+#include "rawsockettransport.h"
+#include "wampmessageserializer.h"
+#include "wamp_symbols.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QEventLoop>
+#include <QTimer>
+#include <atomic>
+#include <cstdio>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Streams bursts of msgpack EVENTs over a loopback RawSocket transport, the way a session sends
+// them during a publish storm: each one is serialized and either handed to the transport on
+// its own or through FrameBatcher into sendBatch(). Neither mode flushes, the socket writes
+// when the event loop gets to it. Prints messages/sec and write syscalls per message as JSON.
+
+namespace {
+std::atomic<int> senderFd(-1);
+std::atomic<quint64> writeCalls(0);
+}
+
+// Counts the writes on the sending socket. Only available on Linux, elsewhere
+// syscalls_per_message reports 0.
+#if defined(__linux__)
+extern "C" {
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    if(fd == senderFd.load(std::memory_order_relaxed)) writeCalls.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_write, fd, buf, count);
+}
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt)
+{
+    if(fd == senderFd.load(std::memory_order_relaxed)) writeCalls.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_writev, fd, iov, iovcnt);
+}
+ssize_t send(int fd, const void* buf, size_t len, int flags)
+{
+    if(fd == senderFd.load(std::memory_order_relaxed)) writeCalls.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_sendto, fd, buf, len, flags, NULL, 0);
+}
+ssize_t sendmsg(int fd, const struct msghdr* msg, int flags)
+{
+    if(fd == senderFd.load(std::memory_order_relaxed)) writeCalls.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_sendmsg, fd, msg, flags);
+}
+}
+#endif
+
+using namespace QFlow;
+
+namespace {
+
+QJsonObject run(bool batched, int messages, int burst, int payloadSize)
+{
+    QTcpServer server;
+    server.listen(QHostAddress::LocalHost);
+    QTcpSocket* socket = new QTcpSocket();
+    socket->connectToHost(server.serverAddress(), server.serverPort());
+    QScopedPointer<RawSocketTransport> sender(new RawSocketTransport(socket, {KEY_WAMP_MSGPACK_SUB}));
+    QScopedPointer<RawSocketTransport> receiver;
+    QObject::connect(&server, &QTcpServer::newConnection, [&]() {
+        receiver.reset(new RawSocketTransport(server.nextPendingConnection()));
+    });
+
+    QEventLoop loop;
+    QScopedPointer<WampMessageSerializer> serializer(WampMessageSerializer::create(KEY_WAMP_MSGPACK_SUB));
+    QVariantList event{(int)WampMsgCode::EVENT, 1, 2, QVariantMap(), QVariantList{QString(payloadSize, 'x')}};
+    // the same sink a router session installs
+    FrameBatcher batcher([&](const QList<FrameBatcher::Frame>& frames) {
+        sender->sendBatch(frames);
+    });
+    int sent = 0;
+    int received = 0;
+    QTimer producer;
+    producer.setInterval(0);
+    QObject::connect(&producer, &QTimer::timeout, [&]() {
+        for(int i=0; i<burst && sent<messages; i++, sent++)
+        {
+            QByteArray frame = serializer->serialize(event);
+            if(batched) batcher.append(frame, true);
+            else sender->send(frame, true);
+        }
+        if(sent == messages) producer.stop();
+    });
+    QElapsedTimer timer;
+    QObject::connect(sender.data(), &WampTransport::opened, [&]() {
+        QObject::connect(receiver.data(), &WampTransport::messageReceived, [&](const QByteArray&) {
+            if(++received == messages) loop.quit();
+        });
+        writeCalls.store(0);
+        senderFd.store(int(socket->socketDescriptor()));
+        timer.start();
+        producer.start();
+    });
+    QObject::connect(sender.data(), &WampTransport::closed, &loop, &QEventLoop::quit);
+    sender->open();
+    loop.exec();
+    qint64 elapsedNs = timer.nsecsElapsed();
+    senderFd.store(-1);
+
+    return QJsonObject{{"mode", batched ? "batched" : "per_message"}, {"messages", received}, {"burst", burst},
+                       {"payload_bytes", payloadSize}, {"messages_per_sec", received / (elapsedNs / 1e9)},
+                       {"syscalls_per_message", double(writeCalls.load()) / qMax(1, received)}};
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Write coalescing benchmark, prints results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption messagesOption("messages", "EVENTs sent per case.", "count", "200000");
+    QCommandLineOption burstOption("bursts", "Comma separated EVENTs produced per event loop iteration.", "list", "1,8,32,128");
+    QCommandLineOption sizeOption("payload-size", "Bytes of the EVENT's string argument.", "bytes", "64");
+    parser.addOption(messagesOption);
+    parser.addOption(burstOption);
+    parser.addOption(sizeOption);
+    parser.process(app);
+    int messages = parser.value(messagesOption).toInt();
+    int payloadSize = parser.value(sizeOption).toInt();
+
+    QJsonArray results;
+    for(QString burst: parser.value(burstOption).split(',', QString::SkipEmptyParts))
+    {
+        results.append(run(false, messages, burst.toInt(), payloadSize));
+        results.append(run(true, messages, burst.toInt(), payloadSize));
+    }
+    QJsonObject report{{"benchmark", "wamp_bench_write_batch"}, {"qt_version", qVersion()}, {"results", results}};
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    return 0;
+}
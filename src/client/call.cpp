@@ -3,7 +3,7 @@
 
 namespace QFlow{
 
-Call::Call(Impl* callback, QObject* parent) : QObject(parent), _callback(callback)
+Call::Call(Impl* callback, QObject* parent, Impl* progress) : QObject(parent), _callback(callback), _progress(progress)
 {
 }
 Call::~Call()
@@ -26,9 +26,32 @@ void Call::resultReady(QVariant res)
     }
     else resultReadyInternal(res);
 }
+void Call::progressReadyInternal(QVariant chunk)
+{
+    if(_progress)
+    {
+        _progress->execute({chunk});
+    }
+}
+void Call::progressReady(QVariant chunk)
+{
+    if(parent())
+    {
+        QMetaObject::invokeMethod(this, "progressReadyInternal", Qt::BlockingQueuedConnection, Q_ARG(QVariant, chunk));
+    }
+    else progressReadyInternal(chunk);
+}
 Future Call::getFuture()
 {
     std::shared_future<QVariant> stdFuture(_promise.get_future());
     return Future(stdFuture);
 }
+QString Call::procedure() const
+{
+    return _procedure;
+}
+void Call::setProcedure(const QString &procedure)
+{
+    _procedure = procedure;
+}
 }
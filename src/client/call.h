@@ -12,15 +12,21 @@ class Call : public QObject
 {
     Q_OBJECT
 public:
-    Call(Impl* callback, QObject* parent = NULL);
+    Call(Impl* callback, QObject* parent = NULL, Impl* progress = NULL);
     ~Call();
     void resultReady(QVariant res);
+    void progressReady(QVariant chunk);
     Future getFuture();
+    QString procedure() const;
+    void setProcedure(const QString& procedure);
     Q_SLOT void resultReadyInternal(QVariant res);
+    Q_SLOT void progressReadyInternal(QVariant chunk);
     Q_SIGNAL void result(QVariant res);
 private:
     QScopedPointer<Impl> _callback;
+    QScopedPointer<Impl> _progress;
     std::promise<QVariant> _promise;
+    QString _procedure;
 };
 struct CallDeleter {
     void operator()(Call* c) const {
@@ -62,10 +62,30 @@ public:
         return _resultData.isNull();
     }
 };
+// Sends one progressive result chunk ahead of the final result
+typedef std::function<void(const QVariant&)> ProgressCallback;
 class Impl : public QObject
 {
 public:
     virtual WampResult execute(const QVariantList& args) = 0;
+    // Producers that stream override this; progress is a no-op when the caller did not ask for chunks
+    virtual WampResult executeProgressive(const QVariantList& args, const ProgressCallback& /*progress*/)
+    {
+        return execute(args);
+    }
+    // procedure is the URI the call was made to, which differs from the registered one for
+    // pattern-based registrations
+    virtual WampResult executeInvocation(const QString& /*procedure*/, const QVariantList& args, const ProgressCallback& progress)
+    {
+        return executeProgressive(args, progress);
+    }
+    // Takes a chunk of a progressive call. Every chunk but the last comes through here in order,
+    // requestId tells concurrent calls apart. Chunks not taken (false) are collected and
+    // executeInvocation gets their args ahead of the last chunk's.
+    virtual bool consumeChunk(qulonglong /*requestId*/, const QString& /*procedure*/, const QVariantList& /*args*/)
+    {
+        return false;
+    }
     virtual ~Impl()
     {
 
@@ -76,12 +96,18 @@ class Registration : public Impl
 protected:
     qulonglong _registrationId;
     QString _uri;
+    QVariantMap _options;
     QScopedPointer<Impl> _impl;
 public:
     QString uri() const
     {
         return _uri;
     }
+    // REGISTER options, e.g. match for pattern-based registrations
+    QVariantMap options() const
+    {
+        return _options;
+    }
     qulonglong registrationId() const
     {
         return _registrationId;
@@ -91,7 +117,7 @@ public:
         _registrationId = registrationId;
     }
 
-    Registration(QString uri, Impl* impl) : _uri(uri), _impl(impl)
+    Registration(QString uri, Impl* impl, QVariantMap options = QVariantMap()) : _uri(uri), _options(options), _impl(impl)
     {
 
     }
@@ -103,6 +129,18 @@ public:
     {
         return _impl->execute(args);
     }
+    WampResult executeProgressive(const QVariantList& args, const ProgressCallback& progress) override
+    {
+        return _impl->executeProgressive(args, progress);
+    }
+    WampResult executeInvocation(const QString& procedure, const QVariantList& args, const ProgressCallback& progress) override
+    {
+        return _impl->executeInvocation(procedure, args, progress);
+    }
+    bool consumeChunk(qulonglong requestId, const QString& procedure, const QVariantList& args) override
+    {
+        return _impl->consumeChunk(requestId, procedure, args);
+    }
 };
 typedef QSharedPointer<Registration> RegistrationPointer;
 
@@ -287,6 +325,50 @@ public:
         return _callback(args);
     }
 };
+typedef std::function<WampResult(QVariantList, ProgressCallback)> ProgressiveCallback;
+class ProgressiveImpl : public Impl
+{
+    ProgressiveCallback _callback;
+public:
+    ProgressiveImpl(ProgressiveCallback callback) : _callback(callback)
+    {
+
+    }
+    virtual ~ProgressiveImpl()
+    {
+
+    }
+    WampResult execute(const QVariantList& args) override
+    {
+        return _callback(args, [](const QVariant&) {});
+    }
+    WampResult executeProgressive(const QVariantList& args, const ProgressCallback& progress) override
+    {
+        return _callback(args, progress);
+    }
+};
+typedef std::function<WampResult(QString, QVariantList)> PatternCallback;
+class PatternImpl : public Impl
+{
+    PatternCallback _callback;
+public:
+    PatternImpl(PatternCallback callback) : _callback(callback)
+    {
+
+    }
+    virtual ~PatternImpl()
+    {
+
+    }
+    WampResult execute(const QVariantList& args) override
+    {
+        return _callback(QString(), args);
+    }
+    WampResult executeInvocation(const QString& procedure, const QVariantList& args, const ProgressCallback& /*progress*/) override
+    {
+        return _callback(procedure, args);
+    }
+};
 }
 #endif // REGISTRATION_P_H
 
@@ -18,6 +18,7 @@ class Subscription : public QObject
 protected:
     qulonglong _subscriptionId;
     QString _uri;
+    QVariantMap _options;
 public:
     Subscription() : _subscriptionId(-1)
     {
@@ -31,6 +32,16 @@ public:
     {
         _subscriptionId = subscriptionId;
     }
+    // SUBSCRIBE options, e.g. match for pattern-based subscriptions; events then carry
+    // the concrete topic in details
+    QVariantMap options() const
+    {
+        return _options;
+    }
+    void setOptions(const QVariantMap& options)
+    {
+        _options = options;
+    }
 
     Subscription(QString uri) : _uri(uri)
     {
@@ -3,6 +3,7 @@
 #include "wampattached.h"
 #include "future.h"
 #include "wampworker.h"
+#include "framebatcher.h"
 #include "random.h"
 #include "wampinvocation.h"
 #include "signalobserver.h"
@@ -18,7 +19,7 @@
 
 namespace QFlow{
 
-WampConnectionPrivate::WampConnectionPrivate(WampConnection* parent) : QObject(), q_ptr(parent)
+WampConnectionPrivate::WampConnectionPrivate(WampConnection* parent) : QObject(), _inproc(false), q_ptr(parent)
 {
     _worker = new WampWorker();
     _worker->_socketPrivate = this;
@@ -73,9 +74,44 @@ QByteArray WampConnectionPrivate::PBKDF2(QString password, QString salt, int ite
     return result;
 }
 
-void WampConnectionPrivate::handleInvocation(WampInvocationPointer invocation)
+// Called for every INVOCATION in the order they arrive. The chunks of a progressive call ahead
+// of the last one go to Impl::consumeChunk or are collected; the last one runs the invocation
+// and is answered with YIELD.
+void WampConnectionPrivate::handleInvocation(WampInvocationPointer invocation, QVariantList args, bool more)
 {
-    WampResult result = invocation->registration->execute(invocation->args);
+    if(more)
+    {
+        if(!invocation->interrupted.loadAcquire() &&
+           !invocation->registration->consumeChunk(invocation->requestId, invocation->procedure, args))
+        {
+            invocation->args.append(args);
+        }
+        return;
+    }
+    invocation->args.append(args);
+    qulonglong requestId = invocation->requestId;
+    WampInvocation* inv = invocation.data();
+    ProgressCallback progress = [](const QVariant&) {};
+    if(invocation->receiveProgress)
+    {
+        progress = [this, inv, requestId](const QVariant& chunk) {
+            if(inv->interrupted.loadAcquire()) return;
+            QVariantMap options{{KEY_PROGRESS, true}};
+            sendWampMessage({(int)WampMsgCode::YIELD, requestId, options, QVariantList{chunk}});
+        };
+    }
+    // an invocation interrupted while queued is not started
+    WampResult result = invocation->interrupted.loadAcquire() ? WampResult()
+                        : invocation->registration->executeInvocation(invocation->procedure, invocation->args, progress);
+    {
+        QMutexLocker lock(&_invocationMutex);
+        _invocations.remove(requestId, invocation);
+    }
+    if(invocation->interrupted.loadAcquire())
+    {
+        sendWampMessage({(int)WampMsgCode::ERROR, (int)WampMsgCode::INVOCATION, requestId, QVariantMap(), KEY_ERR_CANCELED});
+        return;
+    }
     QVariant val = result.resultData();
     QVariantList resultArr{val};
     QVariantList arr{(int)WampMsgCode::YIELD, invocation->requestId, QVariantMap()};
@@ -84,6 +120,11 @@ void WampConnectionPrivate::handleInvocation(WampInvocationPointer invocation)
 }
 void WampConnectionPrivate::sendWampMessage(const QVariantList &arr)
 {
+    if(_inproc)
+    {
+        _worker->sendMessage(arr);
+        return;
+    }
     if(!_serializer)
     {
         qDebug() << "Serializer not instatiated yet";
@@ -164,6 +205,17 @@ void WampConnection::setUser(User* value)
     d_ptr->_user.reset(value);
     Q_EMIT userChanged();
 }
+// Microseconds outgoing messages are held back to be written together, 0 batches the messages
+// of one event loop iteration and a negative value writes every message right away
+int WampConnection::writeBatchWindow() const
+{
+    return d_ptr->_worker->_batcher->window();
+}
+void WampConnection::setWriteBatchWindow(int usecs)
+{
+    d_ptr->_worker->_batcher->setWindow(usecs);
+    Q_EMIT writeBatchWindowChanged();
+}
 
 void WampConnection::connect()
 {
@@ -180,14 +232,14 @@ void WampConnection::disconnect()
 void WampConnectionPrivate::addRegistration(RegistrationPointer reg)
 {
     qulonglong requestId = Random::generate();
-    QVariantList arr{(int)WampMsgCode::REGISTER, requestId, QVariantMap(), reg->uri()};
+    QVariantList arr{(int)WampMsgCode::REGISTER, requestId, reg->options(), reg->uri()};
     _pendingRegistrations[requestId] = reg;
     sendWampMessage(arr);
 }
 void WampConnectionPrivate::addSubscription(SubscriptionPointer sub)
 {
     qulonglong requestId = Random::generate();
-    QVariantList arr{(int)WampMsgCode::SUBSCRIBE, requestId, QVariantMap(), sub->uri()};
+    QVariantList arr{(int)WampMsgCode::SUBSCRIBE, requestId, sub->options(), sub->uri()};
     _pendingSubscriptions[requestId] = sub;
     sendWampMessage(arr);
 }
@@ -217,22 +269,26 @@ void WampConnection::unsubscribe(qulonglong subscriptionId)
     d_ptr->_pendingUnsubscriptions[requestId] = sub;
     d_ptr->sendWampMessage(arr);
 }
-void WampConnection::subscribe(QString uri, QJSValue callback)
+void WampConnection::subscribe(QString uri, QJSValue callback, QVariantMap options)
 {
     SubscriptionPointer sub(new JSSubscription(uri, callback));
+    sub->setOptions(options);
     d_ptr->addSubscription(sub);
 }
-void WampConnection::subscribe(QString uri, QObject *obj, QString method)
+void WampConnection::subscribe(QString uri, QObject *obj, QString method, QVariantMap options)
 {
     SubscriptionPointer sub(new MethodSubscription(uri, obj, method));
+    sub->setOptions(options);
     d_ptr->addSubscription(sub);
 }
-void WampConnectionPrivate::call(QString uri, const QVariantList &args, CallPointer call, QVariantMap options)
+qulonglong WampConnectionPrivate::call(QString uri, const QVariantList &args, CallPointer call, QVariantMap options)
 {
     qulonglong requestId = Random::generate();
     QVariantList arr{(int)WampMsgCode::CALL, requestId, options, uri, args};
+    call->setProcedure(uri);
     _pendingCalls[requestId] = call;
     sendWampMessage(arr);
+    return requestId;
 }
 
 Future WampConnection::call(QString uri, const QVariantList& args, const QJSValue& callback, QVariantMap options)
@@ -251,7 +307,8 @@ Future WampConnection::call(QString uri, const QVariantList &args, QObject *call
     return call->getFuture();
 }
 
-Future WampConnection::call2(QString uri, const QVariantList& args, ResultCallback callback, QVariantMap options)
+Future WampConnection::call2(QString uri, const QVariantList& args, ResultCallback callback, QVariantMap options,
+                             qulonglong* requestId, ResultCallback progress)
 {
     if (!d_ptr)
 	return Future();
@@ -262,10 +319,35 @@ Future WampConnection::call2(QString uri, const QVariantList& args, ResultCallba
         auto* functor = new Functor<void,QVariant>(callback);
         impl = new FunctorImpl(functor);
     }
-    CallPointer call(new Call(impl), CallDeleter());
-    d_ptr->call(uri, args, call, options);
+    Impl* progressImpl = NULL;
+    if(progress)
+    {
+        progressImpl = new FunctorImpl(new Functor<void,QVariant>(progress));
+        options[KEY_RECEIVE_PROGRESS] = true;
+    }
+    CallPointer call(new Call(impl, NULL, progressImpl), CallDeleter());
+    qulonglong id = d_ptr->call(uri, args, call, options);
+    if(requestId) *requestId = id;
     return call->getFuture();
 }
+void WampConnection::continueCall(qulonglong requestId, const QVariantList &args, bool progress)
+{
+    if(!d_ptr) return;
+    CallPointer call = d_ptr->_pendingCalls.value(requestId);
+    if(!call) return;
+    QVariantMap options;
+    if(progress) options[KEY_PROGRESS] = true;
+    QVariantList arr{(int)WampMsgCode::CALL, requestId, options, call->procedure(), args};
+    d_ptr->sendWampMessage(arr);
+}
+void WampConnection::cancel(qulonglong requestId, QString mode)
+{
+    if(!d_ptr || !d_ptr->_pendingCalls.contains(requestId)) return;
+    QVariantMap options;
+    options[KEY_CANCEL_MODE] = mode;
+    QVariantList arr{(int)WampMsgCode::CANCEL, requestId, options};
+    d_ptr->sendWampMessage(arr);
+}
 
 void WampConnection::publish(QString uri, const QVariantList& args, const QVariantMap& kwargs)
 {
@@ -3,6 +3,7 @@
 
 #include "signalobserver.h"
 #include "wamp_global.h"
+#include "wamp_symbols.h"
 #include "wampbase.h"
 #include "subscription_p.h"
 #include "wamperror.h"
@@ -26,6 +27,7 @@ class WAMP_EXPORT WampConnection : public WampBase
     Q_PROPERTY(QUrl url READ url WRITE setUrl NOTIFY urlChanged)
     Q_PROPERTY(QString realm READ realm WRITE setRealm NOTIFY realmChanged)
     Q_PROPERTY(User* user READ user WRITE setUser NOTIFY userChanged)
+    Q_PROPERTY(int writeBatchWindow READ writeBatchWindow WRITE setWriteBatchWindow NOTIFY writeBatchWindowChanged)
 
     friend class WampRouterPrivate;
 public:
@@ -37,22 +39,36 @@ public:
     void setRealm(QString realm);
     User* user() const;
     void setUser(User* value);
+    int writeBatchWindow() const;
+    void setWriteBatchWindow(int usecs);
+    // options["match"] set to prefix or wildcard makes a pattern-based subscription
     template<typename ... Args>
-    void subscribe(QString uri, std::function<void(Args...)> f)
+    void subscribe(QString uri, std::function<void(Args...)> f, QVariantMap options = QVariantMap())
     {
         Functor<void, Args...>* functor = new Functor<void,Args...>(f);
         SubscriptionPointer sub(new FunctorSubscription(uri, functor));
+        sub->setOptions(options);
         addSubscription(sub);
     }
     void unregister(qulonglong registrationId);
     void unsubscribe(qulonglong subscriptionId);
-    Future call2(QString uri, const QVariantList& args, ResultCallback callback = nullptr, QVariantMap options = QVariantMap());
+    // options["timeout"] in msecs lets the router fail the call with wamp.error.timeout,
+    // requestId receives the id to pass to cancel(), progress receives each chunk of a
+    // progressive result before callback gets the final one
+    Future call2(QString uri, const QVariantList& args, ResultCallback callback = nullptr, QVariantMap options = QVariantMap(),
+                 qulonglong* requestId = nullptr, ResultCallback progress = nullptr);
+    // Sends the next chunk of a progressive call, started by call2 with options["progress"] set.
+    // The chunk sent with progress false is the last one.
+    void continueCall(qulonglong requestId, const QVariantList& args, bool progress = true);
+    // mode is skip, kill or killnowait; the call then completes with an invalid result and
+    // error() reports wamp.error.canceled
+    void cancel(qulonglong requestId, QString mode = KEY_CANCEL_SKIP);
     bool subscribeMeta; // should subscriptions for meta events be made after connection is attempted
 public Q_SLOTS:
     void connect();
 	void disconnect();
-    void subscribe(QString uri, QJSValue callback);
-    void subscribe(QString uri, QObject* obj, QString method);
+    void subscribe(QString uri, QJSValue callback, QVariantMap options = QVariantMap());
+    void subscribe(QString uri, QObject* obj, QString method, QVariantMap options = QVariantMap());
     void unregister(QString uri);
     void unsubscribe(QString uri);
     Future lookupRegistration(QString uri);
@@ -71,6 +87,7 @@ Q_SIGNALS:
     void disconnected();
     void error(const WampError& error);
     void userChanged();
+    void writeBatchWindowChanged();
     void textMessageReceived(const QString &message);
     void subscriptionCreated(const QString &topicUri);
     void subscriptionDeleted(const QString &topicUrl);
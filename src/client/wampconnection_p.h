@@ -8,6 +8,7 @@
 #include "call.h"
 #include <QThread>
 #include <QPointer>
+#include <QMutex>
 
 namespace QFlow{
 
@@ -43,11 +44,16 @@ public:
     QThread _workerThread;
     WampWorker* _worker;
     QScopedPointer<WampMessageSerializer> _serializer;
+    // connected in process, messages skip the serializer
+    bool _inproc;
     QHash<qulonglong,RegistrationPointer> _pendingRegistrations;
     QHash<qulonglong,RegistrationPointer> _pendingUnregistrations;
     QHash<qulonglong,RegistrationPointer> _registrations;
     QHash<QString,RegistrationPointer> _uriRegistration;
     QHash<qulonglong,CallPointer> _pendingCalls;
+    // invocations queued or running, the worker marks them on INTERRUPT
+    QMutex _invocationMutex;
+    QMultiHash<qulonglong,WampInvocationPointer> _invocations;
     QHash<QString, SignalObserverPointer> _topicObserver;
 
     QHash<qulonglong,SubscriptionPointer> _pendingSubscriptions;
@@ -62,10 +68,10 @@ public:
     static QByteArray IntToOctet(int i);
     void onConnected();
 public Q_SLOTS:
-    void handleInvocation(WampInvocationPointer invocation);
+    void handleInvocation(WampInvocationPointer invocation, QVariantList args, bool more);
     void handleEvent(const Event& event);
     void sendWampMessage(const QVariantList& arr);
-    void call(QString uri, const QVariantList& args, CallPointer call, QVariantMap options);
+    qulonglong call(QString uri, const QVariantList& args, CallPointer call, QVariantMap options);
 private:
     WampConnection* q_ptr;
     Q_DECLARE_PUBLIC(WampConnection)
@@ -6,11 +6,19 @@
 #include "wampcrauser.h"
 #include "helper.h"
 #include "wampmessageserializer.h"
-#include "websocketconnection.h"
+#include "wampmessage.h"
+#include "websockettransport.h"
+#include "rawsockettransport.h"
+#include "inproctransport.h"
+#include "shmtransport.h"
 #include "call.h"
+#include "framebatcher.h"
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QCoreApplication>
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QUrlQuery>
 
 namespace QFlow{
     
@@ -40,6 +48,9 @@ WampWorker::WampWorker() : QObject(), _timer(new QTimer(this))
 {
     _timer->setInterval(5000);
     QObject::connect(_timer, &QTimer::timeout, this, &WampWorker::reconnect);
+    _batcher = new FrameBatcher([this](const QList<FrameBatcher::Frame>& frames) {
+        if(!_socket.isNull()) _socket->sendBatch(frames);
+    }, this);
 }
 WampWorker::~WampWorker()
 {
@@ -58,20 +69,51 @@ void WampWorker::reconnect()
 void WampWorker::connect()
 {
     _timer->stop();
-    _socket.reset(new WebSocketConnection());
-    _socket->setUri(_socketPrivate->_url.url());
-    _socket->setRequestedSubprotocols({KEY_WAMP_MSGPACK_SUB, KEY_WAMP_JSON_SUB}); //prefer msgpack over json as it's faster
-    QObject::connect(_socket.data(), &WebSocketConnection::opened, this, &WampWorker::opened);
-    QObject::connect(_socket.data(), &WebSocketConnection::closed, this, &WampWorker::closed);
-    QObject::connect(_socket.data(), &WebSocketConnection::messageReceived, this, &WampWorker::messageReceived);
-    _socket->connect();
+    _socket.reset(createTransport(_socketPrivate->_url));
+    QObject::connect(_socket.data(), &WampTransport::opened, this, &WampWorker::opened);
+    QObject::connect(_socket.data(), &WampTransport::closed, this, &WampWorker::closed);
+    QObject::connect(_socket.data(), &WampTransport::messageReceived, this, &WampWorker::messageReceived);
+    QObject::connect(_socket.data(), &WampTransport::wampMessageReceived, this, &WampWorker::wampMessageReceived);
+    _socket->open();
     _timer->start();
 }
+// rawsocket://host:port speaks WAMP RawSocket over TCP, unix:///path over a Unix domain socket,
+// inproc://realm reaches a router of this process, shm:///path?ring=bytes a router on this host
+// over shared memory, anything else goes through WebSocket
+WampTransport* WampWorker::createTransport(const QUrl &url)
+{
+    //prefer binary serializers as they're faster
+    QStringList subprotocols = WampMessageSerializer::subprotocols();
+    if(url.scheme() == KEY_RAWSOCKET_SCHEME)
+    {
+        QTcpSocket* socket = new QTcpSocket();
+        socket->connectToHost(url.host(), quint16(url.port(DEFAULT_RAWSOCKET_PORT)));
+        return new RawSocketTransport(socket, subprotocols);
+    }
+    if(url.scheme() == KEY_INPROC_SCHEME)
+    {
+        return new InprocTransport(url.host());
+    }
+    if(url.scheme() == KEY_SHM_SCHEME)
+    {
+        QUrlQuery query(url);
+        int ringSize = query.hasQueryItem("ring") ? query.queryItemValue("ring").toInt() : DEFAULT_SHM_RING_SIZE;
+        return new ShmTransport(url.path(), subprotocols, ringSize);
+    }
+    if(url.scheme() == KEY_UNIX_SCHEME)
+    {
+        QLocalSocket* socket = new QLocalSocket();
+        socket->connectToServer(url.path());
+        return new RawSocketTransport(socket, subprotocols);
+    }
+    return new WebSocketTransport(url, subprotocols);
+}
     
 void WampWorker::disconnect()
 {
     if (!_socket.isNull())
     {
+        _batcher->flush();
         _socket->close();
         _socket.reset();
     }
@@ -81,18 +123,33 @@ void WampWorker::disconnect()
 void WampWorker::sendTextMessage(const QString &message)
 {
     if (!_socket.isNull())
-        _socket->sendText(message);
+        write(message.toUtf8(), false);
     else {
         qWarning() << "Invalid socket state while attempting to send text message [" << message << "]";
     }
 }
+void WampWorker::sendMessage(const QVariantList &message)
+{
+    if (!_socket.isNull())
+        _socket->sendMessage(message);
+    else
+        qWarning() << "Attempting to send message while connection to WAMP router is closed";
+}
 void WampWorker::sendBinaryMessage(const QByteArray &message)
 {
     if (!_socket.isNull())
-        _socket->sendBinary(message);
+        write(message, true);
     else
         qWarning() << "Attempting to send binary message while socket to WAMP server is closed";
 }
+// Transports writing one message at a time gain nothing from waiting for a batch
+void WampWorker::write(const QByteArray &message, bool binary)
+{
+    if (_socket->writesBatches())
+        _batcher->append(message, binary);
+    else
+        _socket->send(message, binary);
+}
 void WampWorker::closed()
 {
     qDebug() << "WampConnection: WebSocket closed";
@@ -112,13 +169,16 @@ void WampWorker::closed()
 void WampWorker::flush()
 {
     QCoreApplication::processEvents();
+    _batcher->flush();
 }
 
 void WampWorker::opened()
 {
     _timer->stop();
     QString sub = _socket->subprotocol();
+    // null for in-process transports, messages then go through sendMessage()
     _socketPrivate->_serializer.reset(WampMessageSerializer::create(sub));
+    _socketPrivate->_inproc = _socket->carriesMessages();
     QVariantMap options;
 	CredentialStore store;
 	
@@ -140,6 +200,7 @@ void WampWorker::opened()
 	
     QVariantMap roles{{"publisher", QVariantMap()}, {"subscriber", QVariantMap()}, {"caller", QVariantMap()}, {"callee", QVariantMap()}};
     options["roles"] = roles;
+    options[KEY_NATIVE_TIMESTAMPS] = true;
     QVariantList arr{WampMsgCode::HELLO, _socketPrivate->_realm, options};
     _socketPrivate->sendWampMessage(arr);
 }
@@ -147,162 +208,200 @@ void WampWorker::messageReceived(const QByteArray &message)
 {
     if (_socketPrivate->q_ptr)
     {
-    QVariantList arr = _socketPrivate->_serializer->deserialize(message);
-    WampMsgCode code = (WampMsgCode)arr[0].toInt();
-    if(code == WampMsgCode::ERROR)
-    {
-        WampMsgCode subCode = (WampMsgCode)arr[1].toInt();
-        qulonglong requestId = arr[2].toULongLong();
-        QUrl uri = arr[4].toString();
-        if(subCode == WampMsgCode::CALL)
-        {
-            CallPointer call = _socketPrivate->_pendingCalls.take(requestId);
-            call->resultReady(QVariant());
-        }
-        QVariantMap details = arr[3].toMap();
-        QVariantList args;
-        if(arr.count() > 5)
-        {
-            args = arr[5].toList();
-        }
-        WampError wampError((int)subCode, requestId, details, uri, args);
-        Q_EMIT _socketPrivate->q_ptr->error(wampError);
-
+        dispatch(_socketPrivate->_serializer->decode(message));
+        if (_socketPrivate->q_ptr)
+            Q_EMIT _socketPrivate->q_ptr->textMessageReceived(message);
     }
-    if(code == WampMsgCode::ABORT)
+}
+void WampWorker::wampMessageReceived(const QVariantList &message)
+{
+    if (_socketPrivate->q_ptr)
+        dispatch(toWampMessage(message));
+}
+void WampWorker::dispatch(const WampMessagePointer &msg)
+{
+    if(!msg)
     {
-        QString uri = arr[2].toString();
-        QVariantMap details = arr[1].toMap();
-        WampError wampError((int)WampMsgCode::ABORT, 0, details, uri, QVariantList());
-        Q_EMIT _socketPrivate->q_ptr->error(wampError);
+        qWarning() << "Malformed WAMP message received";
+        return;
     }
-    if(code == WampMsgCode::WELCOME)
+    switch(msg->code)
     {
-        _socketPrivate->onConnected();
-    }
-    else if(code == WampMsgCode::REGISTERED)
+    case WampMsgCode::ERROR:
+        handleError(message_cast<ErrorMessage>(msg));
+        break;
+    case WampMsgCode::ABORT:
     {
-        qulonglong regId = arr[2].toULongLong();
-        qulonglong requestId = arr[1].toULongLong();
-        RegistrationPointer reg = _socketPrivate->_pendingRegistrations.take(requestId);
-        reg->setRegistrationId(regId);
-        if(_socketPrivate->_uriRegistration.contains(reg->uri()))
+        const AbortMessage& abort = message_cast<AbortMessage>(msg);
+        WampError wampError((int)WampMsgCode::ABORT, 0, abort.details, abort.reason, QVariantList());
+        Q_EMIT _socketPrivate->q_ptr->error(wampError);
+        break;
+    }
+    case WampMsgCode::WELCOME:
+        if(_socketPrivate->_serializer && message_cast<WelcomeMessage>(msg).details.value(KEY_NATIVE_TIMESTAMPS).toBool())
         {
-            RegistrationPointer oldReg = _socketPrivate->_uriRegistration.take(reg->uri());
-            _socketPrivate->_registrations.remove(oldReg->registrationId());
+            _socketPrivate->_serializer->setNativeTimestamps(true);
         }
-        _socketPrivate->_registrations[regId] = reg;
-        _socketPrivate->_uriRegistration[reg->uri()] = reg;
-    }
-    else if(code == WampMsgCode::UNREGISTERED){
-        qulonglong requestId = arr[1].toULongLong();
-        RegistrationPointer reg = _socketPrivate->_pendingUnregistrations.take(requestId);
+        _socketPrivate->onConnected();
+        break;
+    case WampMsgCode::REGISTERED:
+        handleRegistered(message_cast<RegisteredMessage>(msg));
+        break;
+    case WampMsgCode::UNREGISTERED:
+    {
+        RegistrationPointer reg = _socketPrivate->_pendingUnregistrations.take(message_cast<UnregisteredMessage>(msg).requestId);
         _socketPrivate->_registrations.remove(reg->registrationId());
         _socketPrivate->_uriRegistration.remove(reg->uri());
-
+        break;
     }
-    else if(code == WampMsgCode::SUBSCRIBED)
+    case WampMsgCode::SUBSCRIBED:
+        handleSubscribed(message_cast<SubscribedMessage>(msg));
+        break;
+    case WampMsgCode::UNSUBSCRIBED:
     {
-        qulonglong subId = arr[2].toULongLong();
-        qulonglong requestId = arr[1].toULongLong();
-        SubscriptionPointer sub = _socketPrivate->_pendingSubscriptions.take(requestId);
-        sub->setSubscriptionId(subId);
-        if(_socketPrivate->_uriSubscription.contains(sub->uri()))
-        {
-            SubscriptionPointer oldSub = _socketPrivate->_uriSubscription.take(sub->uri());
-            _socketPrivate->_subscriptions.remove(oldSub->subscriptionId());
-        }
-        _socketPrivate->_subscriptions[subId] = sub;
-        _socketPrivate->_uriSubscription[sub->uri()] = sub;
-    }
-    else if(code == WampMsgCode::UNSUBSCRIBED){
-        qulonglong requestId = arr[1].toULongLong();
-        SubscriptionPointer sub = _socketPrivate->_pendingUnsubscriptions.take(requestId);
+        SubscriptionPointer sub = _socketPrivate->_pendingUnsubscriptions.take(message_cast<UnsubscribedMessage>(msg).requestId);
         _socketPrivate->_subscriptions.remove(sub->subscriptionId());
         _socketPrivate->_uriSubscription.remove(sub->uri());
+        break;
     }
-    else if(code == WampMsgCode::INVOCATION)
+    case WampMsgCode::INVOCATION:
+        handleInvocation(message_cast<InvocationMessage>(msg));
+        break;
+    case WampMsgCode::INTERRUPT:
+        handleInterrupt(message_cast<InterruptMessage>(msg));
+        break;
+    case WampMsgCode::EVENT:
+        handleEvent(message_cast<EventMessage>(msg));
+        break;
+    case WampMsgCode::RESULT:
+        handleResult(message_cast<ResultMessage>(msg));
+        break;
+    case WampMsgCode::PUBLISHED:
+        break;
+    case WampMsgCode::CHALLENGE:
     {
-        qulonglong regId = arr[2].toULongLong();
-        RegistrationPointer reg = _socketPrivate->_registrations[regId];
-        QVariantList args;
-        if(arr.count() > 4 && (QMetaType::Type)arr[4].type() == QMetaType::QVariantList)
-        {
-            args = arr[4].toList();
-        }
-
-        WampInvocationPointer inv(new WampInvocation(), InvocationDeleter());
-        inv->registration = reg;
-        inv->args = args;
-        inv->requestId = arr[1].toULongLong();
-        QMetaObject::invokeMethod(_socketPrivate, "handleInvocation", Qt::QueuedConnection, Q_ARG(WampInvocationPointer, inv));
+        const ChallengeMessage& challenge = message_cast<ChallengeMessage>(msg);
+        QString result = QString(_socketPrivate->_user->response(challenge.extra["challenge"].toString().toLatin1()));
+        QVariantList resArr{WampMsgCode::AUTHENTICATE, result, QVariantMap()};
+        _socketPrivate->sendWampMessage(resArr);
+        break;
     }
-    else if(code == WampMsgCode::EVENT)
+    case WampMsgCode::GOODBYE:
     {
-        qulonglong subId = arr[1].toULongLong();
-        if(!_socketPrivate->_subscriptions.contains(subId))
-        {
-            qDebug() << "Event received for non existing subscritption " << subId;
-            return;
-        }
-        SubscriptionPointer sub = _socketPrivate->_subscriptions[subId];
-        QVariantList args;
-        QVariantMap kwargs;
-        QVariantMap details;
-        if(arr.count() > 4 && (QMetaType::Type)arr[4].type() == QMetaType::QVariantList)
-        {
-            args = arr[4].toList();
-        }
-        if(arr.count() > 5 && (QMetaType::Type)arr[5].type() == QMetaType::QVariantMap)
+        const GoodbyeMessage& goodbye = message_cast<GoodbyeMessage>(msg);
+        qInfo() << "Received GOODBYE msg with reason: " << goodbye.reason << " and details: " << goodbye.details;
+        if (_socketPrivate->q_ptr)
+            Q_EMIT _socketPrivate->q_ptr->disconnected();
+        disconnect();
+        break;
+    }
+    default:
+        break;
+    }
+}
+void WampWorker::handleError(const ErrorMessage &msg)
+{
+    if(msg.requestType == WampMsgCode::CALL)
+    {
+        CallPointer call = _socketPrivate->_pendingCalls.take(msg.requestId);
+        if(call) call->resultReady(QVariant());
+    }
+    WampError wampError(msg.requestType, msg.requestId, msg.details, msg.error, msg.args);
+    Q_EMIT _socketPrivate->q_ptr->error(wampError);
+}
+void WampWorker::handleRegistered(const RegisteredMessage &msg)
+{
+    RegistrationPointer reg = _socketPrivate->_pendingRegistrations.take(msg.requestId);
+    reg->setRegistrationId(msg.registrationId);
+    if(_socketPrivate->_uriRegistration.contains(reg->uri()))
+    {
+        RegistrationPointer oldReg = _socketPrivate->_uriRegistration.take(reg->uri());
+        _socketPrivate->_registrations.remove(oldReg->registrationId());
+    }
+    _socketPrivate->_registrations[msg.registrationId] = reg;
+    _socketPrivate->_uriRegistration[reg->uri()] = reg;
+}
+void WampWorker::handleSubscribed(const SubscribedMessage &msg)
+{
+    SubscriptionPointer sub = _socketPrivate->_pendingSubscriptions.take(msg.requestId);
+    sub->setSubscriptionId(msg.subscriptionId);
+    if(_socketPrivate->_uriSubscription.contains(sub->uri()))
+    {
+        SubscriptionPointer oldSub = _socketPrivate->_uriSubscription.take(sub->uri());
+        _socketPrivate->_subscriptions.remove(oldSub->subscriptionId());
+    }
+    _socketPrivate->_subscriptions[msg.subscriptionId] = sub;
+    _socketPrivate->_uriSubscription[sub->uri()] = sub;
+}
+void WampWorker::handleInvocation(const InvocationMessage &msg)
+{
+    bool progress = msg.details.value(KEY_PROGRESS).toBool();
+    WampInvocationPointer inv;
+    {
+        QMutexLocker lock(&_socketPrivate->_invocationMutex);
+        // later chunks of a progressive call continue the invocation the first one opened
+        for(const WampInvocationPointer& open: _socketPrivate->_invocations.values(msg.requestId))
         {
-            kwargs = arr[5].toMap();
+            if(open->progress || open->interrupted.loadAcquire()) inv = open;
         }
-        if(arr.count() > 6 && (QMetaType::Type)arr[6].type() == QMetaType::QVariantMap)
+        // an interrupted invocation is already closed, chunks still in flight are dropped
+        if(inv && !inv->progress) return;
+        if(!inv)
         {
-            details = arr[6].toMap();
+            RegistrationPointer reg = _socketPrivate->_registrations[msg.registrationId];
+            inv = WampInvocationPointer(new WampInvocation(), InvocationDeleter());
+            inv->registration = reg;
+            inv->procedure = msg.details.value("procedure", reg->uri()).toString();
+            inv->requestId = msg.requestId;
+            inv->receiveProgress = msg.details.value(KEY_RECEIVE_PROGRESS).toBool();
+            _socketPrivate->_invocations.insert(inv->requestId, inv);
         }
-        Event event;
-        event.subscription = sub;
-        event.args = args;
-        event.kwargs = kwargs;
-        event.details = details;
-        event.publicationId = arr[2].toULongLong();
-        QMetaObject::invokeMethod(_socketPrivate, "handleEvent", Qt::QueuedConnection, Q_ARG(Event, event));
-
+        inv->progress = progress;
     }
-    else if(code == WampMsgCode::RESULT)
+    QMetaObject::invokeMethod(_socketPrivate, "handleInvocation", Qt::QueuedConnection, Q_ARG(WampInvocationPointer, inv),
+                              Q_ARG(QVariantList, msg.args), Q_ARG(bool, progress));
+}
+void WampWorker::handleInterrupt(const InterruptMessage &msg)
+{
+    QMutexLocker lock(&_socketPrivate->_invocationMutex);
+    for(const WampInvocationPointer& inv: _socketPrivate->_invocations.values(msg.requestId))
     {
-        qulonglong requestId = arr[1].toULongLong();
-        CallPointer call = _socketPrivate->_pendingCalls.take(requestId);
-        QVariant result;
-        if(arr.count() > 3)
+        inv->interrupted.storeRelease(1);
+        // the last chunk of a canceled progressive call never comes, close the invocation so
+        // that it is answered
+        if(inv->progress)
         {
-            QVariantList resultArray = arr[3].toList();
-            result = resultArray[0];
+            inv->progress = false;
+            QMetaObject::invokeMethod(_socketPrivate, "handleInvocation", Qt::QueuedConnection, Q_ARG(WampInvocationPointer, inv),
+                                      Q_ARG(QVariantList, QVariantList()), Q_ARG(bool, false));
         }
-        call->resultReady(result);
-    }
-    else if(code == WampMsgCode::PUBLISHED)
-    {
-    }
-    else if(code == WampMsgCode::CHALLENGE)
-    {
-        QVariantMap extra = arr[2].toMap();
-        QString result = QString(_socketPrivate->_user->response(extra["challenge"].toString().toLatin1()));
-        QVariantList resArr{WampMsgCode::AUTHENTICATE, result, QVariantMap()};
-        _socketPrivate->sendWampMessage(resArr);
     }
-    else if (code == WampMsgCode::GOODBYE)
+}
+void WampWorker::handleEvent(const EventMessage &msg)
+{
+    if(!_socketPrivate->_subscriptions.contains(msg.subscriptionId))
     {
-        QVariantMap details = arr[1].toMap();
-        QString reason = arr[2].toString();
-        qInfo() << "Received GOODBYE msg with reason: " << reason << " and details: " << details;
-        if (_socketPrivate->q_ptr)
-            Q_EMIT _socketPrivate->q_ptr->disconnected();
-        disconnect();
-    }
-    if (_socketPrivate->q_ptr)
-        Q_EMIT _socketPrivate->q_ptr->textMessageReceived(message);
+        qDebug() << "Event received for non existing subscritption " << msg.subscriptionId;
+        return;
     }
+    Event event;
+    event.subscription = _socketPrivate->_subscriptions[msg.subscriptionId];
+    event.args = msg.args;
+    event.kwargs = msg.kwargs;
+    event.details = msg.details;
+    event.publicationId = msg.publicationId;
+    QMetaObject::invokeMethod(_socketPrivate, "handleEvent", Qt::QueuedConnection, Q_ARG(Event, event));
+}
+void WampWorker::handleResult(const ResultMessage &msg)
+{
+    // progressive chunks leave the call pending until the final RESULT
+    bool progress = msg.details.value(KEY_PROGRESS).toBool();
+    CallPointer call = progress ? _socketPrivate->_pendingCalls.value(msg.requestId)
+                                : _socketPrivate->_pendingCalls.take(msg.requestId);
+    if(!call) return;
+    QVariant result;
+    if(!msg.args.isEmpty()) result = msg.args.first();
+    if(progress) call->progressReady(result);
+    else call->resultReady(result);
 }
 }
@@ -1,7 +1,8 @@
 #ifndef WAMPWORKER_H
 #define WAMPWORKER_H
 
-#include "websocketconnection.h"
+#include "wamptransport.h"
+#include "wampmessage.h"
 #include <QObject>
 #include <QTimer>
 #include <memory>
@@ -10,6 +11,14 @@
 namespace QFlow{
 
 class WampConnectionPrivate;
+class FrameBatcher;
+struct ErrorMessage;
+struct RegisteredMessage;
+struct SubscribedMessage;
+struct InvocationMessage;
+struct InterruptMessage;
+struct EventMessage;
+struct ResultMessage;
 class WampWorker : public QObject
 {
     Q_OBJECT
@@ -18,15 +27,28 @@ public:
     ~WampWorker();
     WampConnectionPrivate* _socketPrivate;
     QTimer* _timer;
-    QScopedPointer<WebSocketConnection> _socket;
+    QScopedPointer<WampTransport> _socket;
+    FrameBatcher* _batcher;
+    void handleError(const ErrorMessage& msg);
+    void handleRegistered(const RegisteredMessage& msg);
+    void handleSubscribed(const SubscribedMessage& msg);
+    void handleInvocation(const InvocationMessage& msg);
+    void handleInterrupt(const InterruptMessage& msg);
+    void handleEvent(const EventMessage& msg);
+    void handleResult(const ResultMessage& msg);
+    void dispatch(const WampMessagePointer& msg);
+    static WampTransport* createTransport(const QUrl& url);
+    void write(const QByteArray& message, bool binary);
 public Q_SLOTS:
     void connect();
     void disconnect();
     void messageReceived(const QByteArray & message);
+    void wampMessageReceived(const QVariantList& message);
     void opened();
     void closed();
     void sendTextMessage(const QString& message);
     void sendBinaryMessage(const QByteArray& message);
+    void sendMessage(const QVariantList& message);
     void reconnect();
     void flush();
 };
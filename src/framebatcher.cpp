@@ -0,0 +1,81 @@
+#include "framebatcher.h"
+#include <QTimer>
+#include <QThread>
+
+namespace QFlow{
+
+// A batch this large is flushed right away instead of waiting for the window
+const int MAX_BATCH_BYTES = 64 * 1024;
+
+FrameBatcher::FrameBatcher(Sink sink, QObject *parent) : QObject(parent), _sink(sink), _timer(new QTimer(this)),
+    _bytes(0), _window(0), _scheduled(false)
+{
+    _timer->setSingleShot(true);
+    _timer->setTimerType(Qt::PreciseTimer);
+    connect(_timer, &QTimer::timeout, this, &FrameBatcher::flush);
+}
+FrameBatcher::~FrameBatcher()
+{
+
+}
+int FrameBatcher::window() const
+{
+    QMutexLocker lock(&_mutex);
+    return _window;
+}
+void FrameBatcher::setWindow(int usecs)
+{
+    QMutexLocker lock(&_mutex);
+    _window = usecs;
+}
+void FrameBatcher::append(const QByteArray &data, bool binary)
+{
+    append(data, QByteArray(), binary);
+}
+void FrameBatcher::append(const QByteArray &data, const QByteArray &payload, bool binary)
+{
+    Frame frame = {data, payload, binary};
+    bool direct = false;
+    bool flushNow = false;
+    bool schedule = false;
+    {
+        QMutexLocker lock(&_mutex);
+        direct = _window < 0;
+        if(!direct)
+        {
+            _frames.append(frame);
+            _bytes += frame.size();
+            flushNow = _bytes >= MAX_BATCH_BYTES && QThread::currentThread() == thread();
+            schedule = !flushNow && !_scheduled;
+            if(schedule) _scheduled = true;
+        }
+    }
+    if(direct) _sink({frame});
+    else if(flushNow) flush();
+    else if(schedule) QMetaObject::invokeMethod(this, "arm", Qt::QueuedConnection);
+}
+int FrameBatcher::pendingBytes() const
+{
+    QMutexLocker lock(&_mutex);
+    return _bytes;
+}
+void FrameBatcher::flush()
+{
+    QList<Frame> frames;
+    {
+        QMutexLocker lock(&_mutex);
+        frames.swap(_frames);
+        _bytes = 0;
+        _scheduled = false;
+    }
+    _timer->stop();
+    if(!frames.isEmpty()) _sink(frames);
+}
+// Runs once the loop got to the posted event, i.e. after everything queued before it
+void FrameBatcher::arm()
+{
+    int window = this->window();
+    if(window <= 0) flush();
+    else if(!_timer->isActive()) _timer->start((window + 999) / 1000);
+}
+}
@@ -0,0 +1,62 @@
+#ifndef FRAMEBATCHER_H
+#define FRAMEBATCHER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <functional>
+
+class QTimer;
+
+namespace QFlow{
+
+// Collects the outgoing frames of one connection and hands them to the transport together,
+// at the end of the event loop iteration they were produced in or once the batching window
+// has passed since the first of them. append() is thread-safe, the sink runs in the
+// batcher's thread.
+class FrameBatcher : public QObject
+{
+    Q_OBJECT
+public:
+    struct Frame
+    {
+        QByteArray data;
+        // written right after data as part of the same message; EVENTs of one publication
+        // share it, so transports gather it instead of joining it into data
+        QByteArray payload;
+        bool binary;
+        int size() const
+        {
+            return data.size() + payload.size();
+        }
+        QByteArray joined() const
+        {
+            return payload.isEmpty() ? data : data + payload;
+        }
+    };
+    typedef std::function<void(const QList<Frame>& frames)> Sink;
+    explicit FrameBatcher(Sink sink, QObject* parent = NULL);
+    ~FrameBatcher();
+    // Microseconds, rounded up to the timer's millisecond resolution. 0 flushes at the end of
+    // the current loop iteration, negative disables batching.
+    int window() const;
+    void setWindow(int usecs);
+    void append(const QByteArray& data, bool binary);
+    void append(const QByteArray& data, const QByteArray& payload, bool binary);
+    int pendingBytes() const;
+public Q_SLOTS:
+    void flush();
+private Q_SLOTS:
+    void arm();
+private:
+    Sink _sink;
+    QTimer* _timer;
+    mutable QMutex _mutex;
+    QList<Frame> _frames;
+    int _bytes;
+    int _window;
+    bool _scheduled;
+};
+}
+Q_DECLARE_METATYPE(QFlow::FrameBatcher::Frame)
+#endif // FRAMEBATCHER_H
@@ -16,6 +16,7 @@ public:
     ~GSSAPIAuthenticator();
     QString authMethod() const;
     void setAuthMethod(const QString& value);
+    using Authenticator::generateChallenge;
     QVariantMap generateChallenge(qulonglong sessionId, QString authId);
     AuthSession* createSession() const;
     User* getUser(AuthSession* session);
@@ -0,0 +1,160 @@
+#include "inproctransport.h"
+#include "wamp_symbols.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace QFlow{
+
+namespace {
+struct InprocRegistry
+{
+    QMutex mutex;
+    QHash<QString, QObject*> servers;
+};
+Q_GLOBAL_STATIC(InprocRegistry, registry)
+}
+
+InprocChannel::InprocChannel()
+{
+    endpoints[InprocTransport::Client] = NULL;
+    endpoints[InprocTransport::Server] = NULL;
+}
+
+// QUrl lowercases hosts, so names are matched case-insensitively
+InprocTransport::InprocTransport(const QString &name, QObject *parent) : WampTransport(parent), _name(name.toLower()),
+    _side(Client), _closed(false), _readingPaused(false)
+{
+}
+InprocTransport::InprocTransport(const InprocChannelPointer &channel, QObject *parent) : WampTransport(parent),
+    _side(Server), _closed(false), _readingPaused(false), _channel(channel)
+{
+    QMutexLocker locker(&_channel->mutex);
+    _channel->endpoints[Server] = this;
+    InprocTransport* client = _channel->endpoints[Client];
+    // the client gave up before the router got to it
+    if(client) QMetaObject::invokeMethod(client, "onAccepted", Qt::QueuedConnection);
+    else QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+}
+InprocTransport::~InprocTransport()
+{
+    detach();
+}
+bool InprocTransport::registerServer(const QString &name, QObject *acceptor)
+{
+    qRegisterMetaType<InprocChannelPointer>("QFlow::InprocChannelPointer");
+    QMutexLocker locker(&registry->mutex);
+    QObject*& server = registry->servers[name.toLower()];
+    if(server && server != acceptor) return false;
+    server = acceptor;
+    return true;
+}
+void InprocTransport::unregisterServer(QObject *acceptor)
+{
+    QMutexLocker locker(&registry->mutex);
+    for(auto it = registry->servers.begin(); it != registry->servers.end();)
+    {
+        if(it.value() == acceptor) it = registry->servers.erase(it);
+        else ++it;
+    }
+}
+// The acceptor is invoked while the registry is locked, so it cannot be destroyed in between
+void InprocTransport::open()
+{
+    if(_side != Client || _channel || _closed) return;
+    InprocChannelPointer channel(new InprocChannel());
+    channel->endpoints[Client] = this;
+    QMutexLocker locker(&registry->mutex);
+    QObject* acceptor = registry->servers.value(_name);
+    if(!acceptor)
+    {
+        qWarning() << QString("Inproc: no router serves %1").arg(_name);
+        QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+        return;
+    }
+    _channel = channel;
+    QMetaObject::invokeMethod(acceptor, "accept", Qt::QueuedConnection, Q_ARG(QFlow::InprocChannelPointer, channel));
+}
+void InprocTransport::onAccepted()
+{
+    if(!_closed) Q_EMIT opened();
+}
+bool InprocTransport::carriesMessages() const
+{
+    return true;
+}
+// Only the first message of a burst wakes the peer, it drains everything queued until then
+void InprocTransport::sendMessage(const QVariantList &message)
+{
+    if(!_channel || _closed) return;
+    int peer = 1 - _side;
+    _channel->queues[peer].push(message);
+    if(_channel->drainScheduled[peer].testAndSetOrdered(0, 1))
+    {
+        QMutexLocker locker(&_channel->mutex);
+        InprocTransport* endpoint = _channel->endpoints[peer];
+        if(endpoint) QMetaObject::invokeMethod(endpoint, "drain", Qt::QueuedConnection);
+    }
+}
+void InprocTransport::drain()
+{
+    MpscQueue<QVariantList>& queue = _channel->queues[_side];
+    // cleared before popping, so a message pushed after the last pop schedules the next drain
+    _channel->drainScheduled[_side].storeRelease(0);
+    QVariantList message;
+    while(!_closed && !_readingPaused && queue.pop(&message))
+    {
+        Q_EMIT wampMessageReceived(message);
+    }
+}
+void InprocTransport::send(const QByteArray &/*message*/, bool /*binary*/)
+{
+    qWarning() << "Inproc: encoded messages are not supported, use sendMessage()";
+}
+void InprocTransport::setReadingPaused(bool paused)
+{
+    _readingPaused = paused;
+    if(!paused && _channel) QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
+qint64 InprocTransport::bytesToWrite() const
+{
+    return 0;
+}
+QString InprocTransport::subprotocol() const
+{
+    return KEY_WAMP_INPROC_SUB;
+}
+QHostAddress InprocTransport::peerAddress() const
+{
+    return QHostAddress(QHostAddress::LocalHost);
+}
+PeerCredentials InprocTransport::peerCredentials() const
+{
+    PeerCredentials credentials;
+    credentials.valid = true;
+    credentials.pid = QCoreApplication::applicationPid();
+#ifdef Q_OS_UNIX
+    credentials.uid = ::getuid();
+    credentials.gid = ::getgid();
+#endif
+    return credentials;
+}
+void InprocTransport::detach()
+{
+    if(!_channel) return;
+    QMutexLocker locker(&_channel->mutex);
+    _channel->endpoints[_side] = NULL;
+    InprocTransport* peer = _channel->endpoints[1 - _side];
+    if(peer) QMetaObject::invokeMethod(peer, "close", Qt::QueuedConnection);
+}
+void InprocTransport::close()
+{
+    if(_closed) return;
+    _closed = true;
+    detach();
+    Q_EMIT closed();
+}
+}
@@ -0,0 +1,70 @@
+#ifndef INPROCTRANSPORT_H
+#define INPROCTRANSPORT_H
+
+#include "wamptransport.h"
+#include "mpscqueue.h"
+#include <QMutex>
+#include <QSharedPointer>
+
+namespace QFlow{
+
+class InprocTransport;
+
+// Connects one client with one router session of the same process. Each side consumes its own
+// queue; the mutex only guards the endpoint pointers used to wake the consumer.
+class InprocChannel
+{
+public:
+    InprocChannel();
+    MpscQueue<QVariantList> queues[2];
+    QAtomicInt drainScheduled[2];
+    QMutex mutex;
+    InprocTransport* endpoints[2];
+};
+typedef QSharedPointer<InprocChannel> InprocChannelPointer;
+
+// Hands WAMP messages as QVariantList between a WampConnection and a WampRouter living in the
+// same process, no serializer is involved. Clients reach a router through inproc://<realm>.
+class InprocTransport : public WampTransport
+{
+    Q_OBJECT
+public:
+    enum Side {
+        Client = 0,
+        Server = 1
+    };
+    // Client side, opened() follows once the router serving name accepted
+    explicit InprocTransport(const QString& name, QObject* parent = NULL);
+    // Server side, attached to the channel a client opened
+    explicit InprocTransport(const InprocChannelPointer& channel, QObject* parent = NULL);
+    ~InprocTransport();
+    bool carriesMessages() const override;
+    void sendMessage(const QVariantList& message) override;
+    void send(const QByteArray& message, bool binary) override;
+    qint64 bytesToWrite() const override;
+    QString subprotocol() const override;
+    QHostAddress peerAddress() const override;
+    // Both ends are the same process
+    PeerCredentials peerCredentials() const override;
+    // Leaves messages in the channel, they are drained once resumed
+    void setReadingPaused(bool paused) override;
+    // Makes acceptor reachable as inproc://name, it gets accept(QFlow::InprocChannelPointer) invoked
+    static bool registerServer(const QString& name, QObject* acceptor);
+    static void unregisterServer(QObject* acceptor);
+public Q_SLOTS:
+    void open() override;
+    void close() override;
+private Q_SLOTS:
+    void drain();
+    void onAccepted();
+private:
+    void detach();
+    QString _name;
+    Side _side;
+    bool _closed;
+    bool _readingPaused;
+    InprocChannelPointer _channel;
+};
+}
+Q_DECLARE_METATYPE(QFlow::InprocChannelPointer)
+#endif // INPROCTRANSPORT_H
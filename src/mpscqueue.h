@@ -0,0 +1,62 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <QAtomicPointer>
+
+namespace QFlow{
+
+// Unbounded lock-free queue for many producers and one consumer (Vyukov's MPSC list).
+// push() may be called from any thread, pop() and isEmpty() only from the consumer's.
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : _tail(new Node())
+    {
+        _head.store(_tail);
+    }
+    ~MpscQueue()
+    {
+        T value;
+        while(pop(&value)) {}
+        delete _tail;
+    }
+    void push(const T& value)
+    {
+        Node* node = new Node(value);
+        Node* previous = _head.fetchAndStoreOrdered(node);
+        previous->next.storeRelease(node);
+    }
+    // False while empty, and also while a push that already started is still linking its node
+    bool pop(T* value)
+    {
+        Node* next = _tail->next.loadAcquire();
+        if(!next) return false;
+        *value = next->value;
+        next->value = T();
+        delete _tail;
+        _tail = next;
+        return true;
+    }
+    bool isEmpty() const
+    {
+        return !_tail->next.loadAcquire();
+    }
+private:
+    struct Node
+    {
+        Node()
+        {
+        }
+        explicit Node(const T& v) : value(v)
+        {
+        }
+        T value;
+        QAtomicPointer<Node> next;
+    };
+    QAtomicPointer<Node> _head;
+    Node* _tail;
+    Q_DISABLE_COPY(MpscQueue)
+};
+}
+#endif // MPSCQUEUE_H
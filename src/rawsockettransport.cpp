@@ -0,0 +1,349 @@
+#include "rawsockettransport.h"
+#include "wamp_symbols.h"
+#include "wampmessageserializer.h"
+#include <QIODevice>
+#include <QAbstractSocket>
+#include <QLocalSocket>
+#include <QThread>
+#include <QtEndian>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace QFlow{
+
+const char RAWSOCKET_MAGIC = 0x7F;
+// Longest message we accept is announced as 2^(9 + exponent) bytes, 16 MB like the default
+// decode limit, but the length field has 24 bits so a frame carries at most 2^24 - 1 bytes
+const int RAWSOCKET_MAX_LENGTH_EXPONENT = 0xF;
+const int RAWSOCKET_MAX_LENGTH = 0xFFFFFF;
+const int RAWSOCKET_HEADER_SIZE = 4;
+enum RawSocketFrameType {
+    RAWSOCKET_MESSAGE = 0,
+    RAWSOCKET_PING = 1,
+    RAWSOCKET_PONG = 2
+};
+enum RawSocketError {
+    RAWSOCKET_ERR_SERIALIZER_UNSUPPORTED = 1,
+    RAWSOCKET_ERR_MAX_LENGTH_UNACCEPTABLE = 2,
+    RAWSOCKET_ERR_RESERVED_BITS = 3
+};
+
+RawSocketTransport::RawSocketTransport(QIODevice *device, QObject *parent) : WampTransport(parent), _device(device),
+    _server(true), _state(Handshake), _readingPaused(false), _maxPeerLength(0), _pending(0)
+{
+    init();
+    setLowDelay();
+    readPeerCredentials();
+}
+RawSocketTransport::RawSocketTransport(QIODevice *device, const QStringList &subprotocols, QObject *parent) :
+    WampTransport(parent), _device(device), _server(false), _state(Connecting), _readingPaused(false), _maxPeerLength(0),
+    _pending(0)
+{
+    for(const QString& subprotocol: subprotocols)
+    {
+        if(serializerId(subprotocol))
+        {
+            _subprotocol = subprotocol;
+            break;
+        }
+    }
+    init();
+}
+RawSocketTransport::~RawSocketTransport()
+{
+
+}
+void RawSocketTransport::init()
+{
+    _device->setParent(this);
+    QObject::connect(_device, SIGNAL(connected()), this, SLOT(onConnected()));
+    QObject::connect(_device, SIGNAL(disconnected()), this, SLOT(close()));
+    QObject::connect(_device, &QIODevice::readyRead, this, &RawSocketTransport::onReadyRead);
+    QObject::connect(_device, &QIODevice::bytesWritten, this, &RawSocketTransport::onBytesWritten);
+}
+int RawSocketTransport::serializerId(const QString &subprotocol)
+{
+    if(subprotocol == KEY_WAMP_JSON_SUB) return 1;
+    if(subprotocol == KEY_WAMP_MSGPACK_SUB) return 2;
+    if(subprotocol == KEY_WAMP_CBOR_SUB) return 3;
+    return 0;
+}
+QString RawSocketTransport::serializerSubprotocol(int serializerId)
+{
+    switch(serializerId)
+    {
+    case 1:
+        return KEY_WAMP_JSON_SUB;
+    case 2:
+        return KEY_WAMP_MSGPACK_SUB;
+    case 3:
+        return KEY_WAMP_CBOR_SUB;
+    default:
+        return QString();
+    }
+}
+// The handshake goes out once connected() arrives, unless the device is connected already
+void RawSocketTransport::open()
+{
+    QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(_device);
+    QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(_device);
+    bool connected = socket ? socket->state() == QAbstractSocket::ConnectedState :
+                     localSocket ? localSocket->state() == QLocalSocket::ConnectedState : _device->isOpen();
+    if(connected) onConnected();
+}
+// Messages are small and latency bound, TCP sockets should not wait to fill segments
+void RawSocketTransport::setLowDelay()
+{
+    QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(_device);
+    if(socket) socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+}
+// Local sockets: the kernel records who connected, which lets authenticators trust local daemons
+void RawSocketTransport::readPeerCredentials()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(_device);
+    if(!socket || socket->socketDescriptor() == -1) return;
+    int fd = int(socket->socketDescriptor());
+#if defined(Q_OS_LINUX)
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if(::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0)
+    {
+        _peerCredentials.valid = true;
+        _peerCredentials.pid = credentials.pid;
+        _peerCredentials.uid = credentials.uid;
+        _peerCredentials.gid = credentials.gid;
+    }
+#elif defined(Q_OS_UNIX)
+    uid_t uid;
+    gid_t gid;
+    if(::getpeereid(fd, &uid, &gid) == 0)
+    {
+        _peerCredentials.valid = true;
+        _peerCredentials.uid = uid;
+        _peerCredentials.gid = gid;
+    }
+#else
+    Q_UNUSED(fd);
+#endif
+}
+void RawSocketTransport::onConnected()
+{
+    if(_server || _state != Connecting) return;
+    setLowDelay();
+    if(_subprotocol.isEmpty())
+    {
+        qWarning() << "RawSocket: no serializer to offer";
+        close();
+        return;
+    }
+    _state = Handshake;
+    char handshake[4] = {RAWSOCKET_MAGIC, char((RAWSOCKET_MAX_LENGTH_EXPONENT << 4) | serializerId(_subprotocol)), 0, 0};
+    write(QByteArray(handshake, sizeof(handshake)));
+}
+// Server: validates the client's request and answers it. Client: checks the server's answer.
+bool RawSocketTransport::readHandshake()
+{
+    if(_buffer.size() < 4) return false;
+    const uchar* handshake = reinterpret_cast<const uchar*>(_buffer.constData());
+    if(handshake[0] != uchar(RAWSOCKET_MAGIC))
+    {
+        qWarning() << "RawSocket: peer does not speak RawSocket";
+        close();
+        return false;
+    }
+    int exponent = handshake[1] >> 4;
+    int serializer = handshake[1] & 0x0F;
+    bool reserved = handshake[2] || handshake[3];
+    _buffer.remove(0, 4);
+    if(_server)
+    {
+        QString subprotocol = serializerSubprotocol(serializer);
+        if(reserved)
+        {
+            fail(RAWSOCKET_ERR_RESERVED_BITS);
+            return false;
+        }
+        if(subprotocol.isEmpty() || !WampMessageSerializer::subprotocols().contains(subprotocol))
+        {
+            fail(RAWSOCKET_ERR_SERIALIZER_UNSUPPORTED);
+            return false;
+        }
+        _subprotocol = subprotocol;
+        char answer[4] = {RAWSOCKET_MAGIC, char((RAWSOCKET_MAX_LENGTH_EXPONENT << 4) | serializer), 0, 0};
+        write(QByteArray(answer, sizeof(answer)));
+    }
+    else
+    {
+        if(serializer == 0)
+        {
+            qWarning() << QString("RawSocket: handshake rejected with error %1").arg(exponent);
+            close();
+            return false;
+        }
+        if(serializerSubprotocol(serializer) != _subprotocol)
+        {
+            qWarning() << "RawSocket: server answered with another serializer";
+            close();
+            return false;
+        }
+    }
+    _maxPeerLength = qMin(1 << (9 + exponent), RAWSOCKET_MAX_LENGTH);
+    _state = Open;
+    Q_EMIT opened();
+    return true;
+}
+void RawSocketTransport::fail(int error)
+{
+    char answer[4] = {RAWSOCKET_MAGIC, char(error << 4), 0, 0};
+    write(QByteArray(answer, sizeof(answer)));
+    close();
+}
+void RawSocketTransport::setReadingPaused(bool paused)
+{
+    if(_readingPaused == paused) return;
+    _readingPaused = paused;
+    // 0 is unbounded, a bounded buffer makes Qt stop reading from the kernel once it is full
+    qint64 bufferSize = paused ? RAWSOCKET_HEADER_SIZE + RAWSOCKET_MAX_LENGTH : 0;
+    QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(_device);
+    QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(_device);
+    if(socket) socket->setReadBufferSize(bufferSize);
+    else if(localSocket) localSocket->setReadBufferSize(bufferSize);
+    // frames that arrived meanwhile wait in the buffers without a new readyRead()
+    if(!paused) QMetaObject::invokeMethod(this, "onReadyRead", Qt::QueuedConnection);
+}
+void RawSocketTransport::onReadyRead()
+{
+    if(_readingPaused) return;
+    _buffer.append(_device->readAll());
+    if(_state == Handshake && !readHandshake()) return;
+    if(_state != Open) return;
+    int offset = 0;
+    while(_buffer.size() - offset >= RAWSOCKET_HEADER_SIZE)
+    {
+        const uchar* header = reinterpret_cast<const uchar*>(_buffer.constData() + offset);
+        int type = header[0] & 0x07;
+        int length = (int(header[1]) << 16) | (int(header[2]) << 8) | int(header[3]);
+        if((header[0] & 0xF8) || length > RAWSOCKET_MAX_LENGTH)
+        {
+            qWarning() << "RawSocket: invalid frame header";
+            close();
+            return;
+        }
+        if(_buffer.size() - offset - RAWSOCKET_HEADER_SIZE < length) break;
+        QByteArray payload = _buffer.mid(offset + RAWSOCKET_HEADER_SIZE, length);
+        offset += RAWSOCKET_HEADER_SIZE + length;
+        if(type == RAWSOCKET_MESSAGE)
+        {
+            Q_EMIT messageReceived(payload);
+            if(_state != Open) return;
+            if(_readingPaused) break;
+        }
+        else if(type == RAWSOCKET_PING)
+        {
+            QByteArray pong;
+            appendFrame(pong, payload, RAWSOCKET_PONG);
+            enqueue(pong);
+        }
+    }
+    _buffer.remove(0, offset);
+}
+void RawSocketTransport::appendFrame(QByteArray &out, const QByteArray &message, int type, const QByteArray &payload)
+{
+    int length = message.size() + payload.size();
+    char header[RAWSOCKET_HEADER_SIZE] = {char(type), char(length >> 16), char(length >> 8), char(length)};
+    out.append(header, RAWSOCKET_HEADER_SIZE);
+    out.append(message);
+    out.append(payload);
+}
+void RawSocketTransport::send(const QByteArray &message, bool /*binary*/)
+{
+    if(message.size() > _maxPeerLength)
+    {
+        tooLong(message.size());
+        return;
+    }
+    QByteArray frame;
+    frame.reserve(RAWSOCKET_HEADER_SIZE + message.size());
+    appendFrame(frame, message, RAWSOCKET_MESSAGE);
+    enqueue(frame);
+}
+void RawSocketTransport::sendBatch(const QList<FrameBatcher::Frame> &frames)
+{
+    int size = 0;
+    for(const FrameBatcher::Frame& frame: frames) size += RAWSOCKET_HEADER_SIZE + frame.size();
+    QByteArray data;
+    data.reserve(size);
+    for(const FrameBatcher::Frame& frame: frames)
+    {
+        if(frame.size() > _maxPeerLength)
+        {
+            tooLong(frame.size());
+            return;
+        }
+        // the shared payload is gathered straight into the write buffer
+        appendFrame(data, frame.data, RAWSOCKET_MESSAGE, frame.payload);
+    }
+    enqueue(data);
+}
+// Dropping the message would leave the peer waiting for an answer that never comes, the
+// connection is closed instead so its calls fail. Called from any thread.
+void RawSocketTransport::tooLong(int size)
+{
+    qWarning() << QString("RawSocket: message of %1 bytes exceeds the peer's limit, closing").arg(size);
+    QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+}
+bool RawSocketTransport::writesBatches() const
+{
+    return true;
+}
+// Frames are built by the calling thread, only the write itself happens in the transport's
+void RawSocketTransport::enqueue(const QByteArray &data)
+{
+    if(data.isEmpty()) return;
+    if(QThread::currentThread() == thread()) write(data);
+    else QMetaObject::invokeMethod(this, "write", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+}
+void RawSocketTransport::write(const QByteArray &data)
+{
+    if(_state == Closed) return;
+    _pending.fetchAndAddRelaxed(data.size());
+    _device->write(data);
+}
+void RawSocketTransport::onBytesWritten(qint64 bytes)
+{
+    _pending.fetchAndAddRelaxed(-bytes);
+    if(_state == Open) Q_EMIT bytesWritten(bytes);
+}
+qint64 RawSocketTransport::bytesToWrite() const
+{
+    return qMax<qint64>(0, _pending.load());
+}
+QString RawSocketTransport::subprotocol() const
+{
+    return _subprotocol;
+}
+QHostAddress RawSocketTransport::peerAddress() const
+{
+    QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(_device);
+    return socket ? socket->peerAddress() : QHostAddress(QHostAddress::LocalHost);
+}
+PeerCredentials RawSocketTransport::peerCredentials() const
+{
+    return _peerCredentials;
+}
+QIODevice* RawSocketTransport::device() const
+{
+    return _device;
+}
+void RawSocketTransport::close()
+{
+    if(_state == Closed) return;
+    _state = Closed;
+    _device->close();
+    Q_EMIT closed();
+}
+}
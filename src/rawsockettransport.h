@@ -0,0 +1,75 @@
+#ifndef RAWSOCKETTRANSPORT_H
+#define RAWSOCKETTRANSPORT_H
+
+#include "wamptransport.h"
+#include <QAtomicInteger>
+#include <QStringList>
+
+class QIODevice;
+
+namespace QFlow{
+
+// Used by rawsocket:// URLs without a port
+const int DEFAULT_RAWSOCKET_PORT = 8081;
+
+// WAMP RawSocket framing over a stream socket (QTcpSocket or QLocalSocket). A 4 byte handshake negotiates the serializer
+// and the maximum message length of each side, then every message travels behind a 4 byte
+// header holding its type (message, ping or pong) and a 24 bit length.
+class RawSocketTransport : public WampTransport
+{
+    Q_OBJECT
+public:
+    // Server side, answers the client's handshake. Takes ownership of device.
+    explicit RawSocketTransport(QIODevice* device, QObject* parent = NULL);
+    // Client side, asks for the first subprotocol RawSocket has a serializer id for.
+    // The handshake is sent once device is connected.
+    RawSocketTransport(QIODevice* device, const QStringList& subprotocols, QObject* parent = NULL);
+    ~RawSocketTransport();
+    void send(const QByteArray& message, bool binary) override;
+    // Writes the whole batch with a single write
+    void sendBatch(const QList<FrameBatcher::Frame>& frames) override;
+    bool writesBatches() const override;
+    qint64 bytesToWrite() const override;
+    QString subprotocol() const override;
+    QHostAddress peerAddress() const override;
+    PeerCredentials peerCredentials() const override;
+    // Stops reading from the socket once its read buffer is full, so the kernel closes the window
+    void setReadingPaused(bool paused) override;
+    QIODevice* device() const;
+    static int serializerId(const QString& subprotocol);
+    static QString serializerSubprotocol(int serializerId);
+public Q_SLOTS:
+    void open() override;
+    void close() override;
+private Q_SLOTS:
+    void onConnected();
+    void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void write(const QByteArray& data);
+private:
+    enum State {
+        Connecting,
+        Handshake,
+        Open,
+        Closed
+    };
+    void init();
+    void setLowDelay();
+    void readPeerCredentials();
+    bool readHandshake();
+    void fail(int error = 0);
+    void appendFrame(QByteArray& out, const QByteArray& message, int type, const QByteArray& payload = QByteArray());
+    void enqueue(const QByteArray& data);
+    void tooLong(int size);
+    QIODevice* _device;
+    bool _server;
+    State _state;
+    QString _subprotocol;
+    QByteArray _buffer;
+    bool _readingPaused;
+    int _maxPeerLength;
+    QAtomicInteger<qint64> _pending;
+    PeerCredentials _peerCredentials;
+};
+}
+#endif // RAWSOCKETTRANSPORT_H
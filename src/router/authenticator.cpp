@@ -9,7 +9,7 @@ AuthSession::AuthSession() : user(NULL)
 
 }
 AuthSession::AuthSession(const AuthSession &other) : challenge(other.challenge), authenticator(other.authenticator),
-    user(other.user), inBuffer(other.inBuffer)
+    user(other.user), inBuffer(other.inBuffer), peer(other.peer)
 {
 
 }
@@ -63,10 +63,18 @@ User* Authenticator::user(QString userName) const
 {
     return _users[userName];
 }
+User* Authenticator::user(QString userName, const PeerCredentials &/*peer*/) const
+{
+    return user(userName);
+}
 QVariantMap Authenticator::generateChallenge(qulonglong /*sessionId*/, QString /*authId*/)
 {
     return QVariantMap();
 }
+QVariantMap Authenticator::generateChallenge(qulonglong sessionId, QString authId, const PeerCredentials &/*peer*/)
+{
+    return generateChallenge(sessionId, authId);
+}
 
 QString Authenticator::authMethod() const
 {
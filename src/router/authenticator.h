@@ -4,6 +4,7 @@
 #include "wamp_global.h"
 #include "symbols.h"
 #include "role.h"
+#include "wamptransport.h"
 #include <QObject>
 #include <QUrl>
 #include <QJsonObject>
@@ -27,6 +28,8 @@ public:
     QPointer<User> user;
     QByteArray inBuffer;
     QByteArray outBuffer;
+    // Set for sessions over a local socket, lets authenticators trust the peer process
+    PeerCredentials peer;
     AuthSession();
     AuthSession(const AuthSession &other);
     virtual ~AuthSession();
@@ -46,10 +49,14 @@ public:
     Authenticator(QObject* parent = NULL);
     virtual ~Authenticator();
     virtual QVariantMap generateChallenge(qulonglong sessionId, QString authId) = 0;
+    // With the credentials of a local peer, which are invalid for network sessions. The defaults
+    // ignore them; authenticators that trust local processes override these.
+    virtual QVariantMap generateChallenge(qulonglong sessionId, QString authId, const PeerCredentials& peer);
     virtual QString authMethod() const = 0;
     QQmlListProperty<User> users();
     bool containsUser(QString userName) const;
     User* user(QString userName) const;
+    virtual User* user(QString userName, const PeerCredentials& peer) const;
     virtual AuthSession* createSession() const = 0;
     virtual User* getUser(AuthSession* session) = 0;
 protected:
@@ -0,0 +1,70 @@
+#include "eventfanout.h"
+#include "wamp_symbols.h"
+#include <QThreadStorage>
+#include <QSharedPointer>
+
+namespace QFlow{
+
+typedef QHash<QString, QSharedPointer<WampMessageSerializer>> SerializerCache;
+static QThreadStorage<SerializerCache> serializers;
+
+EventFanout::EventFanout(qulonglong publicationId, const QVariantList &args, const QVariantMap &kwargs) :
+    _publicationId(publicationId), _publisher(NULL), _decoded(true)
+{
+    if(!args.isEmpty() || !kwargs.isEmpty()) _elements.append(QVariant(args));
+    if(!kwargs.isEmpty()) _elements.append(QVariant(kwargs));
+}
+EventFanout::EventFanout(qulonglong publicationId, const WampPayload &payload) :
+    _publicationId(publicationId), _publisher(NULL), _source(payload), _decoded(false)
+{
+    _payloads.insert(payload.format, payload);
+}
+EventFanout::~EventFanout()
+{
+
+}
+qulonglong EventFanout::publicationId() const
+{
+    return _publicationId;
+}
+WampRouterSession* EventFanout::publisher() const
+{
+    return _publisher;
+}
+void EventFanout::setPublisher(WampRouterSession *publisher)
+{
+    _publisher = publisher;
+}
+WampMessageSerializer* EventFanout::serializer(const QString &format)
+{
+    QSharedPointer<WampMessageSerializer>& serializer = serializers.localData()[format];
+    if(!serializer) serializer.reset(WampMessageSerializer::create(format));
+    return serializer.data();
+}
+EventFanout::Frame EventFanout::frame(qulonglong subscriptionId, const QString &format, const QVariantMap &details)
+{
+    WampMessageSerializer* s = serializer(format);
+    if(!_payloads.contains(format))
+    {
+        decode();
+        _payloads.insert(format, s->serializePayload(_elements));
+    }
+    const WampPayload& payload = _payloads[format];
+    if(!_tails.contains(format)) _tails.insert(format, s->serializeTail(payload));
+    QVariantList head{(int)WampMsgCode::EVENT, subscriptionId, _publicationId, details};
+    return {s->serializeHead(head, payload), _tails.value(format)};
+}
+QVariantList EventFanout::message(qulonglong subscriptionId, const QVariantMap &details)
+{
+    decode();
+    QVariantList message{(int)WampMsgCode::EVENT, subscriptionId, _publicationId, details};
+    message.append(_elements);
+    return message;
+}
+void EventFanout::decode()
+{
+    if(_decoded) return;
+    _elements = serializer(_source.format)->deserializePayload(_source);
+    _decoded = true;
+}
+}
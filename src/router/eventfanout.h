@@ -0,0 +1,48 @@
+#ifndef EVENTFANOUT_H
+#define EVENTFANOUT_H
+
+#include "wampmessageserializer.h"
+#include <QHash>
+
+namespace QFlow{
+
+class WampRouterSession;
+
+// Builds the EVENT frames of one publication. The args/kwargs payload is encoded
+// at most once per serializer format into a tail that all subscribers of that format
+// share; every subscriber only gets its own head (subscription id, publication id,
+// details) and the transport writes both parts without joining them.
+// A payload received from the publisher is reused as is for subscribers of its format
+// and decoded only if a subscriber negotiated another format.
+class EventFanout
+{
+public:
+    struct Frame
+    {
+        QByteArray head;
+        QByteArray tail;
+    };
+    EventFanout(qulonglong publicationId, const QVariantList& args, const QVariantMap& kwargs = QVariantMap());
+    EventFanout(qulonglong publicationId, const WampPayload& payload);
+    ~EventFanout();
+    qulonglong publicationId() const;
+    // Session the publication came from, held back by congested subscribers
+    WampRouterSession* publisher() const;
+    void setPublisher(WampRouterSession* publisher);
+    Frame frame(qulonglong subscriptionId, const QString& format, const QVariantMap& details = QVariantMap());
+    // Unencoded EVENT for in-process subscribers
+    QVariantList message(qulonglong subscriptionId, const QVariantMap& details = QVariantMap());
+private:
+    // Serializers live as long as the thread publishing through them
+    static WampMessageSerializer* serializer(const QString& format);
+    void decode();
+    qulonglong _publicationId;
+    WampRouterSession* _publisher;
+    QVariantList _elements;
+    WampPayload _source;
+    bool _decoded;
+    QHash<QString, WampPayload> _payloads;
+    QHash<QString, QByteArray> _tails;
+};
+}
+#endif // EVENTFANOUT_H
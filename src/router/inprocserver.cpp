@@ -0,0 +1,20 @@
+#include "inprocserver.h"
+
+namespace QFlow{
+
+InprocServer::InprocServer(QObject *parent) : QObject(parent)
+{
+}
+InprocServer::~InprocServer()
+{
+    InprocTransport::unregisterServer(this);
+}
+bool InprocServer::listen(const QString &name)
+{
+    return InprocTransport::registerServer(name, this);
+}
+void InprocServer::accept(InprocChannelPointer channel)
+{
+    Q_EMIT newConnection(new InprocTransport(channel));
+}
+}
@@ -0,0 +1,25 @@
+#ifndef INPROCSERVER_H
+#define INPROCSERVER_H
+
+#include "inproctransport.h"
+#include <QObject>
+
+namespace QFlow{
+
+// Accepts in-process connections for the realms of one router. Accepted transports are handed
+// out right away; the receiver takes ownership of them.
+class InprocServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InprocServer(QObject* parent = NULL);
+    ~InprocServer();
+    // Fails if another router in this process already serves name
+    bool listen(const QString& name);
+Q_SIGNALS:
+    void newConnection(WampTransport* transport);
+public Q_SLOTS:
+    void accept(QFlow::InprocChannelPointer channel);
+};
+}
+#endif // INPROCSERVER_H
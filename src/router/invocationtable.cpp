@@ -0,0 +1,136 @@
+#include "invocationtable.h"
+#include "wamprouter_p.h"
+
+namespace QFlow{
+
+// WAMP ids must fit into 53 bits: 21 bits of generation above a 32 bit slot index
+const quint32 GENERATION_MASK = 0x1FFFFF;
+
+InvocationTable::InvocationTable() : _freeHead(-1), _size(0)
+{
+}
+InvocationTable::~InvocationTable()
+{
+
+}
+qulonglong InvocationTable::insert(const PendingInvocation &invocation)
+{
+    int index = _freeHead;
+    if(index >= 0)
+    {
+        _freeHead = _slots[index].nextFree;
+    }
+    else
+    {
+        index = _slots.size();
+        _slots.append(Slot());
+    }
+    Slot& slot = _slots[index];
+    slot.used = true;
+    slot.invocation = invocation;
+    slot.invocation.invocationId = (quint64(slot.generation) << 32) | quint64(index + 1);
+    link(index, CallerChain);
+    link(index, CalleeChain);
+    _calls.insert(qMakePair(invocation.caller, invocation.callerRequestId), index);
+    _size++;
+    return slot.invocation.invocationId;
+}
+PendingInvocation InvocationTable::take(qulonglong invocationId, WampRouterSession *callee)
+{
+    int index = indexOf(invocationId, callee);
+    if(index < 0) return PendingInvocation();
+    PendingInvocation invocation = _slots[index].invocation;
+    release(index);
+    return invocation;
+}
+PendingInvocation* InvocationTable::find(qulonglong invocationId, WampRouterSession *callee)
+{
+    int index = indexOf(invocationId, callee);
+    return index >= 0 ? &_slots[index].invocation : NULL;
+}
+PendingInvocation* InvocationTable::call(WampRouterSession *caller, qulonglong requestId)
+{
+    int index = _calls.value(qMakePair(caller, requestId), -1);
+    return index >= 0 ? &_slots[index].invocation : NULL;
+}
+QList<PendingInvocation> InvocationTable::takeCaller(WampRouterSession *caller)
+{
+    return takeChain(CallerChain, caller);
+}
+QList<PendingInvocation> InvocationTable::takeCallee(WampRouterSession *callee)
+{
+    return takeChain(CalleeChain, callee);
+}
+int InvocationTable::size() const
+{
+    return _size;
+}
+int InvocationTable::indexOf(qulonglong invocationId, WampRouterSession *callee) const
+{
+    int index = int(invocationId & 0xFFFFFFFF) - 1;
+    if(index < 0 || index >= _slots.size()) return -1;
+    const Slot& slot = _slots[index];
+    if(!slot.used || slot.generation != quint32(invocationId >> 32)) return -1;
+    if(callee && chainOwner(slot, CalleeChain) != callee) return -1;
+    return index;
+}
+WampRouterSession* InvocationTable::chainOwner(const Slot &slot, Chain chain) const
+{
+    if(chain == CallerChain) return slot.invocation.caller;
+    return slot.invocation.callee ? slot.invocation.callee->session() : NULL;
+}
+void InvocationTable::link(int index, Chain chain)
+{
+    WampRouterSession* owner = chainOwner(_slots[index], chain);
+    int head = _heads[chain].value(owner, -1);
+    _slots[index].prev[chain] = -1;
+    _slots[index].next[chain] = head;
+    if(head >= 0) _slots[head].prev[chain] = index;
+    _heads[chain].insert(owner, index);
+}
+void InvocationTable::unlink(int index, Chain chain)
+{
+    Slot& slot = _slots[index];
+    int prev = slot.prev[chain];
+    int next = slot.next[chain];
+    if(next >= 0) _slots[next].prev[chain] = prev;
+    if(prev >= 0)
+    {
+        _slots[prev].next[chain] = next;
+    }
+    else
+    {
+        WampRouterSession* owner = chainOwner(slot, chain);
+        if(next >= 0) _heads[chain].insert(owner, next);
+        else _heads[chain].remove(owner);
+    }
+    slot.prev[chain] = slot.next[chain] = -1;
+}
+void InvocationTable::release(int index)
+{
+    unlink(index, CallerChain);
+    unlink(index, CalleeChain);
+    Slot& slot = _slots[index];
+    QPair<WampRouterSession*, qulonglong> call(slot.invocation.caller, slot.invocation.callerRequestId);
+    if(_calls.value(call, -1) == index) _calls.remove(call);
+    slot.used = false;
+    slot.generation = (slot.generation + 1) & GENERATION_MASK;
+    slot.invocation = PendingInvocation();
+    slot.nextFree = _freeHead;
+    _freeHead = index;
+    _size--;
+}
+QList<PendingInvocation> InvocationTable::takeChain(Chain chain, WampRouterSession *session)
+{
+    QList<PendingInvocation> invocations;
+    int index = _heads[chain].value(session, -1);
+    while(index >= 0)
+    {
+        int next = _slots[index].next[chain];
+        invocations.append(_slots[index].invocation);
+        release(index);
+        index = next;
+    }
+    return invocations;
+}
+}
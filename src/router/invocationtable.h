@@ -0,0 +1,88 @@
+#ifndef INVOCATIONTABLE_H
+#define INVOCATIONTABLE_H
+
+#include <QHash>
+#include <QPair>
+#include <QList>
+#include <QVector>
+#include <QSharedPointer>
+
+namespace QFlow{
+
+class WampRouterSession;
+class WampRouterCallee;
+typedef QSharedPointer<WampRouterCallee> WampRouterCalleePointer;
+
+struct PendingInvocation
+{
+    PendingInvocation() : invocationId(0), registrationId(0), caller(NULL), callerRequestId(0), deadline(0),
+        canceled(false), receiveProgress(false), progressiveCall(false)
+    {
+    }
+    qulonglong invocationId;
+    qulonglong registrationId;
+    WampRouterSession* caller;
+    qulonglong callerRequestId;
+    WampRouterCalleePointer callee;
+    // msecs since epoch, 0 for none
+    qint64 deadline;
+    // canceled in kill mode, waiting for the callee to give up
+    bool canceled;
+    // caller asked for progressive results
+    bool receiveProgress;
+    // caller streams its arguments, more CALLs with the same request id follow
+    bool progressiveCall;
+};
+
+// Invocations in flight, keyed by router-assigned INVOCATION ids. Entries live in a slab and
+// an id encodes the slot index and the slot's generation, so lookups and releases are O(1)
+// and a stale id never hits a recycled slot. Entries are also chained per caller and per
+// callee session so a disconnect releases its entries without scanning the table.
+// Not thread-safe, RealmPrivate guards it.
+class InvocationTable
+{
+public:
+    InvocationTable();
+    ~InvocationTable();
+    qulonglong insert(const PendingInvocation& invocation);
+    // Releases an entry; with callee set only if that session was invoked
+    PendingInvocation take(qulonglong invocationId, WampRouterSession* callee = NULL);
+    // Same lookup as take without releasing, valid until the table is modified
+    PendingInvocation* find(qulonglong invocationId, WampRouterSession* callee = NULL);
+    // Entry of a caller's CALL, valid until the table is modified
+    PendingInvocation* call(WampRouterSession* caller, qulonglong requestId);
+    QList<PendingInvocation> takeCaller(WampRouterSession* caller);
+    QList<PendingInvocation> takeCallee(WampRouterSession* callee);
+    int size() const;
+private:
+    enum Chain {
+        CallerChain = 0,
+        CalleeChain = 1
+    };
+    struct Slot
+    {
+        Slot() : generation(0), used(false), nextFree(-1)
+        {
+            prev[0] = prev[1] = next[0] = next[1] = -1;
+        }
+        quint32 generation;
+        bool used;
+        int nextFree;
+        int prev[2];
+        int next[2];
+        PendingInvocation invocation;
+    };
+    int indexOf(qulonglong invocationId, WampRouterSession* callee) const;
+    WampRouterSession* chainOwner(const Slot& slot, Chain chain) const;
+    void link(int index, Chain chain);
+    void unlink(int index, Chain chain);
+    void release(int index);
+    QList<PendingInvocation> takeChain(Chain chain, WampRouterSession* session);
+    QVector<Slot> _slots;
+    int _freeHead;
+    int _size;
+    QHash<WampRouterSession*, int> _heads[2];
+    QHash<QPair<WampRouterSession*, qulonglong>, int> _calls;
+};
+}
+#endif // INVOCATIONTABLE_H
@@ -0,0 +1,97 @@
+#include "outboundqueue.h"
+
+namespace QFlow{
+
+OutboundQueue::OutboundQueue(int limit, WampRouter::SlowConsumerPolicy policy) : _limit(qMax(1, limit)),
+    _policy(policy), _dropped(0), _drainScheduled(false), _congested(false), _closed(false)
+{
+}
+OutboundQueue::~OutboundQueue()
+{
+
+}
+OutboundQueue::PushResult OutboundQueue::push(const OutboundMessage &message, bool *scheduleDrain)
+{
+    QMutexLocker lock(&_mutex);
+    *scheduleDrain = false;
+    if(_closed) return Dropped;
+    if(_messages.size() >= _limit)
+    {
+        // replies and errors cannot be dropped without breaking the session
+        if(!message.droppable) return Overflow;
+        switch(_policy)
+        {
+        case WampRouter::DropNewest:
+            _dropped++;
+            return Dropped;
+        case WampRouter::DropOldest:
+        {
+            QQueue<OutboundMessage>::iterator it = _messages.begin();
+            while(it != _messages.end() && !it->droppable) ++it;
+            _dropped++;
+            if(it == _messages.end()) return Dropped;
+            _messages.erase(it);
+            break;
+        }
+        case WampRouter::DisconnectSlowConsumer:
+            _dropped++;
+            return Overflow;
+        case WampRouter::BlockPublisher:
+            // the publishers were held back at half the limit, what they still sent is lost
+            _dropped++;
+            return Dropped;
+        }
+    }
+    _messages.enqueue(message);
+    if(!_drainScheduled)
+    {
+        _drainScheduled = true;
+        *scheduleDrain = true;
+    }
+    if(_policy == WampRouter::BlockPublisher && message.droppable && _messages.size() >= _limit / 2)
+    {
+        _congested = true;
+        return Congested;
+    }
+    return Queued;
+}
+bool OutboundQueue::take(OutboundMessage *message, bool *relieved)
+{
+    QMutexLocker lock(&_mutex);
+    *relieved = false;
+    if(_messages.isEmpty())
+    {
+        _drainScheduled = false;
+        return false;
+    }
+    *message = _messages.dequeue();
+    if(_congested && _messages.size() <= _limit / 4)
+    {
+        _congested = false;
+        *relieved = true;
+    }
+    return true;
+}
+bool OutboundQueue::isCongested() const
+{
+    QMutexLocker lock(&_mutex);
+    return _congested;
+}
+void OutboundQueue::close()
+{
+    QMutexLocker lock(&_mutex);
+    _closed = true;
+    _congested = false;
+    _messages.clear();
+}
+int OutboundQueue::depth() const
+{
+    QMutexLocker lock(&_mutex);
+    return _messages.size();
+}
+quint64 OutboundQueue::dropped() const
+{
+    QMutexLocker lock(&_mutex);
+    return _dropped;
+}
+}
@@ -0,0 +1,63 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include "wamprouter.h"
+#include <QMutex>
+#include <QQueue>
+#include <QVariant>
+
+namespace QFlow{
+
+struct OutboundMessage
+{
+    OutboundMessage() : droppable(false)
+    {
+    }
+    // a message still to be serialized, or an already encoded frame
+    QVariantList message;
+    QByteArray frame;
+    // encoded tail of frame shared with other sessions, see FrameBatcher::Frame
+    QByteArray payload;
+    // EVENTs may be dropped by the slow consumer policies, everything else is always queued
+    bool droppable;
+};
+
+// Messages waiting for a session's socket. Producers push from any thread and the session
+// drains on its own thread while the socket's pending bytes stay below the high watermark.
+// Never more than limit messages wait: once full the slow consumer policy decides the fate of
+// new EVENTs, any other message overflows the queue. Under BlockPublisher the queue turns
+// congested at half the limit, publishers are expected to stop reading until it is relieved.
+class OutboundQueue
+{
+public:
+    enum PushResult {
+        Queued,
+        // queued, but the publisher has to be held back
+        Congested,
+        Dropped,
+        Overflow
+    };
+    OutboundQueue(int limit, WampRouter::SlowConsumerPolicy policy);
+    ~OutboundQueue();
+    // scheduleDrain is set when the consumer has to be woken up to drain the queue
+    PushResult push(const OutboundMessage& message, bool* scheduleDrain);
+    // Returns false and clears the scheduled state when empty, so the next push wakes the consumer.
+    // relieved is set when the queue stopped being congested with this message.
+    bool take(OutboundMessage* message, bool* relieved);
+    bool isCongested() const;
+    // Discards everything and releases blocked producers
+    void close();
+    int depth() const;
+    quint64 dropped() const;
+private:
+    mutable QMutex _mutex;
+    QQueue<OutboundMessage> _messages;
+    int _limit;
+    WampRouter::SlowConsumerPolicy _policy;
+    quint64 _dropped;
+    bool _drainScheduled;
+    bool _congested;
+    bool _closed;
+};
+}
+#endif // OUTBOUNDQUEUE_H
@@ -0,0 +1,85 @@
+#include "rawsocketserver.h"
+#include "rawsockettransport.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+
+namespace QFlow{
+
+// Peers that connected but did not complete the handshake by then are dropped
+const int RAWSOCKET_HANDSHAKE_TIMEOUT_MS = 5000;
+
+RawSocketServer::RawSocketServer(QObject *parent) : QObject(parent), _server(NULL), _localServer(NULL)
+{
+}
+RawSocketServer::~RawSocketServer()
+{
+
+}
+bool RawSocketServer::listen(const QHostAddress &address, quint16 port)
+{
+    if(!_server)
+    {
+        _server = new QTcpServer(this);
+        QObject::connect(_server, &QTcpServer::newConnection, this, &RawSocketServer::onNewConnection);
+    }
+    return _server->listen(address, port);
+}
+bool RawSocketServer::listen(const QString &path)
+{
+    if(!_localServer)
+    {
+        _localServer = new QLocalServer(this);
+        QObject::connect(_localServer, &QLocalServer::newConnection, this, &RawSocketServer::onNewLocalConnection);
+    }
+    return listenLocal(_localServer, path);
+}
+bool RawSocketServer::listenLocal(QLocalServer *server, const QString &path)
+{
+    if(server->listen(path)) return true;
+    if(server->serverError() != QAbstractSocket::AddressInUseError) return false;
+    QLocalSocket probe;
+    probe.connectToServer(path);
+    if(probe.waitForConnected(1000) || probe.error() != QLocalSocket::ConnectionRefusedError) return false;
+    QLocalServer::removeServer(path);
+    return server->listen(path);
+}
+QString RawSocketServer::errorString() const
+{
+    if(_localServer) return _localServer->errorString();
+    return _server ? _server->errorString() : QString();
+}
+void RawSocketServer::onNewConnection()
+{
+    while(QTcpSocket* socket = _server->nextPendingConnection())
+    {
+        addTransport(new RawSocketTransport(socket));
+    }
+}
+void RawSocketServer::onNewLocalConnection()
+{
+    while(QLocalSocket* socket = _localServer->nextPendingConnection())
+    {
+        addTransport(new RawSocketTransport(socket));
+    }
+}
+void RawSocketServer::addTransport(RawSocketTransport *transport)
+{
+    QObject::connect(transport, &WampTransport::opened, this, &RawSocketServer::onOpened);
+    QObject::connect(transport, &WampTransport::closed, transport, &QObject::deleteLater);
+    QTimer* timeout = new QTimer(transport);
+    timeout->setSingleShot(true);
+    QObject::connect(timeout, &QTimer::timeout, transport, &WampTransport::close);
+    QObject::connect(transport, &WampTransport::opened, timeout, &QObject::deleteLater);
+    timeout->start(RAWSOCKET_HANDSHAKE_TIMEOUT_MS);
+}
+void RawSocketServer::onOpened()
+{
+    WampTransport* transport = qobject_cast<WampTransport*>(sender());
+    QObject::disconnect(transport, NULL, this, NULL);
+    QObject::disconnect(transport, &WampTransport::closed, transport, &QObject::deleteLater);
+    Q_EMIT newConnection(transport);
+}
+}
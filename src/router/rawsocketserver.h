@@ -0,0 +1,42 @@
+#ifndef RAWSOCKETSERVER_H
+#define RAWSOCKETSERVER_H
+
+#include <QObject>
+#include <QHostAddress>
+
+class QTcpServer;
+class QLocalServer;
+
+namespace QFlow{
+
+class WampTransport;
+class RawSocketTransport;
+
+// Accepts WAMP RawSocket connections over TCP or a Unix domain socket. Connections are handed out once their
+// handshake negotiated a serializer; the receiver takes ownership of the transport.
+class RawSocketServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RawSocketServer(QObject* parent = NULL);
+    ~RawSocketServer();
+    bool listen(const QHostAddress& address, quint16 port);
+    // Unix domain socket at path, a stale socket file left behind by a crashed router is removed
+    bool listen(const QString& path);
+    QString errorString() const;
+    // Makes server listen on path. An existing socket file is only removed once connecting to it
+    // was refused, a router still serving it keeps it.
+    static bool listenLocal(QLocalServer* server, const QString& path);
+Q_SIGNALS:
+    void newConnection(WampTransport* transport);
+private Q_SLOTS:
+    void onNewConnection();
+    void onNewLocalConnection();
+    void onOpened();
+private:
+    void addTransport(RawSocketTransport* transport);
+    QTcpServer* _server;
+    QLocalServer* _localServer;
+};
+}
+#endif // RAWSOCKETSERVER_H
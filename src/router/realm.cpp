@@ -4,10 +4,11 @@
 #include "authenticator.h"
 #include "random.h"
 #include "treeitem.h"
+#include "eventfanout.h"
 
 namespace QFlow{
 
-RealmPrivate::RealmPrivate()
+RealmPrivate::RealmPrivate() : _invocationDeadlines(INVOCATION_DEADLINE_RESOLUTION_MS, QDateTime::currentMSecsSinceEpoch())
 {
 
 }
@@ -25,23 +26,26 @@ Realm::Realm(QObject *parent) : WampBase(parent), d_ptr(new RealmPrivate())
     registerMethod("wamp.subscription.count_subscribers", this, "subscribersCount(QString)");
     registerProcedure(KEY_GET_SUBSCRIPTION, [this](QVariantList args){//register some object
         qulonglong subscriptionId = (qulonglong)args[0].toDouble();
-        if(!this->d_ptr->_subscriptions.contains(subscriptionId))
+        WampRouterSubscriptionPointer subscription = this->d_ptr->_subscriptions.snapshot()->byId.value(subscriptionId);
+        if(!subscription)
         {
             return WampResult(QVariant("wamp.error.no_such_subscription"));
         }
-        WampRouterSubscriptionPointer subscription = this->d_ptr->_subscriptions[subscriptionId];
         QVariantList resultArr;
         QVariantMap details;
         details["id"] = (double)subscription->subscriptionId();
         details["created"] = subscription->created().toString("yyyy-mm-ddThh:mm:zzzZ");
         details["uri"] = subscription->topic();
+        details[KEY_MATCH] = uriMatchToString(subscription->match());
         resultArr.append(details);
         return WampResult(QVariant(resultArr));
     });
     registerProcedure(KEY_LOOKUP_REGISTRATION, [this](QVariantList args){
-        QString uri = args[0].toString();
-        if(!this->d_ptr->_root.containsGenuine(uri)) return WampResult();
-        WampRouterRegistrationPointer registration = this->d_ptr->_root.findData(uri);
+        QString uri = args.value(0).toString();
+        UriMatch match;
+        if(!uriMatchFromString(args.value(1).toMap().value(KEY_MATCH).toString(), &match)) return WampResult();
+        WampRouterRegistrationPointer registration = this->d_ptr->getRegistration(uri, this->d_ptr->_atoms.find(uri), match);
+        if(!registration) return WampResult();
         return WampResult(QVariant(registration->registrationId()));
     });
 
@@ -82,34 +86,32 @@ Authenticator* Realm::findAuthenticatorByAuthMethod(QString authMethod) const
 bool Realm::containsRegistration(QString uri)
 {
     Q_D(Realm);
-    QMutexLocker lock(&d->_mutex);
-    return d->_root.containsGenuine(uri);
+    UriAtom atom = d->_atoms.find(uri);
+    return d->_registrations.snapshot()->byAtom.contains(atom);
 }
 QStringList Realm::registeredUris()
 {
     Q_D(Realm);
-    QMutexLocker lock(&d->_mutex);
-    return d->_root.genuineUris();
+    return d->registrationTree()->genuineUris();
 }
 QStringList Realm::childrenKeys(QString uri)
 {
     Q_D(Realm);
-    QMutexLocker lock(&d->_mutex);
-    return d->_root.childrenKeys(uri);
+    return d->registrationTree()->childrenKeys(uri);
 }
 
 QStringList Realm::registeredInternalUris()
 {
     Q_D(Realm);
-    QMutexLocker lock(&d->_mutex);
-    return d->_internalRegistrations.keys();
+    QStringList uris;
+    for(UriAtom atom: d->_registrations.snapshot()->internal.keys()) uris.append(d->_atoms.uri(atom));
+    return uris;
 }
 QVariantList Realm::registrationIds()
 {
     Q_D(Realm);
     QVariantList res;
-    QMutexLocker lock(&d->_mutex);
-    for(qulonglong id: d->_idRegistartion.keys())
+    for(qulonglong id: d->_registrations.snapshot()->byId.keys())
     {
         res << id;
     }
@@ -118,7 +120,22 @@ QVariantList Realm::registrationIds()
 void Realm::addRegistration(RegistrationPointer reg)
 {
     Q_D(Realm);
-    d->_internalRegistrations.insert(reg->uri(), reg);
+    UriAtom atom = d->_atoms.intern(reg->uri());
+    bool replaced = false;
+    d->_registrations.update([&](RegistrationTable& table) {
+        replaced = table.internal.contains(atom);
+        table.internal.insert(atom, reg);
+    });
+    // the replaced registration already holds a reference
+    if(replaced) d->_atoms.release(atom);
+}
+// Publishes the registrations of a whole object at once instead of copying the tables per method
+void Realm::batchRegistrations(const std::function<void()>& registrations)
+{
+    Q_D(Realm);
+    d->_atoms.batch([&]() {
+        d->_registrations.batch(registrations);
+    });
 }
 void Realm::addSignalObserver(QString /*uri*/, SignalObserverPointer /*observer*/)
 {
@@ -127,16 +144,20 @@ void Realm::addSignalObserver(QString /*uri*/, SignalObserverPointer /*observer*
 
 qulonglong RealmPrivate::publish(QString topic, const QVariantList& args)
 {
-    qulonglong publicationId = Random::generate();
-    if(_uriSubscriptions.contains(topic))
+    EventFanout fanout(Random::generate(), args);
+    publish(topic, _atoms.find(topic), fanout);
+    return fanout.publicationId();
+}
+void RealmPrivate::publish(const QString& topic, UriAtom atom, EventFanout& fanout)
+{
+    SnapshotTable<SubscriptionTable>::Snapshot subscriptions = _subscriptions.snapshot();
+    for(auto it = subscriptions->byAtom.constFind(atom); it != subscriptions->byAtom.constEnd() && it.key() == atom; ++it)
     {
-        QList<WampRouterSubscriptionPointer> subscriptions = _uriSubscriptions.values(topic);
-        for(WampRouterSubscriptionPointer subscription: subscriptions)
-        {
-            subscription->event(publicationId, args);
-        }
+        if(it.value()->match() == UriMatch::Exact) it.value()->event(fanout, topic);
     }
-    return publicationId;
+    subscriptions->patterns.match(topic, [&](const WampRouterSubscriptionPointer& subscription) {
+        subscription->event(fanout, topic);
+    });
 }
 qulonglong Realm::publish(QString topic, const QVariantList &args)
 {
@@ -147,86 +168,268 @@ qulonglong Realm::publish(QString topic, const QVariantList &args)
 int Realm::subscribersCount(QString topicUri)
 {
     Q_D(Realm);
-    QMutexLocker lock(&d->_mutex);
-    return d->_uriSubscriptions.count(topicUri);
+    UriAtom atom = d->_atoms.find(topicUri);
+    return d->_subscriptions.snapshot()->byAtom.count(atom);
+}
+// The URI tree is only used for listing, so it is built from the registrations on demand
+// and kept until they change instead of being rebuilt on every update
+std::shared_ptr<TreeNode> RealmPrivate::registrationTree()
+{
+    SnapshotTable<RegistrationTable>::Snapshot registrations = _registrations.snapshot();
+    QMutexLocker lock(&_treeMutex);
+    if(_treeSource != registrations)
+    {
+        _tree = std::make_shared<TreeNode>();
+        for(const WampRouterRegistrationPointer& registration: registrations->byId)
+        {
+            _tree->add(registration->uri(), registration);
+        }
+        _treeSource = registrations;
+    }
+    return _tree;
+}
+static void indexRegistration(RegistrationTable& table, const WampRouterRegistrationPointer& registration)
+{
+    if(registration->match() == UriMatch::Exact) table.byAtom.insert(registration->atom(), registration);
+    else table.patterns.insert(registration->uri(), registration->match(), registration);
+    table.byId.insert(registration->registrationId(), registration);
 }
-void RealmPrivate::insertRegistration(QString uri, WampRouterRegistrationPointer registration)
+static void unindexRegistration(RegistrationTable& table, const WampRouterRegistrationPointer& registration)
 {
-    QMutexLocker lock(&_mutex);
-    _root.add(uri, registration);
-    _idRegistartion.insert(registration->registrationId(), registration);
+    if(registration->match() == UriMatch::Exact) table.byAtom.remove(registration->atom());
+    else table.patterns.remove(registration->uri(), registration->match(), registration);
+    table.byId.remove(registration->registrationId());
+}
+// Inserts a new single-callee registration, or adds its callee to the registration already
+// holding the same URI and match policy if both use the same shared invocation policy.
+// Returns the registration the callee ends up in, or null with error set. Takes over the
+// atom reference of registration, which is released unless registration is inserted.
+WampRouterRegistrationPointer RealmPrivate::insertRegistration(WampRouterRegistrationPointer registration, QString* error)
+{
+    WampRouterRegistrationPointer result;
+    _registrations.update([&](RegistrationTable& table) {
+        WampRouterRegistrationPointer existing;
+        if(registration->match() == UriMatch::Exact) existing = table.byAtom.value(registration->atom());
+        else existing = table.patterns.values(registration->uri(), registration->match()).value(0);
+        if(!existing)
+        {
+            indexRegistration(table, registration);
+            result = registration;
+        }
+        else if(existing->policy() == InvocationPolicy::Single || existing->policy() != registration->policy() ||
+                existing->callee(registration->callees().first()->session()))
+        {
+            *error = KEY_ERR_PROCEDURE_ALREADY_EXISTS;
+            return;
+        }
+        else
+        {
+            result.reset(new WampRouterRegistration(*existing, existing->callees() + registration->callees()));
+            unindexRegistration(table, existing);
+            indexRegistration(table, result);
+        }
+    });
+    if(result != registration) _atoms.release(registration->atom());
+    return result;
 }
 WampRouterRegistrationPointer RealmPrivate::getRegistration(qulonglong registrationId)
 {
-    QMutexLocker lock(&_mutex);
-    return _idRegistartion[registrationId];
+    return _registrations.snapshot()->byId.value(registrationId);
+}
+WampRouterRegistrationPointer RealmPrivate::getRegistration(UriAtom procedure)
+{
+    return _registrations.snapshot()->byAtom.value(procedure);
 }
-WampRouterRegistrationPointer RealmPrivate::getRegistration(QString uri)
+WampRouterRegistrationPointer RealmPrivate::getRegistration(const QString &pattern, UriAtom atom, UriMatch match)
 {
-    QMutexLocker lock(&_mutex);
-    return _root.findData(uri);
+    if(match == UriMatch::Exact) return getRegistration(atom);
+    QList<WampRouterRegistrationPointer> registrations = _registrations.snapshot()->patterns.values(pattern, match);
+    return registrations.isEmpty() ? WampRouterRegistrationPointer() : registrations.last();
+}
+// Exact registrations take precedence over prefix ones, prefix over wildcard ones
+WampRouterRegistrationPointer RealmPrivate::matchRegistration(const QString &procedure, UriAtom atom)
+{
+    SnapshotTable<RegistrationTable>::Snapshot registrations = _registrations.snapshot();
+    WampRouterRegistrationPointer registration = registrations->byAtom.value(atom);
+    if(!registration) registrations->patterns.best(procedure, &registration);
+    return registration;
 }
 
-void RealmPrivate::removeRegistration(WampRouterRegistrationPointer reg)
+// Removes session from the callees of a registration and drops the registration with its last callee
+bool RealmPrivate::removeCallee(qulonglong registrationId, WampRouterSession* session)
 {
-    QMutexLocker lock(&_mutex);
-    _root.remove(reg->uri());
-    _idRegistartion.remove(reg->registrationId());
-    QVariantList onDeleteArgs{reg->callee()->sessionId()};
+    WampRouterRegistrationPointer removed;
+    bool lastCallee = false;
+    _registrations.update([&](RegistrationTable& table) {
+        WampRouterRegistrationPointer existing = table.byId.value(registrationId);
+        if(!existing || !existing->callee(session)) return;
+        removed = existing;
+        unindexRegistration(table, existing);
+        QVector<WampRouterCalleePointer> callees = existing->callees();
+        callees.removeOne(existing->callee(session));
+        lastCallee = callees.isEmpty();
+        if(!lastCallee) indexRegistration(table, WampRouterRegistrationPointer(new WampRouterRegistration(*existing, callees)));
+    });
+    if(!removed) return false;
+    if(!lastCallee) return true;
+    _atoms.release(removed->atom());
+    QVariantList onDeleteArgs{session->sessionId()};
     QVariantMap details;
-    details["id"] = reg->registrationId();
-    details["created"] = reg->created().toString("yyyy-mm-ddThh:mm:zzzZ");
-    details["uri"] = reg->uri();
+    details["id"] = removed->registrationId();
+    details["created"] = removed->created().toString("yyyy-mm-ddThh:mm:zzzZ");
+    details["uri"] = removed->uri();
     onDeleteArgs.append(details);
     publish(KEY_REGISTRATION_ON_DELETE, onDeleteArgs);
+    return true;
 }
-void RealmPrivate::insertPendingInvocation(qulonglong requestId, WampRouterSession *session)
+qulonglong RealmPrivate::insertPendingInvocation(WampRouterSession *caller, qulonglong requestId, WampRouterCalleePointer callee,
+                                                  qulonglong registrationId, qint64 timeout, bool receiveProgress,
+                                                  bool progressiveCall)
+{
+    PendingInvocation invocation;
+    invocation.registrationId = registrationId;
+    invocation.caller = caller;
+    invocation.callerRequestId = requestId;
+    invocation.callee = callee;
+    invocation.receiveProgress = receiveProgress;
+    invocation.progressiveCall = progressiveCall;
+    if(timeout > 0) invocation.deadline = QDateTime::currentMSecsSinceEpoch() + timeout;
+    callee->invocationStarted();
+    QMutexLocker lock(&_invocationMutex);
+    qulonglong invocationId = _pendingInvocations.insert(invocation);
+    if(invocation.deadline) _invocationDeadlines.schedule(invocationId, invocation.deadline);
+    return invocationId;
+}
+// Finds the invocation a progressive CALL is streaming into. The CALL without the progress
+// option is the last chunk, further CALLs with its request id start a new call.
+bool RealmPrivate::continueCall(WampRouterSession *caller, qulonglong requestId, bool progress, PendingInvocation *invocation)
 {
-    QMutexLocker lock(&_mutex);
-    _pendingInvocations.insert(requestId, session);
+    QMutexLocker lock(&_invocationMutex);
+    PendingInvocation* pending = _pendingInvocations.call(caller, requestId);
+    if(!pending || !pending->progressiveCall) return false;
+    if(!progress) pending->progressiveCall = false;
+    *invocation = *pending;
+    return true;
+}
+// Finds the invocation of a caller's CALL. With keepPending it stays in the table marked as
+// canceled so the callee's answer can still be matched, otherwise it is released.
+bool RealmPrivate::cancelInvocation(WampRouterSession *caller, qulonglong requestId, bool keepPending, PendingInvocation *invocation)
+{
+    QMutexLocker lock(&_invocationMutex);
+    PendingInvocation* pending = _pendingInvocations.call(caller, requestId);
+    if(!pending || pending->canceled) return false;
+    if(keepPending)
+    {
+        pending->canceled = true;
+        *invocation = *pending;
+        return true;
+    }
+    *invocation = _pendingInvocations.take(pending->invocationId);
+    invocation->callee->invocationFinished();
+    return true;
 }
-bool RealmPrivate::containsInternalRegistration(QString uri)
+// Interrupts the callees of invocations past their deadline and fails the calls
+void RealmPrivate::expireInvocations(qint64 now)
 {
-    QMutexLocker lock(&_mutex);
-    return _internalRegistrations.contains(uri);
+    QList<PendingInvocation> expired;
+    {
+        QMutexLocker lock(&_invocationMutex);
+        for(qulonglong invocationId: _invocationDeadlines.advance(now))
+        {
+            PendingInvocation invocation = _pendingInvocations.take(invocationId);
+            if(!invocation.caller) continue;
+            invocation.callee->invocationFinished();
+            expired.append(invocation);
+        }
+    }
+    for(const PendingInvocation& invocation: expired)
+    {
+        QVariantMap interruptOptions{{KEY_CANCEL_MODE, KEY_CANCEL_KILLNOWAIT}, {"reason", KEY_ERR_TIMEOUT}};
+        invocation.callee->session()->sendWampMessage({(int)WampMsgCode::INTERRUPT, invocation.invocationId, interruptOptions});
+        invocation.caller->sendWampMessage({(int)WampMsgCode::ERROR, (int)WampMsgCode::CALL, invocation.callerRequestId,
+                                            QVariantMap(), invocation.canceled ? KEY_ERR_CANCELED : KEY_ERR_TIMEOUT});
+    }
 }
-RegistrationPointer RealmPrivate::getInternalRegistration(QString uri)
+RegistrationPointer RealmPrivate::getInternalRegistration(UriAtom procedure)
 {
-    QMutexLocker lock(&_mutex);
-    return _internalRegistrations[uri];
+    return _registrations.snapshot()->internal.value(procedure);
 }
-WampRouterSession* RealmPrivate::takePendingInvocation(qulonglong requestId)
+PendingInvocation RealmPrivate::takePendingInvocation(qulonglong invocationId, WampRouterSession* callee)
 {
-    QMutexLocker lock(&_mutex);
-    return _pendingInvocations.take(requestId);
+    QMutexLocker lock(&_invocationMutex);
+    PendingInvocation invocation = _pendingInvocations.take(invocationId, callee);
+    if(invocation.callee) invocation.callee->invocationFinished();
+    return invocation;
 }
-void RealmPrivate::insertSubscription(qulonglong subscriptionId, QString topic, WampRouterSubscriptionPointer subscription)
+// Looks up an invocation for a progressive YIELD, the entry stays pending until the final one
+bool RealmPrivate::findPendingInvocation(qulonglong invocationId, WampRouterSession *callee, PendingInvocation *invocation)
 {
-    QMutexLocker lock(&_mutex);
-    _subscriptions.insert(subscriptionId, subscription);
-    _uriSubscriptions.insertMulti(topic, subscription);
+    QMutexLocker lock(&_invocationMutex);
+    PendingInvocation* pending = _pendingInvocations.find(invocationId, callee);
+    if(!pending) return false;
+    *invocation = *pending;
+    return true;
 }
-bool RealmPrivate::containsSubscription(QString topic)
+QList<PendingInvocation> RealmPrivate::takeCallerInvocations(WampRouterSession *caller)
 {
-    QMutexLocker lock(&_mutex);
-    return _uriSubscriptions.contains(topic);
+    QMutexLocker lock(&_invocationMutex);
+    QList<PendingInvocation> invocations = _pendingInvocations.takeCaller(caller);
+    for(const PendingInvocation& invocation: invocations) invocation.callee->invocationFinished();
+    return invocations;
+}
+QList<PendingInvocation> RealmPrivate::takeCalleeInvocations(WampRouterSession *callee)
+{
+    QMutexLocker lock(&_invocationMutex);
+    QList<PendingInvocation> invocations = _pendingInvocations.takeCallee(callee);
+    for(const PendingInvocation& invocation: invocations) invocation.callee->invocationFinished();
+    return invocations;
+}
+// The subscription keeps its atom reference until takeSubscription
+void RealmPrivate::insertSubscription(WampRouterSubscriptionPointer subscription)
+{
+    _subscriptions.update([&](SubscriptionTable& table) {
+        table.byId.insert(subscription->subscriptionId(), subscription);
+        table.byAtom.insertMulti(subscription->atom(), subscription);
+        if(subscription->match() != UriMatch::Exact)
+        {
+            table.patterns.insert(subscription->topic(), subscription->match(), subscription);
+        }
+    });
+}
+static bool containsMatch(const SubscriptionTable& table, UriAtom topic, UriMatch match)
+{
+    for(auto it = table.byAtom.constFind(topic); it != table.byAtom.constEnd() && it.key() == topic; ++it)
+    {
+        if(it.value()->match() == match) return true;
+    }
+    return false;
+}
+bool RealmPrivate::hasSubscribers(UriAtom topic, UriMatch match)
+{
+    return containsMatch(*_subscriptions.snapshot(), topic, match);
 }
 bool RealmPrivate::containsSubscription(qulonglong subscriptionId)
 {
-    QMutexLocker lock(&_mutex);
-    return _subscriptions.contains(subscriptionId);
+    return _subscriptions.snapshot()->byId.contains(subscriptionId);
 }
 WampRouterSubscriptionPointer RealmPrivate::takeSubscription(qulonglong subscriptionId)
 {
-    QMutexLocker lock(&_mutex);
-    WampRouterSubscriptionPointer sub = _subscriptions.take(subscriptionId);
+    WampRouterSubscriptionPointer sub;
+    bool lastSubscriber = false;
+    _subscriptions.update([&](SubscriptionTable& table) {
+        sub = table.byId.take(subscriptionId);
+        if(!sub) return;
+        table.byAtom.remove(sub->atom(), sub);
+        if(sub->match() != UriMatch::Exact) table.patterns.remove(sub->topic(), sub->match(), sub);
+        lastSubscriber = !containsMatch(table, sub->atom(), sub->match());
+    });
     if(!sub)
     {
         qDebug() << QString("Subscription id %1 already removed from realm %2").arg(subscriptionId).arg(_name);
         return WampRouterSubscriptionPointer();
     }
-    _uriSubscriptions.remove(sub->topic(), sub);
-    if(!_uriSubscriptions.contains(sub->topic()))
+    _atoms.release(sub->atom());
+    if(lastSubscriber)
     {
         publish(KEY_SUBSCRIPTION_ON_DELETE, {sub->subscriber()->sessionId(), sub->subscriptionId(), sub->topic()});
     }
@@ -41,6 +41,7 @@ public Q_SLOTS:
 protected:
     void addRegistration(RegistrationPointer reg);
     void addSignalObserver(QString uri, SignalObserverPointer observer);
+    void batchRegistrations(const std::function<void()>& registrations);
 private:
     const QScopedPointer<RealmPrivate> d_ptr;
     Q_DECLARE_PRIVATE(Realm)
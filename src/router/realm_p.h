@@ -2,6 +2,11 @@
 #define REALM_P_H
 
 #include "radixtreenode.h"
+#include "uriatomtable.h"
+#include "snapshottable.h"
+#include "urimatcher.h"
+#include "invocationtable.h"
+#include "timerwheel.h"
 #include <QMutex>
 #include <QHash>
 #include <QSharedPointer>
@@ -18,41 +23,74 @@ class Authenticator;
 class Role;
 class WampRouterRegistration;
 typedef QSharedPointer<WampRouterRegistration> WampRouterRegistrationPointer;
+class WampRouterCallee;
+typedef QSharedPointer<WampRouterCallee> WampRouterCalleePointer;
 class WampRouterSubscription;
 typedef QSharedPointer<WampRouterSubscription> WampRouterSubscriptionPointer;
+class EventFanout;
 class Registration;
 typedef QSharedPointer<Registration> RegistrationPointer;
 typedef RadixTreeNode<WampRouterRegistrationPointer> TreeNode;
 typedef RadixTreeNodeList<WampRouterRegistrationPointer> TreeNodeList;
 
+// Granularity of call timeouts, the router worker advances the deadline wheels at this interval
+const int INVOCATION_DEADLINE_RESOLUTION_MS = 50;
+
+struct RegistrationTable
+{
+    // exact registrations, pattern-based ones are only in patterns
+    QHash<UriAtom, WampRouterRegistrationPointer> byAtom;
+    UriMatcher<WampRouterRegistrationPointer> patterns;
+    QHash<qulonglong, WampRouterRegistrationPointer> byId;
+    QHash<UriAtom, RegistrationPointer> internal;
+};
+struct SubscriptionTable
+{
+    // every subscription by the atom of its topic or pattern, only exact ones are matched through it
+    QMultiHash<UriAtom, WampRouterSubscriptionPointer> byAtom;
+    UriMatcher<WampRouterSubscriptionPointer> patterns;
+    QHash<qulonglong, WampRouterSubscriptionPointer> byId;
+};
+
 class RealmPrivate
 {
 public:
-    QMutex _mutex;
     QString _name;
-    //QHash<QString, WampRouterRegistrationPointer> _uriRegistartion;
-    TreeNode _root;
-    QHash<qulonglong, WampRouterRegistrationPointer> _idRegistartion;
-    QHash<qulonglong, WampRouterSession*> _pendingInvocations;
-    void insertPendingInvocation(qulonglong requestId, WampRouterSession* session);
+    UriAtomTable _atoms;
+    SnapshotTable<RegistrationTable> _registrations;
+    QMutex _invocationMutex;
+    InvocationTable _pendingInvocations;
+    TimerWheel _invocationDeadlines;
+    qulonglong insertPendingInvocation(WampRouterSession* caller, qulonglong requestId, WampRouterCalleePointer callee,
+                                       qulonglong registrationId, qint64 timeout, bool receiveProgress, bool progressiveCall);
+    bool continueCall(WampRouterSession* caller, qulonglong requestId, bool progress, PendingInvocation* invocation);
+    bool cancelInvocation(WampRouterSession* caller, qulonglong requestId, bool keepPending, PendingInvocation* invocation);
+    void expireInvocations(qint64 now);
     QList<Role*> _roles;
     QList<Authenticator*> _authenticators;
-    QHash<QString, RegistrationPointer> _internalRegistrations;
-    void insertRegistration(QString uri, WampRouterRegistrationPointer registration);
+    WampRouterRegistrationPointer insertRegistration(WampRouterRegistrationPointer registration, QString* error);
     WampRouterRegistrationPointer getRegistration(qulonglong registrationId);
-    WampRouterRegistrationPointer getRegistration(QString uri);
-    void removeRegistration(WampRouterRegistrationPointer reg);
-    bool containsInternalRegistration(QString uri);
-    RegistrationPointer getInternalRegistration(QString uri);
-    WampRouterSession* takePendingInvocation(qulonglong requestId);
+    WampRouterRegistrationPointer getRegistration(UriAtom procedure);
+    WampRouterRegistrationPointer getRegistration(const QString& pattern, UriAtom atom, UriMatch match);
+    WampRouterRegistrationPointer matchRegistration(const QString& procedure, UriAtom atom);
+    bool removeCallee(qulonglong registrationId, WampRouterSession* session);
+    RegistrationPointer getInternalRegistration(UriAtom procedure);
+    std::shared_ptr<TreeNode> registrationTree();
+    QMutex _treeMutex;
+    SnapshotTable<RegistrationTable>::Snapshot _treeSource;
+    std::shared_ptr<TreeNode> _tree;
+    PendingInvocation takePendingInvocation(qulonglong invocationId, WampRouterSession* callee);
+    bool findPendingInvocation(qulonglong invocationId, WampRouterSession* callee, PendingInvocation* invocation);
+    QList<PendingInvocation> takeCallerInvocations(WampRouterSession* caller);
+    QList<PendingInvocation> takeCalleeInvocations(WampRouterSession* callee);
 
-    QHash<qulonglong, WampRouterSubscriptionPointer> _subscriptions;
+    SnapshotTable<SubscriptionTable> _subscriptions;
     WampRouterSubscriptionPointer takeSubscription(qulonglong subscriptionId);
-    void insertSubscription(qulonglong subscriptionId, QString topic, WampRouterSubscriptionPointer subscription);
-    QMultiHash<QString, WampRouterSubscriptionPointer> _uriSubscriptions;
-    bool containsSubscription(QString topic);
+    void insertSubscription(WampRouterSubscriptionPointer subscription);
+    bool hasSubscribers(UriAtom topic, UriMatch match);
     bool containsSubscription(qulonglong subscriptionId);
     qulonglong publish(QString topic, const QVariantList& args);
+    void publish(const QString& topic, UriAtom atom, EventFanout& fanout);
 
     RealmPrivate();
     ~RealmPrivate();
@@ -0,0 +1,54 @@
+#include "sessionthreadpool.h"
+
+namespace QFlow{
+
+SessionThreadPool::SessionThreadPool(int size, WampRouter::SessionAssignment assignment) : _assignment(assignment)
+{
+    for(int i=0; i<size; i++)
+    {
+        QThread* thread = new QThread();
+        thread->setObjectName(QString("WampRouterSession-%1").arg(i));
+        thread->start();
+        _threads.append(thread);
+        _load.append(0);
+    }
+}
+SessionThreadPool::~SessionThreadPool()
+{
+    for(QThread* thread: _threads)
+    {
+        thread->quit();
+    }
+    for(QThread* thread: _threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+}
+int SessionThreadPool::size() const
+{
+    return _threads.size();
+}
+QThread* SessionThreadPool::acquire(qulonglong sessionId)
+{
+    int index = 0;
+    if(_assignment == WampRouter::SessionHash)
+    {
+        index = int(qHash(sessionId) % uint(_threads.size()));
+    }
+    else
+    {
+        for(int i=1; i<_load.size(); i++)
+        {
+            if(_load[i] < _load[index]) index = i;
+        }
+    }
+    _load[index]++;
+    return _threads[index];
+}
+void SessionThreadPool::release(QThread *thread)
+{
+    int index = _threads.indexOf(thread);
+    if(index >= 0) _load[index]--;
+}
+}
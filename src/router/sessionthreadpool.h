@@ -0,0 +1,26 @@
+#ifndef SESSIONTHREADPOOL_H
+#define SESSIONTHREADPOOL_H
+
+#include "wamprouter.h"
+#include <QThread>
+#include <QVector>
+
+namespace QFlow{
+
+// Fixed set of event-loop threads shared by router sessions. Sessions are only created and
+// destroyed by the router worker, so the pool is used from the worker thread alone.
+class SessionThreadPool
+{
+public:
+    SessionThreadPool(int size, WampRouter::SessionAssignment assignment);
+    ~SessionThreadPool();
+    int size() const;
+    QThread* acquire(qulonglong sessionId);
+    void release(QThread* thread);
+private:
+    WampRouter::SessionAssignment _assignment;
+    QVector<QThread*> _threads;
+    QVector<int> _load;
+};
+}
+#endif // SESSIONTHREADPOOL_H
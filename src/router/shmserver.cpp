@@ -0,0 +1,56 @@
+#include "shmserver.h"
+#include "shmtransport.h"
+#include <QSocketNotifier>
+#include <QTimer>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace QFlow{
+
+// Peers that connected but did not hand over their segment by then are dropped
+const int SHM_HANDSHAKE_TIMEOUT_MS = 5000;
+
+ShmServer::ShmServer(QObject *parent) : QLocalServer(parent)
+{
+}
+ShmServer::~ShmServer()
+{
+}
+// The handshake carries descriptors, so it is read from the raw socket before any QLocalSocket
+// buffers it
+void ShmServer::incomingConnection(quintptr socketDescriptor)
+{
+#ifdef Q_OS_LINUX
+    QSocketNotifier* notifier = new QSocketNotifier(qintptr(socketDescriptor), QSocketNotifier::Read, this);
+    QObject::connect(notifier, SIGNAL(activated(int)), this, SLOT(onHandshake(int)));
+    QTimer* timeout = new QTimer(notifier);
+    timeout->setSingleShot(true);
+    QObject::connect(timeout, &QTimer::timeout, notifier, [notifier, socketDescriptor]() {
+        notifier->setEnabled(false);
+        ::close(int(socketDescriptor));
+        notifier->deleteLater();
+    });
+    timeout->start(SHM_HANDSHAKE_TIMEOUT_MS);
+#else
+    QLocalServer::incomingConnection(socketDescriptor);
+#endif
+}
+void ShmServer::onHandshake(int socketDescriptor)
+{
+    QSocketNotifier* notifier = qobject_cast<QSocketNotifier*>(sender());
+    bool retry = false;
+    notifier->setEnabled(false);
+    ShmTransport* transport = ShmTransport::accept(socketDescriptor, &retry);
+    if(retry)
+    {
+        notifier->setEnabled(true);
+        return;
+    }
+    // the descriptor belongs to the transport now, or was closed with the handshake rejected
+    QTimer* timeout = notifier->findChild<QTimer*>();
+    if(timeout) timeout->stop();
+    notifier->deleteLater();
+    if(transport) Q_EMIT newTransport(transport);
+}
+}
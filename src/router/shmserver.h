@@ -0,0 +1,28 @@
+#ifndef SHMSERVER_H
+#define SHMSERVER_H
+
+#include <QLocalServer>
+
+class QSocketNotifier;
+
+namespace QFlow{
+
+class WampTransport;
+
+// Accepts shared memory transports on a Unix domain socket (Linux only). Connections are handed
+// out once their handshake passed the segment; the receiver takes ownership of the transport.
+class ShmServer : public QLocalServer
+{
+    Q_OBJECT
+public:
+    explicit ShmServer(QObject* parent = NULL);
+    ~ShmServer();
+Q_SIGNALS:
+    void newTransport(WampTransport* transport);
+protected:
+    void incomingConnection(quintptr socketDescriptor) override;
+private Q_SLOTS:
+    void onHandshake(int socketDescriptor);
+};
+}
+#endif // SHMSERVER_H
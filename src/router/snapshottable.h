@@ -0,0 +1,65 @@
+#ifndef SNAPSHOTTABLE_H
+#define SNAPSHOTTABLE_H
+
+#include <QMutex>
+#include <memory>
+
+namespace QFlow{
+
+// Read-mostly value published as immutable snapshots. Writers are serialized, modify a copy
+// and publish it with an atomic store of the shared pointer; readers take a reference with an
+// atomic load and never wait for a writer. A snapshot is freed as soon as its last reader
+// drops it.
+// Updates made inside batch() share one copy that is published when the outermost batch
+// returns; until then readers, the batching thread included, see the previous snapshot.
+template<typename T>
+class SnapshotTable
+{
+public:
+    typedef std::shared_ptr<const T> Snapshot;
+    SnapshotTable() : _current(std::make_shared<T>()),
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+        _writeMutex(QMutex::Recursive),
+#endif
+        _batchDepth(0)
+    {
+    }
+    Snapshot snapshot() const
+    {
+        return std::atomic_load_explicit(&_current, std::memory_order_acquire);
+    }
+    template<typename F>
+    void update(F modify)
+    {
+        QMutexLocker lock(&_writeMutex);
+        // only writers replace _current and they hold the write mutex
+        if(!_next) _next = std::make_shared<T>(*_current);
+        modify(*_next);
+        if(_batchDepth == 0) publish();
+    }
+    template<typename F>
+    void batch(F updates)
+    {
+        QMutexLocker lock(&_writeMutex);
+        _batchDepth++;
+        updates();
+        _batchDepth--;
+        if(_batchDepth == 0 && _next) publish();
+    }
+private:
+    void publish()
+    {
+        Snapshot next(std::move(_next));
+        std::atomic_store_explicit(&_current, next, std::memory_order_release);
+    }
+    Snapshot _current;
+    std::shared_ptr<T> _next;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QRecursiveMutex _writeMutex;
+#else
+    QMutex _writeMutex;
+#endif
+    int _batchDepth;
+};
+}
+#endif // SNAPSHOTTABLE_H
@@ -0,0 +1,68 @@
+#include "timerwheel.h"
+
+namespace QFlow{
+
+const int WHEEL_BITS = 6;
+const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+const int WHEEL_MASK = WHEEL_SLOTS - 1;
+const int WHEEL_LEVELS = 4;
+const qint64 WHEEL_SPAN = qint64(1) << (WHEEL_BITS * WHEEL_LEVELS);
+
+TimerWheel::TimerWheel(qint64 resolution, qint64 now) : _resolution(qMax<qint64>(1, resolution)),
+    _current(now / _resolution), _slots(WHEEL_SLOTS * WHEEL_LEVELS)
+{
+}
+TimerWheel::~TimerWheel()
+{
+
+}
+qint64 TimerWheel::resolution() const
+{
+    return _resolution;
+}
+void TimerWheel::schedule(qulonglong id, qint64 deadline)
+{
+    Entry entry{id, qMax(_current + 1, (deadline + _resolution - 1) / _resolution)};
+    QVector<qulonglong> expired;
+    place(entry, expired);
+}
+QVector<qulonglong> TimerWheel::advance(qint64 now)
+{
+    QVector<qulonglong> expired;
+    qint64 target = now / _resolution;
+    while(_current < target)
+    {
+        _current++;
+        if((_current & WHEEL_MASK) == 0) cascade(1, expired);
+        QVector<Entry> due;
+        due.swap(_slots[int(_current & WHEEL_MASK)]);
+        for(const Entry& entry: due) place(entry, expired);
+    }
+    return expired;
+}
+// Puts entry into the lowest level whose range covers its distance from now. Deadlines
+// beyond the last level wait in its furthest slot and are placed again when they cascade.
+void TimerWheel::place(const Entry& entry, QVector<qulonglong>& expired)
+{
+    qint64 delta = entry.tick - _current;
+    if(delta <= 0)
+    {
+        expired.append(entry.id);
+        return;
+    }
+    qint64 tick = delta < WHEEL_SPAN ? entry.tick : _current + WHEEL_SPAN - 1;
+    int level = 0;
+    while(level < WHEEL_LEVELS - 1 && (tick - _current) >= (qint64(1) << (WHEEL_BITS * (level + 1)))) level++;
+    int slot = int((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    _slots[level * WHEEL_SLOTS + slot].append(entry);
+}
+void TimerWheel::cascade(int level, QVector<qulonglong>& expired)
+{
+    if(level >= WHEEL_LEVELS) return;
+    int slot = int((_current >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    if(slot == 0) cascade(level + 1, expired);
+    QVector<Entry> entries;
+    entries.swap(_slots[level * WHEEL_SLOTS + slot]);
+    for(const Entry& entry: entries) place(entry, expired);
+}
+}
@@ -0,0 +1,35 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QVector>
+
+namespace QFlow{
+
+// Hierarchical timing wheel for call deadlines. Four levels of 64 slots each; level 0 has
+// one slot per tick and every higher level spans a full turn of the level below, cascading
+// its entries down as time reaches them. Scheduling is O(1) and a tick only touches the
+// slots that are due. Entries are never removed: callers check on expiry whether the id
+// is still pending, which InvocationTable's slot generations make a cheap lookup.
+class TimerWheel
+{
+public:
+    TimerWheel(qint64 resolution, qint64 now);
+    ~TimerWheel();
+    qint64 resolution() const;
+    void schedule(qulonglong id, qint64 deadline);
+    // Moves the wheel to now and returns the ids whose deadline has passed
+    QVector<qulonglong> advance(qint64 now);
+private:
+    struct Entry
+    {
+        qulonglong id;
+        qint64 tick;
+    };
+    void place(const Entry& entry, QVector<qulonglong>& expired);
+    void cascade(int level, QVector<qulonglong>& expired);
+    qint64 _resolution;
+    qint64 _current;
+    QVector<QVector<Entry>> _slots;
+};
+}
+#endif // TIMERWHEEL_H
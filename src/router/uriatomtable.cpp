@@ -0,0 +1,49 @@
+#include "uriatomtable.h"
+
+namespace QFlow{
+
+UriAtomTable::UriAtomTable()
+{
+
+}
+UriAtomTable::~UriAtomTable()
+{
+
+}
+UriAtom UriAtomTable::intern(const QString &uri)
+{
+    UriAtom atom = INVALID_URI_ATOM;
+    _table.update([&](Atoms& table) {
+        atom = table.atoms.value(uri, INVALID_URI_ATOM);
+        if(atom == INVALID_URI_ATOM)
+        {
+            do
+            {
+                atom = ++table.last;
+            } while(atom == INVALID_URI_ATOM || table.entries.contains(atom));
+            table.atoms.insert(uri, atom);
+            table.entries[atom].uri = uri;
+        }
+        table.entries[atom].refs++;
+    });
+    return atom;
+}
+void UriAtomTable::release(UriAtom atom)
+{
+    if(atom == INVALID_URI_ATOM) return;
+    _table.update([&](Atoms& table) {
+        QHash<UriAtom, Entry>::iterator it = table.entries.find(atom);
+        if(it == table.entries.end() || --it.value().refs > 0) return;
+        table.atoms.remove(it.value().uri);
+        table.entries.erase(it);
+    });
+}
+UriAtom UriAtomTable::find(const QString &uri) const
+{
+    return _table.snapshot()->atoms.value(uri, INVALID_URI_ATOM);
+}
+QString UriAtomTable::uri(UriAtom atom) const
+{
+    return _table.snapshot()->entries.value(atom).uri;
+}
+}
@@ -0,0 +1,58 @@
+#ifndef URIATOMTABLE_H
+#define URIATOMTABLE_H
+
+#include "snapshottable.h"
+#include <QString>
+#include <QHash>
+
+namespace QFlow{
+
+// Compact handle of an interned URI. Equal URIs of one realm always map to the same atom,
+// so lookups keyed by atoms hash and compare a single integer instead of the string.
+typedef quint32 UriAtom;
+const UriAtom INVALID_URI_ATOM = 0;
+
+// Maps URIs to atoms. Only REGISTER/SUBSCRIBE and internal registrations intern new URIs;
+// CALL and PUBLISH only look URIs up, so peers cannot grow the table with arbitrary URIs.
+// Every intern() takes a reference that the registration or subscription holding the atom
+// gives back with release(), an atom goes away with its last reference. Atom numbers keep
+// counting up instead of being recycled, so what is still keyed by a released atom does not
+// match another URI.
+// The map is published as a snapshot, lookups on the CALL and PUBLISH paths take no lock.
+class UriAtomTable
+{
+public:
+    UriAtomTable();
+    ~UriAtomTable();
+    UriAtom intern(const QString& uri);
+    void release(UriAtom atom);
+    UriAtom find(const QString& uri) const;
+    QString uri(UriAtom atom) const;
+    // URIs interned by updates are published together once updates returns
+    template<typename F>
+    void batch(F updates)
+    {
+        _table.batch(updates);
+    }
+private:
+    struct Entry
+    {
+        Entry() : refs(0)
+        {
+        }
+        QString uri;
+        int refs;
+    };
+    struct Atoms
+    {
+        Atoms() : last(INVALID_URI_ATOM)
+        {
+        }
+        QHash<QString, UriAtom> atoms;
+        QHash<UriAtom, Entry> entries;
+        UriAtom last;
+    };
+    SnapshotTable<Atoms> _table;
+};
+}
+#endif // URIATOMTABLE_H
@@ -0,0 +1,227 @@
+#ifndef URIMATCHER_H
+#define URIMATCHER_H
+
+#include "wamp_symbols.h"
+#include <QHash>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QStringList>
+
+namespace QFlow{
+
+enum class UriMatch
+{
+    Exact,
+    Prefix,
+    Wildcard
+};
+
+inline bool uriMatchFromString(const QString& value, UriMatch* match)
+{
+    if(value.isEmpty() || value == KEY_MATCH_EXACT) *match = UriMatch::Exact;
+    else if(value == KEY_MATCH_PREFIX) *match = UriMatch::Prefix;
+    else if(value == KEY_MATCH_WILDCARD) *match = UriMatch::Wildcard;
+    else return false;
+    return true;
+}
+inline QString uriMatchToString(UriMatch match)
+{
+    switch(match)
+    {
+    case UriMatch::Prefix:
+        return KEY_MATCH_PREFIX;
+    case UriMatch::Wildcard:
+        return KEY_MATCH_WILDCARD;
+    default:
+        return KEY_MATCH_EXACT;
+    }
+}
+
+// Index of prefix and wildcard URI patterns. Prefix patterns live in a character trie and
+// wildcard patterns in a trie of URI components where an empty component matches any one
+// component, so matching a URI costs one walk over its characters and components however
+// many patterns are stored. Nodes are kept in vectors, which makes copying a matcher cheap
+// enough for SnapshotTable. Exact URIs are not stored here.
+template<typename T>
+class UriMatcher
+{
+public:
+    UriMatcher() : _count(0)
+    {
+        _prefixNodes.append(PrefixNode());
+        _wildcardNodes.append(WildcardNode());
+    }
+    bool isEmpty() const
+    {
+        return _count == 0;
+    }
+    void insert(const QString& pattern, UriMatch match, const T& value)
+    {
+        if(match == UriMatch::Prefix) insertPath(_prefixNodes, _freePrefixNodes, pattern, value);
+        else insertPath(_wildcardNodes, _freeWildcardNodes, pattern.split('.'), value);
+        _count++;
+    }
+    bool remove(const QString& pattern, UriMatch match, const T& value)
+    {
+        bool removed = match == UriMatch::Prefix ? removePath(_prefixNodes, _freePrefixNodes, pattern, value)
+                                                 : removePath(_wildcardNodes, _freeWildcardNodes, pattern.split('.'), value);
+        if(removed) _count--;
+        return removed;
+    }
+    // Calls visit for every value whose pattern matches uri
+    template<typename F>
+    void match(const QString& uri, F visit) const
+    {
+        if(isEmpty()) return;
+        int node = 0;
+        for(int i=0; node >= 0; i++)
+        {
+            for(const T& value: _prefixNodes[node].values) visit(value);
+            if(i == uri.size()) break;
+            node = _prefixNodes[node].children.value(uri.at(i), -1);
+        }
+        if(_wildcardNodes[0].children.isEmpty()) return;
+        QVarLengthArray<int, 16> current;
+        current.append(0);
+        for(const QString& component: uri.split('.'))
+        {
+            QVarLengthArray<int, 16> next;
+            for(int index: current)
+            {
+                const WildcardNode& wildcardNode = _wildcardNodes[index];
+                int child = wildcardNode.children.value(component, -1);
+                if(child >= 0) next.append(child);
+                if(component.isEmpty()) continue;
+                child = wildcardNode.children.value(QString(), -1);
+                if(child >= 0) next.append(child);
+            }
+            if(next.isEmpty()) return;
+            current = next;
+        }
+        for(int index: current)
+        {
+            for(const T& value: _wildcardNodes[index].values) visit(value);
+        }
+    }
+    // Values stored under exactly this pattern
+    QList<T> values(const QString& pattern, UriMatch match) const
+    {
+        int node = match == UriMatch::Prefix ? findPath(_prefixNodes, pattern) : findPath(_wildcardNodes, pattern.split('.'));
+        if(node < 0) return QList<T>();
+        return match == UriMatch::Prefix ? _prefixNodes[node].values : _wildcardNodes[node].values;
+    }
+    // Finds the single pattern taking precedence for uri: the longest matching prefix, otherwise
+    // the wildcard pattern with the longest run of literal components before its first wildcard.
+    // Among values stored under the same pattern the latest one wins.
+    bool best(const QString& uri, T* value) const
+    {
+        if(isEmpty()) return false;
+        int longest = -1;
+        int node = 0;
+        for(int i=0; node >= 0; i++)
+        {
+            if(!_prefixNodes[node].values.isEmpty()) longest = node;
+            if(i == uri.size()) break;
+            node = _prefixNodes[node].children.value(uri.at(i), -1);
+        }
+        if(longest >= 0)
+        {
+            *value = _prefixNodes[longest].values.last();
+            return true;
+        }
+        if(_wildcardNodes[0].children.isEmpty()) return false;
+        node = bestWildcard(0, uri.split('.'), 0);
+        if(node < 0) return false;
+        *value = _wildcardNodes[node].values.last();
+        return true;
+    }
+private:
+    struct PrefixNode
+    {
+        QHash<QChar, int> children;
+        QList<T> values;
+    };
+    struct WildcardNode
+    {
+        QHash<QString, int> children;
+        QList<T> values;
+    };
+    template<typename Node>
+    static int allocate(QVector<Node>& nodes, QVector<int>& freeNodes)
+    {
+        if(!freeNodes.isEmpty()) return freeNodes.takeLast();
+        nodes.append(Node());
+        return nodes.size() - 1;
+    }
+    template<typename Node, typename Keys>
+    static void insertPath(QVector<Node>& nodes, QVector<int>& freeNodes, const Keys& keys, const T& value)
+    {
+        int node = 0;
+        for(int i=0; i<keys.size(); i++)
+        {
+            int child = nodes[node].children.value(keys.at(i), -1);
+            if(child < 0)
+            {
+                child = allocate(nodes, freeNodes);
+                nodes[node].children.insert(keys.at(i), child);
+            }
+            node = child;
+        }
+        nodes[node].values.append(value);
+    }
+    // Removes value and prunes the nodes left without values or children
+    template<typename Node, typename Keys>
+    static bool removePath(QVector<Node>& nodes, QVector<int>& freeNodes, const Keys& keys, const T& value)
+    {
+        QVarLengthArray<int, 64> path;
+        path.append(0);
+        for(int i=0; i<keys.size(); i++)
+        {
+            int child = nodes[path.last()].children.value(keys.at(i), -1);
+            if(child < 0) return false;
+            path.append(child);
+        }
+        if(!nodes[path.last()].values.removeOne(value)) return false;
+        for(int i=path.size()-1; i>0; i--)
+        {
+            Node& node = nodes[path[i]];
+            if(!node.values.isEmpty() || !node.children.isEmpty()) break;
+            nodes[path[i-1]].children.remove(keys.at(i-1));
+            node = Node();
+            freeNodes.append(path[i]);
+        }
+        return true;
+    }
+    template<typename Node, typename Keys>
+    static int findPath(const QVector<Node>& nodes, const Keys& keys)
+    {
+        int node = 0;
+        for(int i=0; i<keys.size() && node >= 0; i++)
+        {
+            node = nodes[node].children.value(keys.at(i), -1);
+        }
+        return node;
+    }
+    // Depth first, literal components before wildcards, so the first hit is the most specific
+    int bestWildcard(int node, const QStringList& components, int depth) const
+    {
+        const WildcardNode& wildcardNode = _wildcardNodes[node];
+        if(depth == components.size()) return wildcardNode.values.isEmpty() ? -1 : node;
+        int child = wildcardNode.children.value(components.at(depth), -1);
+        if(child >= 0)
+        {
+            int found = bestWildcard(child, components, depth + 1);
+            if(found >= 0) return found;
+        }
+        if(components.at(depth).isEmpty()) return -1;
+        child = wildcardNode.children.value(QString(), -1);
+        return child >= 0 ? bestWildcard(child, components, depth + 1) : -1;
+    }
+    QVector<PrefixNode> _prefixNodes;
+    QVector<int> _freePrefixNodes;
+    QVector<WildcardNode> _wildcardNodes;
+    QVector<int> _freeWildcardNodes;
+    int _count;
+};
+}
+#endif // URIMATCHER_H
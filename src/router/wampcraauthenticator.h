@@ -16,6 +16,7 @@ class WAMP_EXPORT WampCraAuthenticator : public Authenticator
 public:
     explicit WampCraAuthenticator(QObject *parent = 0);
     ~WampCraAuthenticator();
+    using Authenticator::generateChallenge;
     QVariantMap generateChallenge(qulonglong sessionId, QString authId) override;
     QString authMethod() const override;
     AuthSession* createSession() const override;
@@ -4,11 +4,17 @@
 #include "wampconnection.h"
 #include "wampconnection_p.h"
 #include "wampworker.h"
+#include "eventfanout.h"
+#include "random.h"
 #include <QJsonDocument>
+#include <QMetaMethod>
 
 namespace QFlow{
 
-WampRouterPrivate::WampRouterPrivate(WampRouter* parent) : QObject(), _port(8080), q_ptr(parent)
+WampRouterPrivate::WampRouterPrivate(WampRouter* parent) : QObject(), _port(8080), _rawSocketPort(0), _payloadPassthrough(true),
+    _threadPoolSize(QThread::idealThreadCount()), _sessionAssignment(WampRouter::LeastLoaded), _outboundQueueLimit(4096),
+    _outboundHighWatermark(1024 * 1024), _outboundLowWatermark(256 * 1024), _slowConsumerPolicy(WampRouter::DropOldest),
+    _writeBatchWindow(0), q_ptr(parent)
 {
     _worker = new WampRouterWorker();
     _workerThread = new QThread();
@@ -21,6 +27,12 @@ WampRouterPrivate::WampRouterPrivate(WampRouter* parent) : QObject(), _port(8080
 WampRouterPrivate::~WampRouterPrivate()
 {
 }
+bool WampRouterPrivate::isTracingMessages() const
+{
+    static const QMetaMethod received = QMetaMethod::fromSignal(&WampRouter::messageReceived);
+    static const QMetaMethod sent = QMetaMethod::fromSignal(&WampRouter::messageSent);
+    return q_ptr->isSignalConnected(received) || q_ptr->isSignalConnected(sent);
+}
 void WampRouterPrivate::messageReceived(QVariantList message)
 {
     Q_Q(WampRouter);
@@ -60,6 +72,182 @@ void WampRouter::setPort(int value)
     d->_port = value;
     Q_EMIT portChanged();
 }
+// Port of the WAMP RawSocket listener on host, 0 disables it
+int WampRouter::rawSocketPort() const
+{
+    Q_D(const WampRouter);
+    return d->_rawSocketPort;
+}
+void WampRouter::setRawSocketPort(int value)
+{
+    Q_D(WampRouter);
+    d->_rawSocketPort = value;
+    Q_EMIT rawSocketPortChanged();
+}
+// Unix domain socket the router accepts RawSocket connections on, empty disables it
+QString WampRouter::localSocketPath() const
+{
+    Q_D(const WampRouter);
+    return d->_localSocketPath;
+}
+void WampRouter::setLocalSocketPath(QString value)
+{
+    Q_D(WampRouter);
+    d->_localSocketPath = value;
+    Q_EMIT localSocketPathChanged();
+}
+// Unix domain socket shared memory clients (shm:// URLs) hand their segment to, empty disables it
+QString WampRouter::sharedMemorySocketPath() const
+{
+    Q_D(const WampRouter);
+    return d->_sharedMemorySocketPath;
+}
+void WampRouter::setSharedMemorySocketPath(QString value)
+{
+    Q_D(WampRouter);
+    d->_sharedMemorySocketPath = value;
+    Q_EMIT sharedMemorySocketPathChanged();
+}
+bool WampRouter::payloadPassthrough() const
+{
+    Q_D(const WampRouter);
+    return d->_payloadPassthrough;
+}
+void WampRouter::setPayloadPassthrough(bool value)
+{
+    Q_D(WampRouter);
+    d->_payloadPassthrough = value;
+    Q_EMIT payloadPassthroughChanged();
+}
+int WampRouter::maxFrameSize() const
+{
+    Q_D(const WampRouter);
+    return d->_decodeLimits.maxFrameSize;
+}
+void WampRouter::setMaxFrameSize(int value)
+{
+    Q_D(WampRouter);
+    d->_decodeLimits.maxFrameSize = value;
+    Q_EMIT maxFrameSizeChanged();
+}
+int WampRouter::maxNestingDepth() const
+{
+    Q_D(const WampRouter);
+    return d->_decodeLimits.maxDepth;
+}
+void WampRouter::setMaxNestingDepth(int value)
+{
+    Q_D(WampRouter);
+    d->_decodeLimits.maxDepth = value;
+    Q_EMIT maxNestingDepthChanged();
+}
+int WampRouter::maxElementCount() const
+{
+    Q_D(const WampRouter);
+    return d->_decodeLimits.maxElements;
+}
+void WampRouter::setMaxElementCount(int value)
+{
+    Q_D(WampRouter);
+    d->_decodeLimits.maxElements = value;
+    Q_EMIT maxElementCountChanged();
+}
+int WampRouter::maxStringLength() const
+{
+    Q_D(const WampRouter);
+    return d->_decodeLimits.maxStringLength;
+}
+void WampRouter::setMaxStringLength(int value)
+{
+    Q_D(WampRouter);
+    d->_decodeLimits.maxStringLength = value;
+    Q_EMIT maxStringLengthChanged();
+}
+// 0 runs every session in a thread of its own. Takes effect when the router is initialized.
+int WampRouter::threadPoolSize() const
+{
+    Q_D(const WampRouter);
+    return d->_threadPoolSize;
+}
+void WampRouter::setThreadPoolSize(int value)
+{
+    Q_D(WampRouter);
+    d->_threadPoolSize = qMax(0, value);
+    Q_EMIT threadPoolSizeChanged();
+}
+WampRouter::SessionAssignment WampRouter::sessionAssignment() const
+{
+    Q_D(const WampRouter);
+    return d->_sessionAssignment;
+}
+void WampRouter::setSessionAssignment(SessionAssignment value)
+{
+    Q_D(WampRouter);
+    d->_sessionAssignment = value;
+    Q_EMIT sessionAssignmentChanged();
+}
+// Messages a session may have waiting for its socket before the slow consumer policy applies
+// to EVENTs; any other message beyond it disconnects the session. Takes effect for sessions
+// opened afterwards, like the policy itself.
+int WampRouter::outboundQueueLimit() const
+{
+    Q_D(const WampRouter);
+    return d->_outboundQueueLimit;
+}
+void WampRouter::setOutboundQueueLimit(int value)
+{
+    Q_D(WampRouter);
+    d->_outboundQueueLimit = qMax(1, value);
+    Q_EMIT outboundQueueLimitChanged();
+}
+// A session stops handing queued messages to its socket once this many bytes are pending there
+int WampRouter::outboundHighWatermark() const
+{
+    Q_D(const WampRouter);
+    return d->_outboundHighWatermark;
+}
+void WampRouter::setOutboundHighWatermark(int value)
+{
+    Q_D(WampRouter);
+    d->_outboundHighWatermark = qMax(1, value);
+    Q_EMIT outboundHighWatermarkChanged();
+}
+// and resumes once the socket's pending bytes dropped to this
+int WampRouter::outboundLowWatermark() const
+{
+    Q_D(const WampRouter);
+    return d->_outboundLowWatermark;
+}
+void WampRouter::setOutboundLowWatermark(int value)
+{
+    Q_D(WampRouter);
+    d->_outboundLowWatermark = qMax(0, value);
+    Q_EMIT outboundLowWatermarkChanged();
+}
+WampRouter::SlowConsumerPolicy WampRouter::slowConsumerPolicy() const
+{
+    Q_D(const WampRouter);
+    return d->_slowConsumerPolicy;
+}
+void WampRouter::setSlowConsumerPolicy(SlowConsumerPolicy value)
+{
+    Q_D(WampRouter);
+    d->_slowConsumerPolicy = value;
+    Q_EMIT slowConsumerPolicyChanged();
+}
+// Microseconds a session holds back outgoing messages to write them together. 0 batches what
+// one event loop iteration produced, a negative value writes every message right away.
+int WampRouter::writeBatchWindow() const
+{
+    Q_D(const WampRouter);
+    return d->_writeBatchWindow;
+}
+void WampRouter::setWriteBatchWindow(int usecs)
+{
+    Q_D(WampRouter);
+    d->_writeBatchWindow = usecs;
+    Q_EMIT writeBatchWindowChanged();
+}
 ErrorInfo WampRouter::init()
 {
     Q_D(WampRouter);
@@ -80,17 +268,52 @@ QQmlListProperty<QFlow::Realm> WampRouter::realms()
     Q_D(WampRouter);
     return QQmlListProperty<QFlow::Realm>(d->_worker, d->_worker->_realms);
 }
-void WampRouterSubscription::event(qulonglong publicationId, const QVariantList& args)
+void WampRouterSubscription::event(EventFanout& fanout, const QString& topic)
+{
+    QVariantMap details;
+    // pattern-based subscribers need the concrete topic
+    if(_match != UriMatch::Exact) details["topic"] = topic;
+    if(_subscriber->carriesMessages()) _subscriber->sendWampMessage(fanout.message(_subscriptionId, details), fanout.publisher());
+    else
+    {
+        EventFanout::Frame frame = fanout.frame(_subscriptionId, _subscriber->format(), details);
+        _subscriber->sendFrame(frame.head, frame.tail, true, fanout.publisher());
+    }
+}
+bool invocationPolicyFromString(const QString& value, InvocationPolicy* policy)
 {
-    QVariantList resArr{(int)WampMsgCode::EVENT, _subscriptionId, publicationId, QVariantMap()};
-    if(!args.isEmpty()) resArr.append(QVariant(args));
-    _subscriber->sendWampMessage(resArr);
+    if(value.isEmpty() || value == KEY_INVOKE_SINGLE) *policy = InvocationPolicy::Single;
+    else if(value == KEY_INVOKE_FIRST) *policy = InvocationPolicy::First;
+    else if(value == KEY_INVOKE_LAST) *policy = InvocationPolicy::Last;
+    else if(value == KEY_INVOKE_ROUNDROBIN) *policy = InvocationPolicy::RoundRobin;
+    else if(value == KEY_INVOKE_RANDOM) *policy = InvocationPolicy::Random;
+    else if(value == KEY_INVOKE_LEAST_OUTSTANDING) *policy = InvocationPolicy::LeastOutstanding;
+    else return false;
+    return true;
 }
-void WampRouterRegistration::handleRemote(qulonglong requestId, WampRouterSession* /*caller*/, QVariantList params)
+// Least outstanding compares two random callees instead of scanning all of them, which
+// keeps the choice O(1) and lands close to the least loaded callee.
+WampRouterCalleePointer WampRouterRegistration::selectCallee() const
 {
-    QVariantList invArr{(int)WampMsgCode::INVOCATION, requestId, registrationId(), QVariantMap()};
-    if(!params.isEmpty()) invArr.append(QVariant(params));
-    //if(arr.count()>5) invArr.append(arr[5]);
-    _session->sendWampMessage(invArr);
+    int count = _callees.size();
+    if(count == 0) return WampRouterCalleePointer();
+    switch(_policy)
+    {
+    case InvocationPolicy::Last:
+        return _callees.last();
+    case InvocationPolicy::RoundRobin:
+        return _callees[int(_nextCallee->fetchAndAddRelaxed(1) % quint32(count))];
+    case InvocationPolicy::Random:
+        return _callees[int(Random::generate() % qulonglong(count))];
+    case InvocationPolicy::LeastOutstanding:
+    {
+        qulonglong random = Random::generate();
+        const WampRouterCalleePointer& first = _callees[int(random % qulonglong(count))];
+        const WampRouterCalleePointer& second = _callees[int((random >> 32) % qulonglong(count))];
+        return second->outstanding() < first->outstanding() ? second : first;
+    }
+    default:
+        return _callees.first();
+    }
 }
 }
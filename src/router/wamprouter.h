@@ -16,21 +16,96 @@ class WAMP_EXPORT WampRouter : public QObject, public QmlInitiable
     Q_OBJECT
     Q_PROPERTY(QString host READ host WRITE setHost NOTIFY hostChanged)
     Q_PROPERTY(int port READ port WRITE setPort NOTIFY portChanged)
+    Q_PROPERTY(int rawSocketPort READ rawSocketPort WRITE setRawSocketPort NOTIFY rawSocketPortChanged)
+    Q_PROPERTY(QString localSocketPath READ localSocketPath WRITE setLocalSocketPath NOTIFY localSocketPathChanged)
+    Q_PROPERTY(QString sharedMemorySocketPath READ sharedMemorySocketPath WRITE setSharedMemorySocketPath NOTIFY sharedMemorySocketPathChanged)
+    Q_PROPERTY(bool payloadPassthrough READ payloadPassthrough WRITE setPayloadPassthrough NOTIFY payloadPassthroughChanged)
+    Q_PROPERTY(int maxFrameSize READ maxFrameSize WRITE setMaxFrameSize NOTIFY maxFrameSizeChanged)
+    Q_PROPERTY(int maxNestingDepth READ maxNestingDepth WRITE setMaxNestingDepth NOTIFY maxNestingDepthChanged)
+    Q_PROPERTY(int maxElementCount READ maxElementCount WRITE setMaxElementCount NOTIFY maxElementCountChanged)
+    Q_PROPERTY(int maxStringLength READ maxStringLength WRITE setMaxStringLength NOTIFY maxStringLengthChanged)
+    Q_PROPERTY(int threadPoolSize READ threadPoolSize WRITE setThreadPoolSize NOTIFY threadPoolSizeChanged)
+    Q_PROPERTY(SessionAssignment sessionAssignment READ sessionAssignment WRITE setSessionAssignment NOTIFY sessionAssignmentChanged)
+    Q_PROPERTY(int outboundQueueLimit READ outboundQueueLimit WRITE setOutboundQueueLimit NOTIFY outboundQueueLimitChanged)
+    Q_PROPERTY(int outboundHighWatermark READ outboundHighWatermark WRITE setOutboundHighWatermark NOTIFY outboundHighWatermarkChanged)
+    Q_PROPERTY(int outboundLowWatermark READ outboundLowWatermark WRITE setOutboundLowWatermark NOTIFY outboundLowWatermarkChanged)
+    Q_PROPERTY(SlowConsumerPolicy slowConsumerPolicy READ slowConsumerPolicy WRITE setSlowConsumerPolicy NOTIFY slowConsumerPolicyChanged)
+    Q_PROPERTY(int writeBatchWindow READ writeBatchWindow WRITE setWriteBatchWindow NOTIFY writeBatchWindowChanged)
     Q_PROPERTY(QQmlListProperty<QFlow::Realm> realms READ realms)
     Q_CLASSINFO("DefaultProperty", "realms")
 public:
+    // How sessions are spread over the thread pool
+    enum SessionAssignment {
+        LeastLoaded,
+        SessionHash
+    };
+    Q_ENUM(SessionAssignment)
+    // What happens to EVENTs for a session whose outbound queue is full. BlockPublisher stops
+    // reading from the publishers once the queue is half full, until it drained to a quarter.
+    enum SlowConsumerPolicy {
+        DropOldest,
+        DropNewest,
+        DisconnectSlowConsumer,
+        BlockPublisher
+    };
+    Q_ENUM(SlowConsumerPolicy)
     explicit WampRouter(QObject *parent = 0);
     ~WampRouter();
     QString host() const;
     void setHost(QString value);
     int port() const;
     void setPort(int value);
+    int rawSocketPort() const;
+    void setRawSocketPort(int value);
+    QString localSocketPath() const;
+    void setLocalSocketPath(QString value);
+    QString sharedMemorySocketPath() const;
+    void setSharedMemorySocketPath(QString value);
+    bool payloadPassthrough() const;
+    void setPayloadPassthrough(bool value);
+    int maxFrameSize() const;
+    void setMaxFrameSize(int value);
+    int maxNestingDepth() const;
+    void setMaxNestingDepth(int value);
+    int maxElementCount() const;
+    void setMaxElementCount(int value);
+    int maxStringLength() const;
+    void setMaxStringLength(int value);
+    int threadPoolSize() const;
+    void setThreadPoolSize(int value);
+    SessionAssignment sessionAssignment() const;
+    void setSessionAssignment(SessionAssignment value);
+    int outboundQueueLimit() const;
+    void setOutboundQueueLimit(int value);
+    int outboundHighWatermark() const;
+    void setOutboundHighWatermark(int value);
+    int outboundLowWatermark() const;
+    void setOutboundLowWatermark(int value);
+    SlowConsumerPolicy slowConsumerPolicy() const;
+    void setSlowConsumerPolicy(SlowConsumerPolicy value);
+    int writeBatchWindow() const;
+    void setWriteBatchWindow(int usecs);
     Q_INVOKABLE ErrorInfo init();
     Q_INVOKABLE ErrorInfo deinit();
     QQmlListProperty<QFlow::Realm> realms();
 Q_SIGNALS:
     void hostChanged();
     void portChanged();
+    void rawSocketPortChanged();
+    void localSocketPathChanged();
+    void sharedMemorySocketPathChanged();
+    void payloadPassthroughChanged();
+    void maxFrameSizeChanged();
+    void maxNestingDepthChanged();
+    void maxElementCountChanged();
+    void maxStringLengthChanged();
+    void threadPoolSizeChanged();
+    void sessionAssignmentChanged();
+    void outboundQueueLimitChanged();
+    void outboundHighWatermarkChanged();
+    void outboundLowWatermarkChanged();
+    void slowConsumerPolicyChanged();
+    void writeBatchWindowChanged();
     void newSession(WampRouterSession* session);
     void messageReceived(WampRouterSession* session, QVariantList message);
     void messageSent(WampRouterSession* session, QVariantList message);
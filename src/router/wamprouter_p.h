@@ -2,9 +2,13 @@
 #define WAMPROUTER_P_H
 
 #include "radixtreenode.h"
+#include "wamprouter.h"
 #include "wamproutersession.h"
 #include "registration_p.h"
 #include "subscription_p.h"
+#include "wampmessageserializer.h"
+#include "uriatomtable.h"
+#include "urimatcher.h"
 #include <QSet>
 #include <QThread>
 #include <QJsonObject>
@@ -14,11 +18,62 @@ namespace QFlow{
 
 class WampRouterWorker;
 class WampRouterSession;
+class EventFanout;
+// One callee of a registration. Shared by every copy of the registration, so the number
+// of invocations in flight survives other callees joining or leaving.
+class WampRouterCallee
+{
+public:
+    explicit WampRouterCallee(WampRouterSession* session) : _session(session)
+    {
+    }
+    WampRouterSession* session() const
+    {
+        return _session;
+    }
+    int outstanding() const
+    {
+        return _outstanding.load();
+    }
+    void invocationStarted()
+    {
+        _outstanding.ref();
+    }
+    void invocationFinished()
+    {
+        _outstanding.deref();
+    }
+private:
+    WampRouterSession* _session;
+    QAtomicInt _outstanding;
+};
+typedef QSharedPointer<WampRouterCallee> WampRouterCalleePointer;
+
+enum class InvocationPolicy
+{
+    Single,
+    First,
+    Last,
+    RoundRobin,
+    Random,
+    LeastOutstanding
+};
+bool invocationPolicyFromString(const QString& value, InvocationPolicy* policy);
+
+// A registration is immutable once published in the realm's snapshot; callees joining or
+// leaving a shared registration replace it with a copy that keeps the id and counters.
 class WampRouterRegistration
 {
 public:
-    WampRouterRegistration(qulonglong regId, QString regUri, WampRouterSession* sessionPtr) :
-        _registrationId(regId), _uri(regUri), _session(sessionPtr), _created(QDateTime::currentDateTime())
+    WampRouterRegistration(qulonglong regId, QString regUri, UriAtom atom, UriMatch match, InvocationPolicy policy, WampRouterSession* sessionPtr) :
+        _registrationId(regId), _uri(regUri), _atom(atom), _match(match), _policy(policy),
+        _callees{WampRouterCalleePointer(new WampRouterCallee(sessionPtr))},
+        _nextCallee(new QAtomicInteger<quint32>(0)), _created(QDateTime::currentDateTime())
+    {
+    }
+    WampRouterRegistration(const WampRouterRegistration& other, const QVector<WampRouterCalleePointer>& callees) :
+        _registrationId(other._registrationId), _uri(other._uri), _atom(other._atom), _match(other._match),
+        _policy(other._policy), _callees(callees), _nextCallee(other._nextCallee), _created(other._created)
     {
     }
     ~WampRouterRegistration()
@@ -33,27 +88,51 @@ public:
     {
         return _uri;
     }
-    void handleRemote(qulonglong requestId, WampRouterSession* caller, QVariantList params);
+    UriAtom atom() const
+    {
+        return _atom;
+    }
+    UriMatch match() const
+    {
+        return _match;
+    }
+    InvocationPolicy policy() const
+    {
+        return _policy;
+    }
     QDateTime created() const
     {
         return _created;
     }
-    WampRouterSession* callee() const
+    const QVector<WampRouterCalleePointer>& callees() const
     {
-        return _session;
+        return _callees;
     }
+    WampRouterCalleePointer callee(WampRouterSession* session) const
+    {
+        for(const WampRouterCalleePointer& callee: _callees)
+        {
+            if(callee->session() == session) return callee;
+        }
+        return WampRouterCalleePointer();
+    }
+    WampRouterCalleePointer selectCallee() const;
 private:
     qulonglong _registrationId;
     QString _uri;
-    WampRouterSession* _session;
+    UriAtom _atom;
+    UriMatch _match;
+    InvocationPolicy _policy;
+    QVector<WampRouterCalleePointer> _callees;
+    QSharedPointer<QAtomicInteger<quint32>> _nextCallee;
     QDateTime _created;
 };
 typedef QSharedPointer<WampRouterRegistration> WampRouterRegistrationPointer;
 class WampRouterSubscription
 {
 public:
-    WampRouterSubscription(QString topic, qulonglong subscriptionId, WampRouterSession* subscriber) : _topic(topic), _subscriptionId(subscriptionId),
-        _subscriber(subscriber), _created(QDateTime::currentDateTime())
+    WampRouterSubscription(QString topic, UriAtom atom, UriMatch match, qulonglong subscriptionId, WampRouterSession* subscriber) : _topic(topic),
+        _atom(atom), _match(match), _subscriptionId(subscriptionId), _subscriber(subscriber), _created(QDateTime::currentDateTime())
     {
     }
     ~WampRouterSubscription()
@@ -69,11 +148,19 @@ public:
     {
         return _topic;
     }
+    UriAtom atom() const
+    {
+        return _atom;
+    }
+    UriMatch match() const
+    {
+        return _match;
+    }
     qulonglong subscriptionId() const
     {
         return _subscriptionId;
     }
-    void event(qulonglong publicationId, const QVariantList& args);
+    void event(EventFanout& fanout, const QString& topic);
     QDateTime created() const
     {
         return _created;
@@ -81,6 +168,8 @@ public:
 
 private:
     QString _topic;
+    UriAtom _atom;
+    UriMatch _match;
     qulonglong _subscriptionId;
     WampRouterSession* _subscriber;
     QDateTime _created;
@@ -95,11 +184,24 @@ class WampRouterPrivate : public QObject
 public:
     QString _host;
     int _port;
+    int _rawSocketPort;
+    QString _localSocketPath;
+    QString _sharedMemorySocketPath;
+    bool _payloadPassthrough;
+    WampDecodeLimits _decodeLimits;
+    int _threadPoolSize;
+    WampRouter::SessionAssignment _sessionAssignment;
+    int _outboundQueueLimit;
+    int _outboundHighWatermark;
+    int _outboundLowWatermark;
+    WampRouter::SlowConsumerPolicy _slowConsumerPolicy;
+    int _writeBatchWindow;
     QThread* _workerThread;
     WampRouterWorker* _worker;
 
     WampRouterPrivate(WampRouter* parent);
     ~WampRouterPrivate();
+    bool isTracingMessages() const;
 public Q_SLOTS:
     void messageReceived(QVariantList message);
     void messageSent(QVariantList message);
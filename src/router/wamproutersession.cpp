@@ -7,8 +7,13 @@
 #include "user.h"
 #include "wamprouterworker.h"
 #include "wampmessageserializer.h"
-#include "websocketconnection.h"
+#include "wampmessage.h"
+#include "wamptransport.h"
 #include "random.h"
+#include "eventfanout.h"
+#include "sessionthreadpool.h"
+#include "outboundqueue.h"
+#include "framebatcher.h"
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -17,242 +22,574 @@
 
 namespace QFlow{
 
-WampRouterSessionPrivate::WampRouterSessionPrivate(WampRouterSession* parent) : QObject(), q_ptr(parent)
+const int AUTHORIZATION_SWEEP_MIN = 64;
+
+WampRouterSessionPrivate::WampRouterSessionPrivate(WampRouterSession* parent) : QObject(), _authorizationSweep(AUTHORIZATION_SWEEP_MIN),
+    _outboundStalled(false), _holds(0),
+    q_ptr(parent)
 {
+    _batcher = new FrameBatcher([this](const QList<FrameBatcher::Frame>& frames) {
+        if(_socket) _socket->sendBatch(frames);
+    }, this);
 }
 WampRouterSessionPrivate::~WampRouterSessionPrivate()
 {
-    _socket->deleteLater();
+    if(_socket) _socket->deleteLater();
 }
 void WampRouterSessionPrivate::sendWampMessage(const QVariantList& arr)
 {
     Q_Q(WampRouterSession);
-    QByteArray message = _serializer->serialize(arr);
-    if(_serializer->isBinary())
+    if(!_serializer)
     {
-        _socket->sendBinary(message);
+        if(_socket) _socket->sendMessage(arr);
     }
     else
     {
-        _socket->sendText(message);
+        write(_serializer->serialize(arr));
     }
     Q_EMIT q->messageSent(arr);
 }
-WampRouterSession::WampRouterSession(WebSocketConnection *socket, QString subprotocol, QObject *parent) : QThread(parent), d_ptr(new WampRouterSessionPrivate(this))
+void WampRouterSessionPrivate::sendFrame(const QByteArray &frame, const QByteArray &payload)
+{
+    Q_Q(WampRouterSession);
+    // in-process sessions get messages, never frames
+    if(!_serializer) return;
+    write(frame, payload);
+    if(_router->_router->isTracingMessages()) Q_EMIT q->messageSent(_serializer->deserialize(frame + payload));
+}
+// Transports writing one message at a time gain nothing from waiting for a batch
+void WampRouterSessionPrivate::write(const QByteArray &frame, const QByteArray &payload)
+{
+    if(!_socket) return;
+    if(_socket->writesBatches()) _batcher->append(frame, payload, _serializer->isBinary());
+    else _socket->send(payload.isEmpty() ? frame : frame + payload, _serializer->isBinary());
+}
+// Called from any thread. Only one drain is queued per burst instead of one call per message.
+void WampRouterSessionPrivate::enqueue(const OutboundMessage &message, WampRouterSession *publisher)
+{
+    bool scheduleDrain = false;
+    OutboundQueue::PushResult result = _outbound->push(message, &scheduleDrain);
+    if(result == OutboundQueue::Overflow)
+    {
+        QMetaObject::invokeMethod(this, "disconnectSlowConsumer", Qt::QueuedConnection);
+        return;
+    }
+    if(result == OutboundQueue::Congested && publisher) holdPublisher(publisher);
+    if(scheduleDrain) QMetaObject::invokeMethod(this, "drainOutbound", Qt::QueuedConnection);
+}
+// Called from any thread. The queue is checked again under the lock, a drain that relieved it
+// in between has nobody left to release.
+void WampRouterSessionPrivate::holdPublisher(WampRouterSession *publisher)
+{
+    QMutexLocker lock(&_heldMutex);
+    if(!_outbound->isCongested()) return;
+    for(const QPointer<WampRouterSession>& held: _heldPublishers)
+    {
+        if(held == publisher) return;
+    }
+    _heldPublishers.append(publisher);
+    publisher->d_func()->hold();
+}
+void WampRouterSessionPrivate::releasePublishers()
+{
+    QList<QPointer<WampRouterSession>> held;
+    {
+        QMutexLocker lock(&_heldMutex);
+        held.swap(_heldPublishers);
+    }
+    for(const QPointer<WampRouterSession>& publisher: held)
+    {
+        if(publisher) publisher->d_func()->release();
+    }
+}
+// Reads stay paused while any congested session holds this one
+void WampRouterSessionPrivate::hold()
+{
+    if(_holds.fetchAndAddOrdered(1) != 0) return;
+    if(QThread::currentThread() == thread()) updateReading();
+    else QMetaObject::invokeMethod(this, "updateReading", Qt::QueuedConnection);
+}
+void WampRouterSessionPrivate::release()
+{
+    if(_holds.fetchAndAddOrdered(-1) != 1) return;
+    if(QThread::currentThread() == thread()) updateReading();
+    else QMetaObject::invokeMethod(this, "updateReading", Qt::QueuedConnection);
+}
+void WampRouterSessionPrivate::updateReading()
+{
+    if(_socket) _socket->setReadingPaused(_holds.load() > 0);
+}
+void WampRouterSessionPrivate::drainOutbound()
+{
+    int highWatermark = _router->_router->_outboundHighWatermark;
+    OutboundMessage message;
+    bool relieved = false;
+    while(_socket)
+    {
+        if(pendingBytes() >= highWatermark)
+        {
+            _outboundStalled = true;
+            return;
+        }
+        if(!_outbound->take(&message, &relieved)) return;
+        if(relieved) releasePublishers();
+        if(message.frame.isEmpty()) sendWampMessage(message.message);
+        else sendFrame(message.frame, message.payload);
+    }
+}
+// Bytes written by this session that have not reached the network yet
+int WampRouterSessionPrivate::pendingBytes() const
+{
+    return int(_socket->bytesToWrite()) + _batcher->pendingBytes();
+}
+void WampRouterSessionPrivate::onBytesWritten()
+{
+    if(!_outboundStalled || !_socket) return;
+    if(pendingBytes() > _router->_router->_outboundLowWatermark) return;
+    _outboundStalled = false;
+    drainOutbound();
+}
+void WampRouterSessionPrivate::disconnectSlowConsumer()
+{
+    if(!_socket) return;
+    Q_Q(WampRouterSession);
+    qWarning() << QString("Disconnecting slow consumer %1, %2 messages dropped").arg(q->peerAddress()).arg(_outbound->dropped());
+    _outbound->close();
+    releasePublishers();
+    abort(KEY_ERR_SLOW_CONSUMER, "Outbound queue limit exceeded.");
+    _batcher->flush();
+    _socket->close();
+}
+WampRouterSession::WampRouterSession(WampTransport *socket, QString subprotocol, QObject *parent) : QThread(parent), d_ptr(new WampRouterSessionPrivate(this))
 {
     Q_D(WampRouterSession);
-    d->moveToThread(this);
     d->_sessionId = Random::generate();
-    d->_serializer.reset(WampMessageSerializer::create(subprotocol));
+    d->_subprotocol = subprotocol;
     d->_socket = socket;
-    QObject::connect(socket, SIGNAL(messageReceived(QByteArray)), d, SLOT(onMessageReceived(QByteArray)));
-    QObject::connect(socket, SIGNAL(closed()), d, SLOT(closed()));
     d->_router = (WampRouterWorker*)parent;
-    start();
+    // in-process transports skip the serializer, their session has none
+    if(socket->carriesMessages())
+    {
+        d->_format = subprotocol;
+        QObject::connect(socket, SIGNAL(wampMessageReceived(QVariantList)), d, SLOT(onWampMessageReceived(QVariantList)));
+    }
+    else
+    {
+        d->_serializer.reset(WampMessageSerializer::create(subprotocol));
+        d->_format = d->_serializer->format();
+        d->_serializer->setLimits(d->_router->_router->_decodeLimits);
+        QObject::connect(socket, SIGNAL(messageReceived(QByteArray)), d, SLOT(onMessageReceived(QByteArray)));
+    }
+    QObject::connect(socket, SIGNAL(closed()), d, SLOT(closed()));
+    d->_outbound.reset(new OutboundQueue(d->_router->_router->_outboundQueueLimit, d->_router->_router->_slowConsumerPolicy));
+    QObject::connect(socket, SIGNAL(bytesWritten(qint64)), d, SLOT(onBytesWritten()));
+    d->_batcher->setWindow(d->_router->_router->_writeBatchWindow);
+    if(d->_router->_threadPool)
+    {
+        d->moveToThread(d->_router->_threadPool->acquire(d->_sessionId));
+    }
+    else
+    {
+        d->moveToThread(this);
+        start();
+    }
+    // the transport's events are handled where the session runs
+    socket->moveToThread(d->thread());
 }
 void WampRouterSessionPrivate::onMessageReceived(const QByteArray &message)
 {
     Q_Q(WampRouterSession);
-    QVariantList arr = _serializer->deserialize(message);
-    Q_EMIT q->messageReceived(arr);
-    WampMsgCode code = (WampMsgCode)arr[0].toInt();
-    if(code == WampMsgCode::HELLO)
-    {
-        QString realmName = arr[1].toString();
-        Realm* realmFound = NULL;
-        for(Realm* r: _router->_realms) {
-            if(realmName == r->name())
-            {
-                realmFound = r;
-                break;
-            }
-        }
-        if(!realmFound)
-        {
-            abort(KEY_ERR_NO_SUCH_REALM, "The realm does not exist.");
-            return;
-        }
-        _realm = realmFound;
-        QVariantMap details = arr[2].toMap();
-        if(!realmFound->d_ptr->_authenticators.isEmpty())
+    if(_router->_router->isTracingMessages()) Q_EMIT q->messageReceived(_serializer->deserialize(message));
+    dispatch(_serializer->decode(message, _router->_router->_payloadPassthrough));
+}
+void WampRouterSessionPrivate::onWampMessageReceived(const QVariantList &message)
+{
+    Q_Q(WampRouterSession);
+    if(_router->_router->isTracingMessages()) Q_EMIT q->messageReceived(message);
+    dispatch(toWampMessage(message));
+}
+void WampRouterSessionPrivate::dispatch(const WampMessagePointer &msg)
+{
+    Q_Q(WampRouterSession);
+    if(!msg)
+    {
+        qWarning() << QString("Malformed WAMP message received from %1").arg(q->peerAddress());
+        abort(KEY_ERR_PROTOCOL_VIOLATION, "Malformed message or decode limits exceeded.");
+        _batcher->flush();
+        _socket->close();
+        return;
+    }
+    switch(msg->code)
+    {
+    case WampMsgCode::HELLO:
+        handleHello(message_cast<HelloMessage>(msg));
+        break;
+    case WampMsgCode::AUTHENTICATE:
+        handleAuthenticate(message_cast<AuthenticateMessage>(msg));
+        break;
+    case WampMsgCode::REGISTER:
+        handleRegister(message_cast<RegisterMessage>(msg));
+        break;
+    case WampMsgCode::UNREGISTER:
+        handleUnregister(message_cast<UnregisterMessage>(msg));
+        break;
+    case WampMsgCode::CALL:
+        handleCall(message_cast<CallMessage>(msg));
+        break;
+    case WampMsgCode::YIELD:
+        handleYield(message_cast<YieldMessage>(msg));
+        break;
+    case WampMsgCode::ERROR:
+        handleError(message_cast<ErrorMessage>(msg));
+        break;
+    case WampMsgCode::CANCEL:
+        handleCancel(message_cast<CancelMessage>(msg));
+        break;
+    case WampMsgCode::SUBSCRIBE:
+        handleSubscribe(message_cast<SubscribeMessage>(msg));
+        break;
+    case WampMsgCode::UNSUBSCRIBE:
+        handleUnsubscribe(message_cast<UnsubscribeMessage>(msg));
+        break;
+    case WampMsgCode::PUBLISH:
+        handlePublish(message_cast<PublishMessage>(msg));
+        break;
+    default:
+        break;
+    }
+}
+void WampRouterSessionPrivate::handleHello(const HelloMessage &msg)
+{
+    Realm* realmFound = NULL;
+    for(Realm* r: _router->_realms) {
+        if(msg.realm == r->name())
         {
-            QVariantList authMethods2 = details["authmethods"].toList();
-            Authenticator* foundAuth = NULL;
-            for(QVariant authMethod: authMethods2)
-            {
-                foundAuth = realmFound->findAuthenticatorByAuthMethod(authMethod.toString());
-                if(foundAuth) break;
-            }
-            if(foundAuth)
-            {
-                _authId = details["authid"].toString();
-                QVariantMap challenge = foundAuth->generateChallenge(_sessionId, _authId);
-                QVariantList authArr{WampMsgCode::CHALLENGE, foundAuth->authMethod(), challenge};
-                _authSession.reset(foundAuth->createSession());
-                _authSession->challenge = challenge;
-                _authSession->authenticator = foundAuth;
-                _authSession->user = foundAuth->user(_authId);
-                sendWampMessage(authArr);
-                return;
-            }
-
+            realmFound = r;
+            break;
         }
     }
-    else if(code == WampMsgCode::AUTHENTICATE)
+    if(!realmFound)
     {
-        _authSession->inBuffer = arr[1].toByteArray();
-        AUTH_RESULT authResult = _authSession->authenticate();
-        if(authResult == AUTH_RESULT::ACCEPTED)
+        abort(KEY_ERR_NO_SUCH_REALM, "The realm does not exist.");
+        return;
+    }
+    _realm = realmFound;
+    if(msg.details.value(KEY_NATIVE_TIMESTAMPS).toBool() && _serializer && _serializer->setNativeTimestamps(true))
+    {
+        _format = _serializer->format();
+    }
+    // known before an authenticator is picked, so every one of them can take the peer into account
+    PeerCredentials peer = _socket ? _socket->peerCredentials() : PeerCredentials();
+    if(!realmFound->d_ptr->_authenticators.isEmpty())
+    {
+        QVariantList authMethods2 = msg.details["authmethods"].toList();
+        Authenticator* foundAuth = NULL;
+        for(QVariant authMethod: authMethods2)
         {
-            if(!_authSession->user) _authSession->user = _authSession->authenticator->getUser(_authSession.data());
-            if(_authSession->user)
-            {
-                welcome();
-            }
-            else abort(KEY_ERR_NOT_AUTHORIZED);
+            foundAuth = realmFound->findAuthenticatorByAuthMethod(authMethod.toString());
+            if(foundAuth) break;
         }
-        if(authResult == AUTH_RESULT::REJECTED)
+        if(foundAuth)
         {
-            abort(KEY_ERR_NOT_AUTHENTICATED);
+            _authId = msg.details["authid"].toString();
+            QVariantMap challenge = foundAuth->generateChallenge(_sessionId, _authId, peer);
+            QVariantList authArr{WampMsgCode::CHALLENGE, foundAuth->authMethod(), challenge};
+            _authSession.reset(foundAuth->createSession());
+            _authSession->peer = peer;
+            _authSession->challenge = challenge;
+            _authSession->authenticator = foundAuth;
+            _authSession->user = foundAuth->user(_authId, peer);
+            sendWampMessage(authArr);
+            return;
         }
-        if(authResult == AUTH_RESULT::CONTINUE)
+
+    }
+}
+void WampRouterSessionPrivate::handleAuthenticate(const AuthenticateMessage &msg)
+{
+    _authSession->inBuffer = msg.signature;
+    AUTH_RESULT authResult = _authSession->authenticate();
+    if(authResult == AUTH_RESULT::ACCEPTED)
+    {
+        if(!_authSession->user) _authSession->user = _authSession->authenticator->getUser(_authSession.data());
+        if(_authSession->user)
         {
-            QVariantMap obj;
-            obj["challenge"] = _authSession->outBuffer;
-            QVariantList authArr{WampMsgCode::CHALLENGE, _authSession->authenticator->authMethod(), obj};
-            sendWampMessage(authArr);
+            welcome();
         }
+        else abort(KEY_ERR_NOT_AUTHORIZED);
+    }
+    if(authResult == AUTH_RESULT::REJECTED)
+    {
+        abort(KEY_ERR_NOT_AUTHENTICATED);
+    }
+    if(authResult == AUTH_RESULT::CONTINUE)
+    {
+        QVariantMap obj;
+        obj["challenge"] = _authSession->outBuffer;
+        QVariantList authArr{WampMsgCode::CHALLENGE, _authSession->authenticator->authMethod(), obj};
+        sendWampMessage(authArr);
+    }
+}
+void WampRouterSessionPrivate::handleRegister(const RegisterMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    UriMatch match;
+    InvocationPolicy policy;
+    if(!uriMatchFromString(msg.options.value(KEY_MATCH).toString(), &match) ||
+       !invocationPolicyFromString(msg.options.value(KEY_INVOKE).toString(), &policy))
+    {
+        error(WampMsgCode::REGISTER, KEY_ERR_INVALID_ARGUMENT, msg.requestId);
+        return;
+    }
+    // only authorized URIs are interned
+    bool authorized = authorize(msg.procedure, _realm->d_ptr->_atoms.find(msg.procedure), WampMsgCode::REGISTER, msg.requestId);
+    if(!authorized) return;
+    UriAtom atom = _realm->d_ptr->_atoms.intern(msg.procedure);
+    WampRouterRegistrationPointer candidate(new WampRouterRegistration(Random::generate(), msg.procedure, atom, match, policy, q));
+    QString errorUri;
+    WampRouterRegistrationPointer registration = _realm->d_ptr->insertRegistration(candidate, &errorUri);
+    if(!registration)
+    {
+        error(WampMsgCode::REGISTER, errorUri, msg.requestId);
+        return;
     }
-    else if(code == WampMsgCode::REGISTER)
+    _registrations.append(registration->registrationId());
+    if(registration != candidate)
     {
-        qulonglong requestId = arr[1].toULongLong();
-        QString uri = arr[3].toString();
-        bool authorized = authorize(uri, WampMsgCode::REGISTER, requestId);
+        // joined a shared registration
+        QVariantList resArr{WampMsgCode::REGISTERED, msg.requestId, registration->registrationId()};
+        sendWampMessage(resArr);
+        Q_EMIT q->registered(msg.procedure);
+        return;
+    }
+    QVariantList onCreateArgs{_sessionId};
+    QVariantMap details;
+    details["id"] = registration->registrationId();
+    details["created"] = registration->created().toString("yyyy-mm-ddThh:mm:zzzZ");
+    details["uri"] = msg.procedure;
+    details[KEY_MATCH] = uriMatchToString(match);
+    details[KEY_INVOKE] = msg.options.value(KEY_INVOKE, KEY_INVOKE_SINGLE);
+    onCreateArgs.append(details);
+    _realm->publish(KEY_REGISTRATION_ON_CREATE, onCreateArgs);
+    QVariantList resArr{WampMsgCode::REGISTERED, msg.requestId, registration->registrationId()};
+    sendWampMessage(resArr);
+    Q_EMIT q->registered(msg.procedure);
+}
+void WampRouterSessionPrivate::handleUnregister(const UnregisterMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    WampRouterRegistrationPointer reg = _realm->d_ptr->getRegistration(msg.registrationId);
+    if(reg && reg->callee(q))
+    {
+        bool authorized = authorize(reg->uri(), reg->atom(), WampMsgCode::REGISTER, msg.requestId);
         if(!authorized) return;
-        WampRouterRegistrationPointer registration(new WampRouterRegistration(Random::generate(), uri, q));
-        _realm->d_ptr->insertRegistration(uri, registration);
-        _registrations.append(registration);
-        QVariantList onCreateArgs{_sessionId};
-        QVariantMap details;
-        details["id"] = registration->registrationId();
-        details["created"] = registration->created().toString("yyyy-mm-ddThh:mm:zzzZ");
-        details["uri"] = uri;
-        onCreateArgs.append(details);
-        _realm->publish(KEY_REGISTRATION_ON_CREATE, onCreateArgs);
-        QVariantList resArr{WampMsgCode::REGISTERED, requestId, registration->registrationId()};
+        _realm->d_ptr->removeCallee(msg.registrationId, q);
+        _registrations.removeAll(msg.registrationId);
+        QVariantList resArr{WampMsgCode::UNREGISTERED, msg.requestId};
         sendWampMessage(resArr);
-        Q_EMIT q->registered(uri);
+        Q_EMIT q->unregistered(reg->uri());
     }
-    else if(code == WampMsgCode::UNREGISTER)
+    else
     {
-        qulonglong requestId = arr[1].toULongLong();
-        qulonglong registrationId = arr[2].toULongLong();
-        if(_realm->d_ptr->_idRegistartion.contains(registrationId))
-        {
-            WampRouterRegistrationPointer reg = _realm->d_ptr->getRegistration(registrationId);
-            bool authorized = authorize(reg->uri(), WampMsgCode::REGISTER, requestId);
-            if(!authorized) return;
-            _realm->d_ptr->removeRegistration(reg);
-            QVariantList resArr{WampMsgCode::UNREGISTERED, requestId};
-            sendWampMessage(resArr);
-            Q_EMIT q->unregistered(reg->uri());
-        }
-        else
-        {
-            error(WampMsgCode::UNREGISTER, KEY_ERR_NO_SUCH_REGISTRATION, requestId);
-        }
+        error(WampMsgCode::UNREGISTER, KEY_ERR_NO_SUCH_REGISTRATION, msg.requestId);
     }
-    else if(code == WampMsgCode::CALL)
+}
+void WampRouterSessionPrivate::handleCall(const CallMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    UriAtom atom = _realm->d_ptr->_atoms.find(msg.procedure);
+    bool authorized = authorize(msg.procedure, atom, WampMsgCode::CALL, msg.requestId);
+    if(!authorized) return;
+    bool progress = msg.options.value(KEY_PROGRESS).toBool();
+    PendingInvocation pending;
+    if(_realm->d_ptr->continueCall(q, msg.requestId, progress, &pending))
     {
-        qulonglong requestId = arr[1].toULongLong();
-        QString uri = arr[3].toString();
-        QVariantList params;
-        if(arr.count()>4) params = arr[4].toList();
-        bool authorized = authorize(uri, WampMsgCode::CALL, requestId);
-        if(!authorized) return;
-        if(_realm->containsRegistration(uri))
-        {
-            WampRouterRegistrationPointer reg = _realm->d_ptr->getRegistration(uri);
-            _realm->d_ptr->insertPendingInvocation(requestId, q);
-            reg->handleRemote(requestId, q, params);
-        }
-        else if(_realm->d_ptr->containsInternalRegistration(uri))
-        {
-            RegistrationPointer impl = _realm->d_ptr->getInternalRegistration(uri);
-            WampResult res = impl->execute(params);
-            if(res.isError()) error(WampMsgCode::CALL, res.errorUri(), requestId);
-            else result(requestId, res.resultData());
-        }
-        else
-        {
-            error(WampMsgCode::CALL, KEY_ERR_NO_SUCH_PROCEDURE, requestId, {{"procedureUri", uri}});
-        }
+        // later chunks of a progressive call go to the callee invoked for the first one
+        if(pending.canceled) return;
+        QVariantMap details;
+        if(progress) details[KEY_PROGRESS] = true;
+        QVariantList head{(int)WampMsgCode::INVOCATION, pending.invocationId, pending.registrationId, details};
+        forward(pending.callee->session(), head, msg.payload, msg.args, msg.kwargs);
+        return;
     }
-    else if(code == WampMsgCode::YIELD)
+    RegistrationPointer impl;
+    WampRouterRegistrationPointer reg = _realm->d_ptr->matchRegistration(msg.procedure, atom);
+    WampRouterCalleePointer callee = reg ? reg->selectCallee() : WampRouterCalleePointer();
+    if(callee)
     {
-        qulonglong requstId = arr[1].toULongLong();
-        WampRouterSession* caller = _realm->d_ptr->takePendingInvocation(requstId);
-        QVariantList resultArr;
-        if(arr.count()>3) resultArr = arr[3].toList();
-        caller->result(requstId, resultArr);
+        qint64 timeout = msg.options.value(KEY_CALL_TIMEOUT).toLongLong();
+        bool receiveProgress = msg.options.value(KEY_RECEIVE_PROGRESS).toBool();
+        qulonglong invocationId = _realm->d_ptr->insertPendingInvocation(q, msg.requestId, callee, reg->registrationId(),
+                                                                         timeout, receiveProgress, progress);
+        QVariantMap details;
+        // pattern-based callees dispatch on the concrete procedure
+        if(reg->match() != UriMatch::Exact) details["procedure"] = msg.procedure;
+        if(receiveProgress) details[KEY_RECEIVE_PROGRESS] = true;
+        if(progress) details[KEY_PROGRESS] = true;
+        QVariantList head{(int)WampMsgCode::INVOCATION, invocationId, reg->registrationId(), details};
+        forward(callee->session(), head, msg.payload, msg.args, msg.kwargs);
     }
-    else if(code == WampMsgCode::SUBSCRIBE)
+    else if((impl = _realm->d_ptr->getInternalRegistration(atom)))
     {
-        qulonglong requestId = arr[1].toULongLong();
-        QString topic = arr[3].toString();
-        bool authorized = authorize(topic, WampMsgCode::SUBSCRIBE, requestId);
-        if(!authorized) return;
+        QVariantList args = msg.payload.format.isEmpty() ? msg.args : _serializer->deserializePayload(msg.payload).value(0).toList();
+        WampResult res = impl->execute(args);
+        if(res.isError()) error(WampMsgCode::CALL, res.errorUri(), msg.requestId);
+        else result(msg.requestId, res.resultData());
+    }
+    else
+    {
+        error(WampMsgCode::CALL, KEY_ERR_NO_SUCH_PROCEDURE, msg.requestId, {{"procedureUri", msg.procedure}});
+    }
+}
+void WampRouterSessionPrivate::handleYield(const YieldMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    if(msg.options.value(KEY_PROGRESS).toBool())
+    {
+        // chunks are forwarded as they arrive, the invocation stays pending until the final YIELD
+        PendingInvocation invocation;
+        if(!_realm->d_ptr->findPendingInvocation(msg.requestId, q, &invocation)) return;
+        if(invocation.canceled || !invocation.receiveProgress) return;
+        QVariantList head{(int)WampMsgCode::RESULT, invocation.callerRequestId, QVariantMap{{KEY_PROGRESS, true}}};
+        forward(invocation.caller, head, msg.payload, msg.args, msg.kwargs);
+        return;
+    }
+    PendingInvocation invocation = _realm->d_ptr->takePendingInvocation(msg.requestId, q);
+    if(!invocation.caller) return;
+    if(invocation.canceled)
+    {
+        QVariantList errArr{(int)WampMsgCode::ERROR, (int)WampMsgCode::CALL, invocation.callerRequestId, QVariantMap(), KEY_ERR_CANCELED};
+        invocation.caller->sendWampMessage(errArr);
+        return;
+    }
+    QVariantList head{(int)WampMsgCode::RESULT, invocation.callerRequestId, QVariantMap()};
+    forward(invocation.caller, head, msg.payload, msg.args, msg.kwargs);
+}
+// skip answers the caller right away and lets the invocation run, kill interrupts the callee
+// and waits for its answer, killnowait interrupts the callee and answers the caller right away
+void WampRouterSessionPrivate::handleCancel(const CancelMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    QString mode = msg.options.value(KEY_CANCEL_MODE, KEY_CANCEL_SKIP).toString();
+    if(mode != KEY_CANCEL_SKIP && mode != KEY_CANCEL_KILL && mode != KEY_CANCEL_KILLNOWAIT)
+    {
+        error(WampMsgCode::CANCEL, KEY_ERR_INVALID_ARGUMENT, msg.requestId);
+        return;
+    }
+    PendingInvocation invocation;
+    if(!_realm->d_ptr->cancelInvocation(q, msg.requestId, mode == KEY_CANCEL_KILL, &invocation)) return;
+    if(mode != KEY_CANCEL_SKIP)
+    {
+        QVariantMap options{{KEY_CANCEL_MODE, mode}};
+        invocation.callee->session()->sendWampMessage({(int)WampMsgCode::INTERRUPT, invocation.invocationId, options});
+    }
+    if(mode != KEY_CANCEL_KILL) error(WampMsgCode::CALL, KEY_ERR_CANCELED, msg.requestId);
+}
+void WampRouterSessionPrivate::handleError(const ErrorMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    if(msg.requestType != WampMsgCode::INVOCATION) return;
+    PendingInvocation invocation = _realm->d_ptr->takePendingInvocation(msg.requestId, q);
+    if(!invocation.caller) return;
+    QVariantList errArr{(int)WampMsgCode::ERROR, (int)WampMsgCode::CALL, invocation.callerRequestId, msg.details, msg.error};
+    if(!msg.args.isEmpty() || !msg.kwargs.isEmpty()) errArr.append(QVariant(msg.args));
+    if(!msg.kwargs.isEmpty()) errArr.append(QVariant(msg.kwargs));
+    invocation.caller->sendWampMessage(errArr);
+}
+void WampRouterSessionPrivate::handleSubscribe(const SubscribeMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    UriMatch match;
+    if(!uriMatchFromString(msg.options.value(KEY_MATCH).toString(), &match))
+    {
+        error(WampMsgCode::SUBSCRIBE, KEY_ERR_INVALID_ARGUMENT, msg.requestId);
+        return;
+    }
+    // only authorized URIs are interned
+    bool authorized = authorize(msg.topic, _realm->d_ptr->_atoms.find(msg.topic), WampMsgCode::SUBSCRIBE, msg.requestId);
+    if(!authorized) return;
+    UriAtom atom = _realm->d_ptr->_atoms.intern(msg.topic);
 
-        qulonglong subscriptionId = Random::generate();
-        WampRouterSubscriptionPointer subscription(new WampRouterSubscription(topic, subscriptionId, q));
-        if(!_realm->d_ptr->containsSubscription(topic))
-        {
-            QVariantList onCreateArgs{_sessionId};
-            QVariantMap details;
-            details["id"] = subscriptionId;
-            details["created"] = subscription->created().toString("yyyy-mm-ddThh:mm:zzzZ");
-            details["uri"] = topic;
-            onCreateArgs.append(details);
-            _realm->publish(KEY_SUBSCRIPTION_ON_CREATE, onCreateArgs);
-        }
-        _realm->publish(KEY_SUBSCRIPTION_ON_SUBSCRIBE, {_sessionId, subscriptionId, topic});
+    qulonglong subscriptionId = Random::generate();
+    WampRouterSubscriptionPointer subscription(new WampRouterSubscription(msg.topic, atom, match, subscriptionId, q));
+    if(!_realm->d_ptr->hasSubscribers(atom, match))
+    {
+        QVariantList onCreateArgs{_sessionId};
+        QVariantMap details;
+        details["id"] = subscriptionId;
+        details["created"] = subscription->created().toString("yyyy-mm-ddThh:mm:zzzZ");
+        details["uri"] = msg.topic;
+        details[KEY_MATCH] = uriMatchToString(match);
+        onCreateArgs.append(details);
+        _realm->publish(KEY_SUBSCRIPTION_ON_CREATE, onCreateArgs);
+    }
+    _realm->publish(KEY_SUBSCRIPTION_ON_SUBSCRIBE, {_sessionId, subscriptionId, msg.topic});
 
-        _realm->d_ptr->insertSubscription(subscriptionId, topic, subscription);
-        _subscriptions.append(subscription);
+    _realm->d_ptr->insertSubscription(subscription);
+    _subscriptions.append(subscription);
 
-        QVariantList resArr{WampMsgCode::SUBSCRIBED, requestId, subscriptionId};
-        sendWampMessage(resArr);
-        Q_EMIT q->subscribed(topic);
+    QVariantList resArr{WampMsgCode::SUBSCRIBED, msg.requestId, subscriptionId};
+    sendWampMessage(resArr);
+    Q_EMIT q->subscribed(msg.topic);
+}
+void WampRouterSessionPrivate::handleUnsubscribe(const UnsubscribeMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    if(!_realm->d_ptr->containsSubscription(msg.subscriptionId))
+    {
+        error(WampMsgCode::UNSUBSCRIBE, KEY_ERR_NO_SUCH_SUBSCRIPTION, msg.requestId);
+        return;
     }
-    else if(code == WampMsgCode::UNSUBSCRIBE)
+    WampRouterSubscriptionPointer sub = _realm->d_ptr->takeSubscription(msg.subscriptionId);
+    _subscriptions.removeAll(sub);
+    QVariantList resArr{WampMsgCode::UNSUBSCRIBED, msg.requestId};
+    sendWampMessage(resArr);
+    Q_EMIT q->unsubscribed(sub->topic());
+}
+void WampRouterSessionPrivate::handlePublish(const PublishMessage &msg)
+{
+    Q_Q(WampRouterSession);
+    UriAtom atom = _realm->d_ptr->_atoms.find(msg.topic);
+    bool authorized = authorize(msg.topic, atom, WampMsgCode::PUBLISH, msg.requestId);
+    if(!authorized) return;
+
+    qulonglong publicationId = Random::generate();
+    if(!msg.payload.format.isEmpty())
+    {
+        EventFanout fanout(publicationId, msg.payload);
+        fanout.setPublisher(q);
+        _realm->d_ptr->publish(msg.topic, atom, fanout);
+    }
+    else
+    {
+        EventFanout fanout(publicationId, msg.args, msg.kwargs);
+        fanout.setPublisher(q);
+        _realm->d_ptr->publish(msg.topic, atom, fanout);
+    }
+
+    QVariantList resArr{WampMsgCode::PUBLISHED, msg.requestId, publicationId};
+    sendWampMessage(resArr);
+}
+// Sends head followed by the args/kwargs of a CALL, YIELD or PUBLISH to target. A payload that
+// is already encoded in the format target negotiated is spliced in without being decoded.
+void WampRouterSessionPrivate::forward(WampRouterSession *target, QVariantList head, const WampPayload &payload,
+                                       const QVariantList &args, const QVariantMap &kwargs)
+{
+    if(!payload.format.isEmpty())
     {
-        qulonglong requestId = arr[1].toULongLong();
-        qulonglong subscriptionId = arr[2].toULongLong();
-        if(!_realm->d_ptr->containsSubscription(subscriptionId))
+        if(payload.format == target->format())
         {
-            error(WampMsgCode::UNSUBSCRIBE, KEY_ERR_NO_SUCH_SUBSCRIPTION, requestId);
+            target->sendFrame(_serializer->serialize(head, payload));
             return;
         }
-        WampRouterSubscriptionPointer sub = _realm->d_ptr->takeSubscription(subscriptionId);
-        _subscriptions.removeAll(sub);
-        QVariantList resArr{WampMsgCode::UNSUBSCRIBED, requestId};
-        sendWampMessage(resArr);
-        Q_EMIT q->unsubscribed(sub->topic());
+        head.append(_serializer->deserializePayload(payload));
     }
-    else if(code == WampMsgCode::PUBLISH)
+    else
     {
-        qulonglong requestId = arr[1].toULongLong();
-        QString topic = arr[3].toString();
-        QVariantList args;
-        if(arr.count() > 4) args = arr[4].toList();
-        bool authorized = authorize(topic, WampMsgCode::PUBLISH, requestId);
-        if(!authorized) return;
-
-        qulonglong publicationId = _realm->publish(topic, args);
-
-        QVariantList resArr{WampMsgCode::PUBLISHED, requestId, publicationId};
-        sendWampMessage(resArr);
+        if(!args.isEmpty() || !kwargs.isEmpty()) head.append(QVariant(args));
+        if(!kwargs.isEmpty()) head.append(QVariant(kwargs));
     }
+    target->sendWampMessage(head);
 }
 
 void WampRouterSession::run()
@@ -262,7 +599,13 @@ void WampRouterSession::run()
 WampRouterSession::~WampRouterSession()
 {
     Q_D(WampRouterSession);
+    QThread* thread = d->thread();
+    WampRouterWorker* router = d->_router;
     QMetaObject::invokeMethod(d, "deleteLater", Qt::BlockingQueuedConnection);
+    if(thread != this)
+    {
+        router->_threadPool->release(thread);
+    }
     exit();
     wait();
 }
@@ -271,10 +614,53 @@ qulonglong WampRouterSession::sessionId() const
     Q_D(const WampRouterSession);
     return d->_sessionId;
 }
-void WampRouterSession::sendWampMessage(const QVariantList &arr)
+void WampRouterSession::sendWampMessage(const QVariantList &arr, WampRouterSession *publisher)
+{
+    Q_D(WampRouterSession);
+    OutboundMessage message;
+    message.message = arr;
+    message.droppable = arr.value(0).toInt() == (int)WampMsgCode::EVENT;
+    d->enqueue(message, publisher);
+}
+
+void WampRouterSession::sendFrame(const QByteArray &frame, bool droppable)
+{
+    sendFrame(frame, QByteArray(), droppable);
+}
+void WampRouterSession::sendFrame(const QByteArray &head, const QByteArray &payload, bool droppable,
+                                  WampRouterSession *publisher)
 {
     Q_D(WampRouterSession);
-    QMetaObject::invokeMethod(d, "sendWampMessage", Qt::QueuedConnection, Q_ARG(QVariantList, arr));
+    OutboundMessage message;
+    message.frame = head;
+    message.payload = payload;
+    message.droppable = droppable;
+    d->enqueue(message, publisher);
+}
+int WampRouterSession::outboundDepth() const
+{
+    Q_D(const WampRouterSession);
+    return d->_outbound->depth();
+}
+qulonglong WampRouterSession::droppedMessages() const
+{
+    Q_D(const WampRouterSession);
+    return d->_outbound->dropped();
+}
+QString WampRouterSession::subprotocol() const
+{
+    Q_D(const WampRouterSession);
+    return d->_subprotocol;
+}
+QString WampRouterSession::format() const
+{
+    Q_D(const WampRouterSession);
+    return d->_format;
+}
+bool WampRouterSession::carriesMessages() const
+{
+    Q_D(const WampRouterSession);
+    return !d->_serializer;
 }
 
 void WampRouterSessionPrivate::error(WampMsgCode code, QString uri, qulonglong requestId, QVariantMap details)
@@ -287,8 +673,14 @@ void WampRouterSessionPrivate::error(WampMsgCode code, QString uri, qulonglong r
 void WampRouterSessionPrivate::welcome()
 {
     Q_Q(WampRouterSession);
-    QVariantMap roles{{"broker", QVariantMap()}, {"dealer", QVariantMap()}};
+    QVariantMap broker{{"features", QVariantMap{{"pattern_based_subscription", true}}}};
+    QVariantMap dealer{{"features", QVariantMap{{"pattern_based_registration", true}, {"shared_registration", true},
+                                                    {"call_canceling", true}, {"call_timeout", true},
+                                                    {"progressive_call_results", true},
+                                                    {"progressive_call_invocations", true}}}};
+    QVariantMap roles{{"broker", broker}, {"dealer", dealer}};
     QVariantMap details{{"roles", roles}};
+    if(_format != _subprotocol) details[KEY_NATIVE_TIMESTAMPS] = true;
     QVariantList resArr{WampMsgCode::WELCOME, _sessionId, details};
     sendWampMessage(resArr);
     Q_EMIT q->welcomed();
@@ -340,6 +732,34 @@ User* WampRouterSession::user() const
     Q_D(const WampRouterSession);
     return d->_authSession->user.data();
 }
+// Decisions for interned URIs are cached as long as the atom lives, so the authorizer only
+// runs once per URI and action.
+bool WampRouterSessionPrivate::authorize(const QString& uri, UriAtom atom, WampMsgCode action, qulonglong requestId)
+{
+    if(atom == INVALID_URI_ATOM || !_authSession->user) return authorize(uri, action, requestId);
+    quint64 key = (quint64(atom) << 32) | quint32(action);
+    QHash<quint64, bool>::const_iterator it = _authorizations.constFind(key);
+    if(it == _authorizations.constEnd())
+    {
+        if(_authorizations.size() >= _authorizationSweep) sweepAuthorizations();
+        it = _authorizations.insert(key, _authSession->user->authorize(uri, action));
+    }
+    if(!it.value()) error(action, KEY_ERR_NOT_AUTHORIZED, requestId);
+    return it.value();
+}
+// Atoms are not recycled, so decisions for released atoms are never looked up again. They are
+// dropped each time the cache has doubled since the last sweep, which keeps it proportional to
+// the atoms still alive.
+void WampRouterSessionPrivate::sweepAuthorizations()
+{
+    QMutableHashIterator<quint64, bool> it(_authorizations);
+    while(it.hasNext())
+    {
+        it.next();
+        if(!_realm || _realm->d_ptr->_atoms.uri(UriAtom(it.key() >> 32)).isNull()) it.remove();
+    }
+    _authorizationSweep = qMax(AUTHORIZATION_SWEEP_MIN, 2 * _authorizations.size());
+}
 bool WampRouterSessionPrivate::authorize(QString uri, WampMsgCode action, qulonglong requestId)
 {
     if(_authSession->user)
@@ -361,8 +781,20 @@ QString WampRouterSession::peerAddress() const
 void WampRouterSessionPrivate::closed()
 {
     Q_Q(WampRouterSession);
-    for (auto reg: _registrations) {
-        _realm->d_ptr->removeRegistration(reg);
+    _outbound->close();
+    releasePublishers();
+    for (auto registrationId: _registrations) {
+        _realm->d_ptr->removeCallee(registrationId, q);
+    }
+    if(_realm)
+    {
+        _realm->d_ptr->takeCallerInvocations(q);
+        // callers of invocations this session never answered get an error instead of waiting forever
+        for (const PendingInvocation& invocation: _realm->d_ptr->takeCalleeInvocations(q)) {
+            QVariantList errArr{(int)WampMsgCode::ERROR, (int)WampMsgCode::CALL, invocation.callerRequestId,
+                                QVariantMap(), KEY_ERR_CANCELED};
+            invocation.caller->sendWampMessage(errArr);
+        }
     }
     for (auto sub: _subscriptions) {
         _realm->d_ptr->takeSubscription(sub->subscriptionId());
@@ -11,7 +11,7 @@ namespace QFlow{
 
 class Realm;
 class User;
-class WebSocketConnection;
+class WampTransport;
 
 class WampRouterSessionPrivate;
 class WampRouterSession : public QThread
@@ -20,14 +20,29 @@ class WampRouterSession : public QThread
     Q_PROPERTY(QString  authId READ authId)
     Q_PROPERTY(qulonglong sessionId READ sessionId)
     Q_PROPERTY(QString peerAddress READ peerAddress)
+    Q_PROPERTY(int outboundDepth READ outboundDepth)
+    Q_PROPERTY(qulonglong droppedMessages READ droppedMessages)
 public:
-    WampRouterSession(WebSocketConnection* socket, QString subprotocol, QObject* parent);
+    WampRouterSession(WampTransport* socket, QString subprotocol, QObject* parent);
     qulonglong sessionId() const;
     ~WampRouterSession();
     Realm* realm() const;
     void invoke(qulonglong requestId, QString uri);
     User* user() const;
-    void sendWampMessage(const QVariantList& arr);
+    // Thread-safe, messages go through the session's bounded outbound queue. An EVENT names its
+    // publisher, which stops being read while this queue is congested under BlockPublisher.
+    void sendWampMessage(const QVariantList& arr, WampRouterSession* publisher = NULL);
+    // droppable frames (EVENTs) are subject to the router's slow consumer policy
+    void sendFrame(const QByteArray& frame, bool droppable = false);
+    // A frame made of its own head and a payload tail shared with other frames, written without joining them
+    void sendFrame(const QByteArray& head, const QByteArray& payload, bool droppable,
+                   WampRouterSession* publisher = NULL);
+    int outboundDepth() const;
+    qulonglong droppedMessages() const;
+    QString subprotocol() const;
+    QString format() const;
+    // In-process sessions take messages unserialized, frames cannot be sent to them
+    bool carriesMessages() const;
     void result(qulonglong requestId, QVariant result);
     QString authId() const;
 public Q_SLOTS:
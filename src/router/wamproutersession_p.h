@@ -2,18 +2,38 @@
 #define WAMPROUTERSESSION_P_H
 
 #include "authenticator.h"
+#include "uriatomtable.h"
 #include <QObject>
 #include <QPointer>
+#include <QMutex>
+#include <QAtomicInt>
 
 namespace QFlow{
 
 class WampRouterWorker;
 class Realm;
-class WebSocketConnection;
+class WampTransport;
 class User;
 class WampMessageSerializer;
 class WampRouterRegistration;
+class OutboundQueue;
+class FrameBatcher;
+struct OutboundMessage;
 class WampRouterSubscription;
+class WampMessage;
+struct HelloMessage;
+struct AuthenticateMessage;
+struct RegisterMessage;
+struct UnregisterMessage;
+struct CallMessage;
+struct YieldMessage;
+struct ErrorMessage;
+struct CancelMessage;
+struct SubscribeMessage;
+struct UnsubscribeMessage;
+struct PublishMessage;
+struct WampPayload;
+typedef QSharedPointer<WampMessage> WampMessagePointer;
 typedef QSharedPointer<WampRouterRegistration> WampRouterRegistrationPointer;
 typedef QSharedPointer<WampRouterSubscription> WampRouterSubscriptionPointer;
 
@@ -25,22 +45,65 @@ public:
     ~WampRouterSessionPrivate();
     qulonglong _sessionId;
     QPointer<Realm> _realm;
-    QPointer<WebSocketConnection> _socket;
+    QPointer<WampTransport> _socket;
     QScopedPointer<WampMessageSerializer> _serializer;
-    QList<WampRouterRegistrationPointer> _registrations;
+    QList<qulonglong> _registrations;
     QList<WampRouterSubscriptionPointer> _subscriptions;
     WampRouterWorker* _router;
     QScopedPointer<AuthSession> _authSession;
     QString _authId;
+    QString _subprotocol;
+    QString _format;
+    QHash<quint64, bool> _authorizations;
+    // cache size at which decisions for released atoms are dropped next
+    int _authorizationSweep;
+    QScopedPointer<OutboundQueue> _outbound;
+    // waiting for the socket to drain below the low watermark
+    bool _outboundStalled;
+    FrameBatcher* _batcher;
+    // publishers held back while the outbound queue is congested
+    QMutex _heldMutex;
+    QList<QPointer<WampRouterSession>> _heldPublishers;
+    // congested sessions holding this one back, reads are paused while there are any
+    QAtomicInt _holds;
+    int pendingBytes() const;
+    void write(const QByteArray& frame, const QByteArray& payload = QByteArray());
+    void enqueue(const OutboundMessage& message, WampRouterSession* publisher = NULL);
+    void holdPublisher(WampRouterSession* publisher);
+    void releasePublishers();
+    void hold();
+    void release();
+    void dispatch(const WampMessagePointer& msg);
+    void handleHello(const HelloMessage& msg);
+    void handleAuthenticate(const AuthenticateMessage& msg);
+    void handleRegister(const RegisterMessage& msg);
+    void handleUnregister(const UnregisterMessage& msg);
+    void handleCall(const CallMessage& msg);
+    void handleYield(const YieldMessage& msg);
+    void handleError(const ErrorMessage& msg);
+    void handleCancel(const CancelMessage& msg);
+    void handleSubscribe(const SubscribeMessage& msg);
+    void handleUnsubscribe(const UnsubscribeMessage& msg);
+    void handlePublish(const PublishMessage& msg);
+    bool authorize(const QString& uri, UriAtom atom, WampMsgCode action, qulonglong requestId);
+    void sweepAuthorizations();
+    void forward(WampRouterSession* target, QVariantList head, const WampPayload& payload,
+                 const QVariantList& args, const QVariantMap& kwargs);
 public Q_SLOTS:
     void sendWampMessage(const QVariantList& arr);
+    void sendFrame(const QByteArray& frame, const QByteArray& payload = QByteArray());
     void onMessageReceived(const QByteArray &message);
+    void onWampMessageReceived(const QVariantList& message);
     void abort(QString uri, QString message = QString());
     void welcome();
     bool authorize(QString uri, WampMsgCode action, qulonglong requestId);
     void error(WampMsgCode code, QString uri, qulonglong requestId, QVariantMap details = QVariantMap());
     void result(qulonglong requestId, QVariant result = QVariant());
     void closed();
+    void drainOutbound();
+    void onBytesWritten();
+    void disconnectSlowConsumer();
+    void updateReading();
 private:
     WampRouterSession* q_ptr;
     Q_DECLARE_PUBLIC(WampRouterSession)
@@ -9,11 +9,17 @@
 #include "credentialstore.h"
 #include "wampinvocation.h"
 #include "wampmessageserializer.h"
+#include "sessionthreadpool.h"
+#include "rawsocketserver.h"
+#include "inprocserver.h"
+#include "shmserver.h"
+#include "websockettransport.h"
+#include "wamptransport.h"
 #include <QHostAddress>
 
 namespace QFlow{
 
-WampRouterWorker::WampRouterWorker(QObject *parent) : QObject(parent)
+WampRouterWorker::WampRouterWorker(QObject *parent) : QObject(parent), _deadlineTimer(NULL)
 {
 }
 
@@ -26,12 +32,74 @@ void WampRouterWorker::startServer()
     for(Realm* realm: _realms) {
         realm->setParent(this);
     }
+    if(_router->_threadPoolSize > 0)
+    {
+        _threadPool.reset(new SessionThreadPool(_router->_threadPoolSize, _router->_sessionAssignment));
+    }
+    _deadlineTimer = new QTimer(this);
+    QObject::connect(_deadlineTimer, SIGNAL(timeout()), this, SLOT(expireInvocations()));
+    _deadlineTimer->start(INVOCATION_DEADLINE_RESOLUTION_MS);
     _server.reset(new WebSocketServer());
     _server->setHost(_router->_host);
     _server->setPort(_router->_port);
     QObject::connect(_server.data(), SIGNAL(newConnection(WebSocketConnection*)), this, SLOT(onNewConnection(WebSocketConnection*)));
     _server->init();
     qDebug() << QString("WampRouter started on port %1").arg(_router->_port);
+    if(_router->_rawSocketPort > 0)
+    {
+        QHostAddress address(_router->_host);
+        if(_router->_host == "localhost") address = QHostAddress::LocalHost;
+        else if(address.isNull()) address = QHostAddress::Any;
+        _rawSocketServer.reset(new RawSocketServer());
+        QObject::connect(_rawSocketServer.data(), &RawSocketServer::newConnection, this, &WampRouterWorker::onNewTransport);
+        if(_rawSocketServer->listen(address, quint16(_router->_rawSocketPort)))
+        {
+            qDebug() << QString("WampRouter RawSocket listener started on port %1").arg(_router->_rawSocketPort);
+        }
+        else
+        {
+            qWarning() << QString("WampRouter RawSocket listener failed: %1").arg(_rawSocketServer->errorString());
+        }
+    }
+    _inprocServer.reset(new InprocServer());
+    QObject::connect(_inprocServer.data(), &InprocServer::newConnection, this, &WampRouterWorker::onNewTransport);
+    for(Realm* realm: _realms)
+    {
+        if(!_inprocServer->listen(realm->name()))
+        {
+            qWarning() << QString("WampRouter: realm %1 is already served in process by another router").arg(realm->name());
+        }
+    }
+    if(!_router->_localSocketPath.isEmpty())
+    {
+        _localSocketServer.reset(new RawSocketServer());
+        QObject::connect(_localSocketServer.data(), &RawSocketServer::newConnection, this, &WampRouterWorker::onNewTransport);
+        if(_localSocketServer->listen(_router->_localSocketPath))
+        {
+            qDebug() << QString("WampRouter local socket listener started on %1").arg(_router->_localSocketPath);
+        }
+        else
+        {
+            qWarning() << QString("WampRouter local socket listener failed: %1").arg(_localSocketServer->errorString());
+        }
+    }
+    if(!_router->_sharedMemorySocketPath.isEmpty())
+    {
+#ifdef Q_OS_LINUX
+        _shmServer.reset(new ShmServer());
+        QObject::connect(_shmServer.data(), &ShmServer::newTransport, this, &WampRouterWorker::onNewTransport);
+        if(RawSocketServer::listenLocal(_shmServer.data(), _router->_sharedMemorySocketPath))
+        {
+            qDebug() << QString("WampRouter shared memory listener started on %1").arg(_router->_sharedMemorySocketPath);
+        }
+        else
+        {
+            qWarning() << QString("WampRouter shared memory listener failed: %1").arg(_shmServer->errorString());
+        }
+#else
+        qWarning() << "WampRouter: the shared memory transport needs Linux";
+#endif
+    }
 }
 
 void WampRouterWorker::onNewConnection(WebSocketConnection *con)
@@ -39,19 +107,42 @@ void WampRouterWorker::onNewConnection(WebSocketConnection *con)
     QStringList subprotocols = con->requestedSubprotocols();
     qDebug() << QString("Web Socket connection opened. Requested subprotocols: %1 Peer Address: %2").arg(subprotocols.join(",")).arg(con->peerAddress().toString());
     QString selectedSub;
+    QStringList supported = WampMessageSerializer::subprotocols();
+    int selectedRank = supported.size();
     for(QString sub: subprotocols)
     {
-        if(sub == KEY_WAMP_JSON_SUB) selectedSub = KEY_WAMP_JSON_SUB;
-        else if(sub == KEY_WAMP_MSGPACK_SUB)
+        int rank = supported.indexOf(sub);
+        if(rank >= 0 && rank < selectedRank)
         {
-            selectedSub = KEY_WAMP_MSGPACK_SUB;
-            break;
+            selectedRank = rank;
+            selectedSub = sub;
         }
     }
-    if(selectedSub.isEmpty()) con->accept(false);
+    if(selectedSub.isEmpty())
+    {
+        con->accept(false);
+        return;
+    }
     con->selectSubprotocol(selectedSub);
     con->accept(true);
-    WampRouterSessionPointer newSession(new WampRouterSession(con, selectedSub, this));
+    openSession(new WebSocketTransport(con), selectedSub);
+}
+void WampRouterWorker::onNewTransport(WampTransport *transport)
+{
+    PeerCredentials peer = transport->peerCredentials();
+    if(peer.valid)
+    {
+        qDebug() << QString("Connection opened. Subprotocol: %1 Peer pid: %2 uid: %3").arg(transport->subprotocol()).arg(peer.pid).arg(peer.uid);
+    }
+    else
+    {
+        qDebug() << QString("Connection opened. Subprotocol: %1 Peer Address: %2").arg(transport->subprotocol()).arg(transport->peerAddress().toString());
+    }
+    openSession(transport, transport->subprotocol());
+}
+void WampRouterWorker::openSession(WampTransport *transport, const QString &subprotocol)
+{
+    WampRouterSessionPointer newSession(new WampRouterSession(transport, subprotocol, this));
     QObject::connect(newSession.data(), SIGNAL(closed()), this, SLOT(sessionClosed()));
     QObject::connect(newSession.data(), SIGNAL(messageReceived(QVariantList)), _router, SLOT(messageReceived(QVariantList)));
     QObject::connect(newSession.data(), SIGNAL(messageSent(QVariantList)), _router, SLOT(messageSent(QVariantList)));
@@ -66,4 +157,12 @@ void WampRouterWorker::sessionClosed()
         _sessions.remove(session->sessionId());
     }
 }
+void WampRouterWorker::expireInvocations()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for(Realm* realm: _realms)
+    {
+        realm->d_ptr->expireInvocations(now);
+    }
+}
 }
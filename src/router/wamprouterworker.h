@@ -3,6 +3,7 @@
 
 #include "websocketserver.h"
 #include <QPointer>
+#include <QTimer>
 #include <QJsonObject>
 
 namespace QFlow{
@@ -13,7 +14,12 @@ class WampRouterSession;
 typedef QSharedPointer<WampRouterSession> WampRouterSessionPointer;
 class WampRouterPrivate;
 class WampMessageSerializer;
+class SessionThreadPool;
 class WebSocketConnection;
+class WampTransport;
+class RawSocketServer;
+class InprocServer;
+class ShmServer;
 typedef QSharedPointer<WampMessageSerializer> WampMessageSerializerPointer;
 
 class WampRouterWorker : public QObject
@@ -24,14 +30,24 @@ public:
     ~WampRouterWorker();
     WampRouterPrivate* _router;
     QScopedPointer<WebSocketServer> _server;
+    QScopedPointer<RawSocketServer> _rawSocketServer;
+    QScopedPointer<RawSocketServer> _localSocketServer;
+    QScopedPointer<InprocServer> _inprocServer;
+    QScopedPointer<ShmServer> _shmServer;
+    // Declared before _sessions so sessions are destroyed while their threads still run
+    QScopedPointer<SessionThreadPool> _threadPool;
     QHash<qulonglong, WampRouterSessionPointer> _sessions;
     QList<QFlow::Realm*> _realms;
+    QTimer* _deadlineTimer;
+    void openSession(WampTransport* transport, const QString& subprotocol);
 Q_SIGNALS:
 
 public Q_SLOTS:
     void startServer();
     void onNewConnection(WebSocketConnection* con);
+    void onNewTransport(WampTransport* transport);
     void sessionClosed();
+    void expireInvocations();
 };
 }
 #endif // WAMPROUTERWORKER_H
@@ -0,0 +1,583 @@
+#include "shmtransport.h"
+#include "rawsockettransport.h"
+#include "wampmessageserializer.h"
+#include <QLocalSocket>
+#include <QSocketNotifier>
+#include <QPointer>
+#include <QThread>
+#include <QtEndian>
+#include <QDebug>
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+#endif
+
+namespace QFlow{
+
+// In front of each ring. head and tail count the bytes written and read and wrap freely,
+// so the ring size has to be a power of two.
+struct ShmRingHeader
+{
+    QAtomicInteger<quint32> head;
+    char headPadding[60];
+    QAtomicInteger<quint32> tail;
+    // set by a producer that found the ring full, the consumer rings it once it freed space
+    QAtomicInteger<quint32> producerBlocked;
+    char tailPadding[56];
+};
+
+struct ShmMapping
+{
+    ShmMapping(uchar* mappedData, qint64 mappedSize) : data(mappedData), size(mappedSize)
+    {
+    }
+    ~ShmMapping()
+    {
+#ifdef Q_OS_LINUX
+        ::munmap(data, size_t(size));
+#endif
+    }
+    uchar* data;
+    qint64 size;
+};
+
+namespace {
+const char SHM_MAGIC[4] = {'W', 'S', 'H', 'M'};
+const char SHM_VERSION = 1;
+const int SHM_HANDSHAKE_SIZE = 12;
+const int SHM_ANSWER_SIZE = 4;
+const int SHM_HANDSHAKE_FDS = 3;
+const quint32 SHM_MIN_RING_SIZE = 64 * 1024;
+const quint32 SHM_MAX_RING_SIZE = 1024 * 1024 * 1024;
+// every record starts with its length, padded so the next one stays 8 byte aligned
+const int SHM_RECORD_HEADER_SIZE = 8;
+// record length that sends the consumer back to the start of the ring
+const quint32 SHM_WRAP = 0xFFFFFFFF;
+enum ShmStatus {
+    SHM_ACCEPTED = 0,
+    SHM_ERR_SERIALIZER_UNSUPPORTED = 1,
+    SHM_ERR_SEGMENT = 2,
+    SHM_ERR_REQUEST = 3
+};
+
+quint32 recordSize(quint32 length)
+{
+    return (quint32(SHM_RECORD_HEADER_SIZE) + length + 7) & ~quint32(7);
+}
+quint32 ringSizeFor(int requested)
+{
+    quint32 size = SHM_MIN_RING_SIZE;
+    while(size < quint32(requested) && size < SHM_MAX_RING_SIZE) size <<= 1;
+    return size;
+}
+qint64 segmentSize(quint32 ringSize)
+{
+    return 2 * (qint64(sizeof(ShmRingHeader)) + ringSize);
+}
+
+#ifdef Q_OS_LINUX
+// A segment the client could still shrink would fault the router on its next ring access
+const int SHM_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+void closeDescriptor(int& fd)
+{
+    if(fd >= 0) ::close(fd);
+    fd = -1;
+}
+// memfd (Linux 3.17), sealed at its size so the router can rely on it
+int createSegment(qint64 size)
+{
+#ifdef SYS_memfd_create
+    int fd = int(::syscall(SYS_memfd_create, "wamp-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if(fd < 0) return -1;
+    if(::ftruncate(fd, off_t(size)) != 0 || ::fcntl(fd, F_ADD_SEALS, SHM_SEALS) != 0)
+    {
+        closeDescriptor(fd);
+    }
+    return fd;
+#else
+    Q_UNUSED(size);
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+#endif
+}
+
+ShmTransport::ShmTransport(const QString &path, const QStringList &subprotocols, int ringSize, QObject *parent) :
+    WampTransport(parent), _state(Connecting), _server(false), _readingPaused(false), _path(path), _ringSize(ringSizeFor(ringSize)),
+    _socket(NULL), _notifier(NULL), _segment(-1), _doorbell(-1), _peerDoorbell(-1), _out(NULL), _outData(NULL),
+    _in(NULL), _inData(NULL), _outHead(0), _inTail(0), _pending(0)
+{
+    qRegisterMetaType<QList<FrameBatcher::Frame>>("QList<QFlow::FrameBatcher::Frame>");
+    for(const QString& subprotocol: subprotocols)
+    {
+        if(RawSocketTransport::serializerId(subprotocol))
+        {
+            _subprotocol = subprotocol;
+            break;
+        }
+    }
+}
+ShmTransport::ShmTransport(int socketDescriptor, int segment, int doorbell, int peerDoorbell, quint32 ringSize,
+                           const QString &subprotocol, const PeerCredentials &peer) : WampTransport(NULL),
+    _state(Handshake), _server(true), _readingPaused(false), _subprotocol(subprotocol), _ringSize(ringSize), _peerCredentials(peer),
+    _socket(new QLocalSocket(this)), _notifier(NULL), _segment(segment), _doorbell(doorbell), _peerDoorbell(peerDoorbell),
+    _out(NULL), _outData(NULL), _in(NULL), _inData(NULL), _outHead(0), _inTail(0), _pending(0)
+{
+    qRegisterMetaType<QList<FrameBatcher::Frame>>("QList<QFlow::FrameBatcher::Frame>");
+    _socket->setSocketDescriptor(socketDescriptor);
+    QObject::connect(_socket, &QLocalSocket::disconnected, this, &ShmTransport::close);
+}
+ShmTransport::~ShmTransport()
+{
+    release();
+}
+// The client creates the segment and both eventfds, they go to the router with the handshake
+void ShmTransport::open()
+{
+    if(_server || _state != Connecting || _socket) return;
+#ifdef Q_OS_LINUX
+    if(_subprotocol.isEmpty())
+    {
+        qWarning() << "Shm: no serializer to offer";
+        QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+        return;
+    }
+    _segment = createSegment(segmentSize(_ringSize));
+    _doorbell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    _peerDoorbell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_segment < 0 || _doorbell < 0 || _peerDoorbell < 0 || !map(_segment))
+    {
+        qWarning() << QString("Shm: cannot set up a %1 byte segment: %2").arg(segmentSize(_ringSize)).arg(::strerror(errno));
+        QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+        return;
+    }
+    _socket = new QLocalSocket(this);
+    QObject::connect(_socket, &QLocalSocket::connected, this, &ShmTransport::onConnected);
+    QObject::connect(_socket, &QLocalSocket::disconnected, this, &ShmTransport::close);
+    QObject::connect(_socket, &QLocalSocket::readyRead, this, &ShmTransport::onReadyRead);
+    QObject::connect(_socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(close()));
+    _socket->connectToServer(_path);
+#else
+    qWarning() << "Shm: the shared memory transport needs Linux";
+    QMetaObject::invokeMethod(this, "close", Qt::QueuedConnection);
+#endif
+}
+void ShmTransport::onConnected()
+{
+#ifdef Q_OS_LINUX
+    if(_server || _state != Connecting) return;
+    char handshake[SHM_HANDSHAKE_SIZE] = {SHM_MAGIC[0], SHM_MAGIC[1], SHM_MAGIC[2], SHM_MAGIC[3], SHM_VERSION,
+                                          char(RawSocketTransport::serializerId(_subprotocol)), 0, 0};
+    qToLittleEndian<quint32>(_ringSize, reinterpret_cast<uchar*>(handshake + 8));
+    // the router's doorbell is the one the client rings
+    int fds[SHM_HANDSHAKE_FDS] = {_segment, _peerDoorbell, _doorbell};
+    char control[CMSG_SPACE(sizeof(fds))];
+    ::memset(control, 0, sizeof(control));
+    struct iovec iov = {handshake, sizeof(handshake)};
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    ::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if(::sendmsg(int(_socket->socketDescriptor()), &msg, MSG_NOSIGNAL) != SHM_HANDSHAKE_SIZE)
+    {
+        qWarning() << QString("Shm: sending the handshake failed: %1").arg(::strerror(errno));
+        close();
+        return;
+    }
+    // the mapping stays valid without it
+    closeDescriptor(_segment);
+    _state = Handshake;
+#endif
+}
+// Client: the router's answer to the handshake, nothing else travels over the socket
+void ShmTransport::onReadyRead()
+{
+    if(_server || _state != Handshake || _socket->bytesAvailable() < SHM_ANSWER_SIZE) return;
+    QByteArray answer = _socket->read(SHM_ANSWER_SIZE);
+    if(answer[0] != SHM_MAGIC[0] || answer[1] != SHM_MAGIC[1] || answer[2] != char(SHM_ACCEPTED))
+    {
+        qWarning() << QString("Shm: handshake rejected with error %1").arg(int(answer[2]));
+        close();
+        return;
+    }
+    start();
+    Q_EMIT opened();
+    if(_state == Open) onDoorbell();
+}
+ShmTransport* ShmTransport::accept(int socketDescriptor, bool *retry)
+{
+    *retry = false;
+#ifdef Q_OS_LINUX
+    uchar handshake[SHM_HANDSHAKE_SIZE];
+    int fds[SHM_HANDSHAKE_FDS] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {handshake, sizeof(handshake)};
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t received = ::recvmsg(socketDescriptor, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        *retry = true;
+        return NULL;
+    }
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = qMin<size_t>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), SHM_HANDSHAKE_FDS);
+        ::memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+    }
+    auto reject = [&](int status) -> ShmTransport* {
+        char answer[SHM_ANSWER_SIZE] = {SHM_MAGIC[0], SHM_MAGIC[1], char(status), 0};
+        ::send(socketDescriptor, answer, sizeof(answer), MSG_NOSIGNAL);
+        for(int& fd: fds) closeDescriptor(fd);
+        ::close(socketDescriptor);
+        return NULL;
+    };
+    if(received != SHM_HANDSHAKE_SIZE || ::memcmp(handshake, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 ||
+       handshake[4] != uchar(SHM_VERSION) || fds[0] < 0 || fds[1] < 0 || fds[2] < 0)
+    {
+        qWarning() << "Shm: invalid handshake";
+        return reject(SHM_ERR_REQUEST);
+    }
+    QString subprotocol = RawSocketTransport::serializerSubprotocol(handshake[5]);
+    if(subprotocol.isEmpty() || !WampMessageSerializer::subprotocols().contains(subprotocol))
+    {
+        return reject(SHM_ERR_SERIALIZER_UNSUPPORTED);
+    }
+    quint32 ringSize = qFromLittleEndian<quint32>(handshake + 8);
+    struct stat segmentStat;
+    if(ringSize < SHM_MIN_RING_SIZE || ringSize > SHM_MAX_RING_SIZE || (ringSize & (ringSize - 1)) ||
+       ::fstat(fds[0], &segmentStat) != 0 || segmentStat.st_size < segmentSize(ringSize))
+    {
+        qWarning() << "Shm: segment does not match the requested ring size";
+        return reject(SHM_ERR_SEGMENT);
+    }
+    int seals = ::fcntl(fds[0], F_GET_SEALS);
+    if(seals < 0 || (seals & SHM_SEALS) != SHM_SEALS)
+    {
+        qWarning() << "Shm: segment is not sealed against resizing";
+        return reject(SHM_ERR_SEGMENT);
+    }
+    PeerCredentials peer;
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if(::getsockopt(socketDescriptor, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0)
+    {
+        peer.valid = true;
+        peer.pid = credentials.pid;
+        peer.uid = credentials.uid;
+        peer.gid = credentials.gid;
+    }
+    ShmTransport* transport = new ShmTransport(socketDescriptor, fds[0], fds[1], fds[2], ringSize, subprotocol, peer);
+    bool mapped = transport->map(transport->_segment);
+    closeDescriptor(transport->_segment);
+    char answer[SHM_ANSWER_SIZE] = {SHM_MAGIC[0], SHM_MAGIC[1], char(mapped ? SHM_ACCEPTED : SHM_ERR_SEGMENT), handshake[5]};
+    if(!mapped || ::send(socketDescriptor, answer, sizeof(answer), MSG_NOSIGNAL) != SHM_ANSWER_SIZE)
+    {
+        delete transport;
+        return NULL;
+    }
+    transport->start();
+    // a client only sends once answered, a stale doorbell is harmless
+    QMetaObject::invokeMethod(transport, "onDoorbell", Qt::QueuedConnection);
+    return transport;
+#else
+    Q_UNUSED(socketDescriptor);
+    return NULL;
+#endif
+}
+bool ShmTransport::map(int segment)
+{
+#ifdef Q_OS_LINUX
+    qint64 size = segmentSize(_ringSize);
+    void* data = ::mmap(NULL, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+    if(data == MAP_FAILED) return false;
+    _mapping.reset(new ShmMapping(static_cast<uchar*>(data), size));
+    // the client writes the first ring, the router the second
+    uchar* first = _mapping->data;
+    uchar* second = first + sizeof(ShmRingHeader) + _ringSize;
+    _out = reinterpret_cast<ShmRingHeader*>(_server ? second : first);
+    _in = reinterpret_cast<ShmRingHeader*>(_server ? first : second);
+    _outData = reinterpret_cast<uchar*>(_out) + sizeof(ShmRingHeader);
+    _inData = reinterpret_cast<uchar*>(_in) + sizeof(ShmRingHeader);
+    // cursors are read from the header once, from then on we only store ours
+    _outHead = _out->head.load();
+    _inTail = _in->tail.load();
+    return true;
+#else
+    Q_UNUSED(segment);
+    return false;
+#endif
+}
+void ShmTransport::start()
+{
+    _state = Open;
+    _notifier = new QSocketNotifier(_doorbell, QSocketNotifier::Read, this);
+    QObject::connect(_notifier, SIGNAL(activated(int)), this, SLOT(onDoorbell()));
+}
+void ShmTransport::onDoorbell()
+{
+    if(_state != Open) return;
+#ifdef Q_OS_LINUX
+    quint64 count;
+    while(::read(_doorbell, &count, sizeof(count)) == sizeof(count)) {}
+#endif
+    drain();
+    if(_state == Open) flushBacklog();
+}
+void ShmTransport::ring()
+{
+#ifdef Q_OS_LINUX
+    quint64 one = 1;
+    if(::write(_peerDoorbell, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        qWarning() << QString("Shm: ringing the peer failed: %1").arg(::strerror(errno));
+    }
+#endif
+}
+// The client reads messages where they lie, their space is only freed once the slot returned.
+// The router copies each one out first: the client can still write to the ring, and the
+// serializers check a frame against the decode limits before parsing it again.
+// head and tail are stored with full barriers: a consumer that went idle after its last tail store
+// is seen by the producer comparing the tail after its own head store, and rung.
+// The peer can write the whole segment, so our own cursor is kept in _inTail and only stored to
+// the header, and every record is checked against the ring before it is touched.
+void ShmTransport::drain()
+{
+    QPointer<ShmTransport> guard(this);
+    QSharedPointer<ShmMapping> mapping = _mapping;
+    while(_state == Open && !_readingPaused)
+    {
+        quint32 tail = _inTail;
+        quint32 head = _in->head.loadAcquire();
+        if(head == tail) break;
+        if(head - tail > _ringSize)
+        {
+            qWarning() << "Shm: corrupt ring";
+            close();
+            return;
+        }
+        while(tail != head)
+        {
+            quint32 offset = tail & (_ringSize - 1);
+            quint32 length;
+            ::memcpy(&length, _inData + offset, sizeof(length));
+            if(length == SHM_WRAP)
+            {
+                if(_ringSize - offset > head - tail)
+                {
+                    qWarning() << "Shm: invalid record";
+                    close();
+                    return;
+                }
+                tail += _ringSize - offset;
+                continue;
+            }
+            if(length > _ringSize / 2 || quint64(offset) + SHM_RECORD_HEADER_SIZE + length > _ringSize ||
+                    recordSize(length) > head - tail)
+            {
+                qWarning() << "Shm: invalid record";
+                close();
+                return;
+            }
+            const char* record = reinterpret_cast<const char*>(_inData + offset + SHM_RECORD_HEADER_SIZE);
+            if(_server)
+            {
+                _received.resize(int(length));
+                ::memcpy(_received.data(), record, length);
+                Q_EMIT messageReceived(_received);
+            }
+            else
+            {
+                Q_EMIT messageReceived(QByteArray::fromRawData(record, int(length)));
+            }
+            if(!guard || _state != Open) return;
+            tail += recordSize(length);
+            _inTail = tail;
+            _in->tail.fetchAndStoreOrdered(tail);
+            if(_readingPaused) break;
+        }
+        if(_in->producerBlocked.loadAcquire() && _in->producerBlocked.fetchAndStoreOrdered(0)) ring();
+    }
+}
+bool ShmTransport::writeRecord(const FrameBatcher::Frame &frame)
+{
+    quint32 size = recordSize(quint32(frame.size()));
+    quint32 head = _outHead;
+    quint32 tail = _out->tail.loadAcquire();
+    quint32 offset = head & (_ringSize - 1);
+    quint32 contiguous = _ringSize - offset;
+    // records never wrap, so they can be read in place
+    quint32 skip = contiguous < size ? contiguous : 0;
+    if(_ringSize - (head - tail) < skip + size) return false;
+    if(skip)
+    {
+        ::memcpy(_outData + offset, &SHM_WRAP, sizeof(SHM_WRAP));
+        head += skip;
+        offset = 0;
+    }
+    quint32 length = quint32(frame.size());
+    ::memcpy(_outData + offset, &length, sizeof(length));
+    // the payload shared between frames is gathered into the record right behind the data
+    ::memcpy(_outData + offset + SHM_RECORD_HEADER_SIZE, frame.data.constData(), size_t(frame.data.size()));
+    ::memcpy(_outData + offset + SHM_RECORD_HEADER_SIZE + frame.data.size(), frame.payload.constData(),
+             size_t(frame.payload.size()));
+    _outHead = head + size;
+    _out->head.fetchAndStoreOrdered(_outHead);
+    return true;
+}
+void ShmTransport::flushBacklog()
+{
+    if(_backlog.isEmpty()) return;
+    quint32 start = _outHead;
+    qint64 bytes = 0;
+    while(!_backlog.isEmpty())
+    {
+        if(!writeRecord(_backlog.first()))
+        {
+            // checked again after raising the flag, the consumer may have freed space in between
+            _out->producerBlocked.fetchAndStoreOrdered(1);
+            if(!writeRecord(_backlog.first())) break;
+        }
+        bytes += _backlog.takeFirst().size();
+    }
+    published(start, bytes);
+}
+void ShmTransport::published(quint32 start, qint64 bytes)
+{
+    if(bytes == 0) return;
+    _pending.fetchAndAddRelaxed(-bytes);
+    if(_out->tail.loadAcquire() == start) ring();
+    Q_EMIT bytesWritten(bytes);
+}
+void ShmTransport::send(const QByteArray &message, bool binary)
+{
+    FrameBatcher::Frame frame = {message, QByteArray(), binary};
+    enqueue({frame});
+}
+void ShmTransport::sendBatch(const QList<FrameBatcher::Frame> &frames)
+{
+    enqueue(frames);
+}
+bool ShmTransport::writesBatches() const
+{
+    return true;
+}
+// Only the transport's thread produces into the ring
+void ShmTransport::enqueue(const QList<FrameBatcher::Frame> &frames)
+{
+    if(frames.isEmpty()) return;
+    qint64 bytes = 0;
+    for(const FrameBatcher::Frame& frame: frames) bytes += frame.size();
+    _pending.fetchAndAddRelaxed(bytes);
+    if(QThread::currentThread() == thread()) write(frames);
+    else QMetaObject::invokeMethod(this, "write", Qt::QueuedConnection, Q_ARG(QList<QFlow::FrameBatcher::Frame>, frames));
+}
+void ShmTransport::write(const QList<FrameBatcher::Frame> &frames)
+{
+    if(_state == Closed) return;
+    quint32 maxSize = _ringSize / 2 - SHM_RECORD_HEADER_SIZE;
+    quint32 start = _state == Open ? _outHead : 0;
+    qint64 bytes = 0;
+    for(const FrameBatcher::Frame& frame: frames)
+    {
+        if(quint32(frame.size()) > maxSize)
+        {
+            // dropping it would leave the peer waiting for an answer that never comes
+            qWarning() << QString("Shm: message of %1 bytes exceeds half the ring, closing").arg(frame.size());
+            close();
+            return;
+        }
+        if(_state == Open && _backlog.isEmpty() && writeRecord(frame))
+        {
+            bytes += frame.size();
+            continue;
+        }
+        // kept beyond this call, and a message echoed from messageReceived() lies in our own ring
+        FrameBatcher::Frame copy = {QByteArray(frame.data.constData(), frame.data.size()),
+                                    QByteArray(frame.payload.constData(), frame.payload.size()), frame.binary};
+        _backlog.append(copy);
+    }
+    if(_state != Open) return;
+    published(start, bytes);
+    flushBacklog();
+}
+qint64 ShmTransport::bytesToWrite() const
+{
+    return qMax<qint64>(0, _pending.load());
+}
+QString ShmTransport::subprotocol() const
+{
+    return _subprotocol;
+}
+QHostAddress ShmTransport::peerAddress() const
+{
+    return QHostAddress(QHostAddress::LocalHost);
+}
+PeerCredentials ShmTransport::peerCredentials() const
+{
+    return _peerCredentials;
+}
+void ShmTransport::setReadingPaused(bool paused)
+{
+    _readingPaused = paused;
+    // records that arrived meanwhile do not ring again
+    if(!paused) QMetaObject::invokeMethod(this, "onDoorbell", Qt::QueuedConnection);
+}
+void ShmTransport::release()
+{
+    delete _notifier;
+    _notifier = NULL;
+    _mapping.reset();
+    _out = _in = NULL;
+    _outData = _inData = NULL;
+#ifdef Q_OS_LINUX
+    closeDescriptor(_segment);
+    closeDescriptor(_doorbell);
+    closeDescriptor(_peerDoorbell);
+#endif
+    _backlog.clear();
+    _pending.store(0);
+}
+void ShmTransport::close()
+{
+    if(_state == Closed) return;
+    _state = Closed;
+    release();
+    if(_socket) _socket->abort();
+    Q_EMIT closed();
+}
+}
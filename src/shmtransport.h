@@ -0,0 +1,104 @@
+#ifndef SHMTRANSPORT_H
+#define SHMTRANSPORT_H
+
+#include "wamptransport.h"
+#include <QAtomicInteger>
+#include <QSharedPointer>
+#include <QStringList>
+
+class QLocalSocket;
+class QSocketNotifier;
+
+namespace QFlow{
+
+// Bytes per direction used by shm:// URLs without a ring query. A message may take at most half,
+// sending a larger one closes the transport.
+const int DEFAULT_SHM_RING_SIZE = 64 * 1024 * 1024;
+
+struct ShmRingHeader;
+struct ShmMapping;
+
+// Linux only. Messages travel through a single producer, single consumer ring per direction in a
+// memfd segment created by the client, and each side has an eventfd the other rings once new
+// messages or free space are waiting. The client passes the segment and the eventfds to the router
+// over a Unix domain socket, which afterwards only serves to notice the peer going away.
+// The client reads received messages in place from the ring. The router copies them out before
+// decoding, as the client can still write to its ring. Segments must be sealed against resizing.
+class ShmTransport : public WampTransport
+{
+    Q_OBJECT
+public:
+    // Client side, connects to the router's shared memory socket at path and asks for the first
+    // subprotocol RawSocket has a serializer id for. ringSize is rounded up to a power of two.
+    ShmTransport(const QString& path, const QStringList& subprotocols, int ringSize = DEFAULT_SHM_RING_SIZE,
+                 QObject* parent = NULL);
+    ~ShmTransport();
+    void send(const QByteArray& message, bool binary) override;
+    // Rings the peer once for the whole batch
+    void sendBatch(const QList<FrameBatcher::Frame>& frames) override;
+    bool writesBatches() const override;
+    qint64 bytesToWrite() const override;
+    QString subprotocol() const override;
+    QHostAddress peerAddress() const override;
+    PeerCredentials peerCredentials() const override;
+    // Leaves records in the ring, the client backs off once it is full
+    void setReadingPaused(bool paused) override;
+    // Server side: reads the client's handshake from a connected Unix domain socket and answers it.
+    // Returns NULL on failure, with *retry set if the handshake did not arrive yet.
+    // On success the transport owns socketDescriptor and is open.
+    static ShmTransport* accept(int socketDescriptor, bool* retry);
+public Q_SLOTS:
+    void open() override;
+    void close() override;
+private Q_SLOTS:
+    void onConnected();
+    void onReadyRead();
+    void onDoorbell();
+    void write(const QList<QFlow::FrameBatcher::Frame>& frames);
+private:
+    enum State {
+        Connecting,
+        Handshake,
+        Open,
+        Closed
+    };
+    // Server side, see accept()
+    ShmTransport(int socketDescriptor, int segment, int doorbell, int peerDoorbell, quint32 ringSize,
+                 const QString& subprotocol, const PeerCredentials& peer);
+    bool map(int segment);
+    void start();
+    bool writeRecord(const FrameBatcher::Frame& frame);
+    void flushBacklog();
+    void published(quint32 start, qint64 bytes);
+    void drain();
+    void ring();
+    void enqueue(const QList<FrameBatcher::Frame>& frames);
+    void release();
+    State _state;
+    bool _server;
+    bool _readingPaused;
+    QString _path;
+    QString _subprotocol;
+    quint32 _ringSize;
+    PeerCredentials _peerCredentials;
+    QLocalSocket* _socket;
+    QSocketNotifier* _notifier;
+    int _segment;
+    int _doorbell;
+    int _peerDoorbell;
+    // drain() holds a reference while a message is emitted, so a receiver closing us keeps it readable
+    QSharedPointer<ShmMapping> _mapping;
+    ShmRingHeader* _out;
+    uchar* _outData;
+    ShmRingHeader* _in;
+    uchar* _inData;
+    // our producer and consumer cursors, the copies in the shared headers are never read back
+    quint32 _outHead;
+    quint32 _inTail;
+    QList<FrameBatcher::Frame> _backlog;
+    // router side copy of the message being handled
+    QByteArray _received;
+    QAtomicInteger<qint64> _pending;
+};
+}
+#endif // SHMTRANSPORT_H
@@ -22,8 +22,40 @@ const QString KEY_ERR_NO_SUCH_PROCEDURE = QStringLiteral("wamp.error.no_such_pro
 const QString KEY_ERR_NO_SUCH_REGISTRATION = QStringLiteral("wamp.error.no_such_registration");
 const QString KEY_ERR_NO_SUCH_SUBSCRIPTION = QStringLiteral("wamp.error.no_such_subscription");
 const QString KEY_ERR_NO_SUCH_REALM = QStringLiteral("wamp.error.no_such_realm");
+const QString KEY_ERR_PROCEDURE_ALREADY_EXISTS = QStringLiteral("wamp.error.procedure_already_exists");
+const QString KEY_ERR_TIMEOUT = QStringLiteral("wamp.error.timeout");
+const QString KEY_ERR_CANCELED = QStringLiteral("wamp.error.canceled");
+const QString KEY_ERR_INVALID_ARGUMENT = QStringLiteral("wamp.error.invalid_argument");
+const QString KEY_ERR_PROTOCOL_VIOLATION = QStringLiteral("wamp.error.protocol_violation");
+const QString KEY_ERR_SLOW_CONSUMER = QStringLiteral("wamp.error.slow_consumer");
 const QString KEY_WAMP_JSON_SUB = QStringLiteral("wamp.2.json");
 const QString KEY_WAMP_MSGPACK_SUB = QStringLiteral("wamp.2.msgpack");
+const QString KEY_WAMP_CBOR_SUB = QStringLiteral("wamp.2.cbor");
+const QString KEY_RAWSOCKET_SCHEME = QStringLiteral("rawsocket");
+const QString KEY_UNIX_SCHEME = QStringLiteral("unix");
+const QString KEY_INPROC_SCHEME = QStringLiteral("inproc");
+const QString KEY_SHM_SCHEME = QStringLiteral("shm");
+// Not negotiated on any wire, names the unserialized in-process transport
+const QString KEY_WAMP_INPROC_SUB = QStringLiteral("wamp.2.inproc");
+const QString KEY_NATIVE_TIMESTAMPS = QStringLiteral("x_native_timestamps");
+const QString KEY_INVOKE = QStringLiteral("invoke");
+const QString KEY_INVOKE_SINGLE = QStringLiteral("single");
+const QString KEY_INVOKE_FIRST = QStringLiteral("first");
+const QString KEY_INVOKE_LAST = QStringLiteral("last");
+const QString KEY_INVOKE_ROUNDROBIN = QStringLiteral("roundrobin");
+const QString KEY_INVOKE_RANDOM = QStringLiteral("random");
+const QString KEY_INVOKE_LEAST_OUTSTANDING = QStringLiteral("x_least_outstanding");
+const QString KEY_CALL_TIMEOUT = QStringLiteral("timeout");
+const QString KEY_RECEIVE_PROGRESS = QStringLiteral("receive_progress");
+const QString KEY_PROGRESS = QStringLiteral("progress");
+const QString KEY_CANCEL_MODE = QStringLiteral("mode");
+const QString KEY_CANCEL_SKIP = QStringLiteral("skip");
+const QString KEY_CANCEL_KILL = QStringLiteral("kill");
+const QString KEY_CANCEL_KILLNOWAIT = QStringLiteral("killnowait");
+const QString KEY_MATCH = QStringLiteral("match");
+const QString KEY_MATCH_EXACT = QStringLiteral("exact");
+const QString KEY_MATCH_PREFIX = QStringLiteral("prefix");
+const QString KEY_MATCH_WILDCARD = QStringLiteral("wildcard");
 
 enum WampMsgCode : int {
     HELLO = 1,
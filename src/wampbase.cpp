@@ -91,11 +91,21 @@ void WampBase::registerSignal(QString uri, QObject *obj, QString signalSignature
     addSignalObserver(uri, observer);
 }
 
+void WampBase::batchRegistrations(const std::function<void()>& registrations)
+{
+    registrations();
+}
 void WampBase::registerObject(QString uri, QObject *obj)
 {
     const WampAttached *const attached = qobject_cast<WampAttached*>(
                 qmlAttachedPropertiesObject<WampBase>(obj, false));
     if(attached && !attached->isRemote()) return;
+    batchRegistrations([&]() {
+        registerMembers(uri, obj);
+    });
+}
+void WampBase::registerMembers(QString uri, QObject *obj)
+{
     const QMetaObject* meta = obj->metaObject();
     for(int i=0;i<meta->methodCount();i++)
     {
@@ -5,6 +5,7 @@
 #include "functor.h"
 #include "registration_p.h"
 #include "wampattached.h"
+#include "wamp_symbols.h"
 #include <QQmlListReference>
 #include <QJSValue>
 #include <qqml.h>
@@ -36,6 +37,20 @@ public:
         RegistrationPointer reg(new Registration(uri, impl));
         addRegistration(reg);
     }
+    // callback may emit chunks through its ProgressCallback before returning the final result
+    void registerProgressiveProcedure(QString uri, ProgressiveCallback callback)
+    {
+        Impl* impl = new ProgressiveImpl(callback);
+        RegistrationPointer reg(new Registration(uri, impl));
+        addRegistration(reg);
+    }
+    // match is prefix or wildcard, callback receives the procedure each call was made to
+    void registerPattern(QString uri, QString match, PatternCallback callback)
+    {
+        Impl* impl = new PatternImpl(callback);
+        RegistrationPointer reg(new Registration(uri, impl, QVariantMap{{KEY_MATCH, match}}));
+        addRegistration(reg);
+    }
     static WampAttached *qmlAttachedProperties(QObject *obj);
     static QVariant deserializeMessage(const QString& message);
     static QString serializeMessage(const QVariant& var);
@@ -49,6 +64,10 @@ public Q_SLOTS:
 protected:
     virtual void addRegistration(RegistrationPointer reg) = 0;
     virtual void addSignalObserver(QString uri, SignalObserverPointer observer) = 0;
+    // Runs the registrations of one object, implementations may publish them together
+    virtual void batchRegistrations(const std::function<void()>& registrations);
+private:
+    void registerMembers(QString uri, QObject* obj);
 };
 }
 //QML_DECLARE_TYPE( QFlow::WampBase )
@@ -2,6 +2,7 @@
 #define WAMPINVOCATION
 
 #include <QJsonArray>
+#include <QAtomicInt>
 #include <QSharedPointer>
 
 namespace QFlow{
@@ -13,9 +14,17 @@ class WampInvocation : public QObject
 {
 public:
     RegistrationPointer registration;
+    // procedure called, the registration's URI unless it is pattern-based
+    QString procedure;
     QVariantList args;
     qulonglong requestId;
-    WampInvocation() : registration(NULL)
+    bool receiveProgress;
+    // a progressive call whose last chunk has not arrived yet, more INVOCATIONs with this
+    // request id follow; guarded by the connection's invocation mutex
+    bool progress;
+    // set by INTERRUPT, the invocation then answers with wamp.error.canceled
+    QAtomicInt interrupted;
+    WampInvocation() : registration(NULL), requestId(0), receiveProgress(false), progress(false)
     {
 
     }
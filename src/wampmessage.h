@@ -0,0 +1,215 @@
+#ifndef WAMPMESSAGE_H
+#define WAMPMESSAGE_H
+
+#include "wamp_symbols.h"
+#include <QVariant>
+#include <QSharedPointer>
+
+namespace QFlow{
+
+// Consecutive message elements already encoded in the wire format of one serializer.
+// A payload is spliced behind per-recipient header elements without being encoded again.
+struct WampPayload
+{
+    WampPayload() : count(0)
+    {
+    }
+    QString format;
+    QByteArray data;
+    int count;
+};
+
+// Typed view of one decoded WAMP message. Serializers build the concrete
+// message type straight from the wire, so header fields (ids, URIs) never
+// go through QVariant.
+class WampMessage
+{
+public:
+    explicit WampMessage(WampMsgCode messageCode) : code(messageCode)
+    {
+    }
+    virtual ~WampMessage()
+    {
+    }
+    const WampMsgCode code;
+};
+typedef QSharedPointer<WampMessage> WampMessagePointer;
+
+struct HelloMessage : public WampMessage
+{
+    HelloMessage() : WampMessage(WampMsgCode::HELLO) {}
+    QString realm;
+    QVariantMap details;
+};
+struct WelcomeMessage : public WampMessage
+{
+    WelcomeMessage() : WampMessage(WampMsgCode::WELCOME), sessionId(0) {}
+    qulonglong sessionId;
+    QVariantMap details;
+};
+struct AbortMessage : public WampMessage
+{
+    AbortMessage() : WampMessage(WampMsgCode::ABORT) {}
+    QVariantMap details;
+    QString reason;
+};
+struct ChallengeMessage : public WampMessage
+{
+    ChallengeMessage() : WampMessage(WampMsgCode::CHALLENGE) {}
+    QString authMethod;
+    QVariantMap extra;
+};
+struct AuthenticateMessage : public WampMessage
+{
+    AuthenticateMessage() : WampMessage(WampMsgCode::AUTHENTICATE) {}
+    QByteArray signature;
+    QVariantMap extra;
+};
+struct GoodbyeMessage : public WampMessage
+{
+    GoodbyeMessage() : WampMessage(WampMsgCode::GOODBYE) {}
+    QVariantMap details;
+    QString reason;
+};
+struct ErrorMessage : public WampMessage
+{
+    ErrorMessage() : WampMessage(WampMsgCode::ERROR), requestType(0), requestId(0) {}
+    int requestType;
+    qulonglong requestId;
+    QVariantMap details;
+    QString error;
+    QVariantList args;
+    QVariantMap kwargs;
+};
+struct PublishMessage : public WampMessage
+{
+    PublishMessage() : WampMessage(WampMsgCode::PUBLISH), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+    QString topic;
+    QVariantList args;
+    QVariantMap kwargs;
+    WampPayload payload;
+};
+struct PublishedMessage : public WampMessage
+{
+    PublishedMessage() : WampMessage(WampMsgCode::PUBLISHED), requestId(0), publicationId(0) {}
+    qulonglong requestId;
+    qulonglong publicationId;
+};
+struct SubscribeMessage : public WampMessage
+{
+    SubscribeMessage() : WampMessage(WampMsgCode::SUBSCRIBE), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+    QString topic;
+};
+struct SubscribedMessage : public WampMessage
+{
+    SubscribedMessage() : WampMessage(WampMsgCode::SUBSCRIBED), requestId(0), subscriptionId(0) {}
+    qulonglong requestId;
+    qulonglong subscriptionId;
+};
+struct UnsubscribeMessage : public WampMessage
+{
+    UnsubscribeMessage() : WampMessage(WampMsgCode::UNSUBSCRIBE), requestId(0), subscriptionId(0) {}
+    qulonglong requestId;
+    qulonglong subscriptionId;
+};
+struct UnsubscribedMessage : public WampMessage
+{
+    UnsubscribedMessage() : WampMessage(WampMsgCode::UNSUBSCRIBED), requestId(0) {}
+    qulonglong requestId;
+};
+struct EventMessage : public WampMessage
+{
+    EventMessage() : WampMessage(WampMsgCode::EVENT), subscriptionId(0), publicationId(0) {}
+    qulonglong subscriptionId;
+    qulonglong publicationId;
+    QVariantMap details;
+    QVariantList args;
+    QVariantMap kwargs;
+};
+struct CallMessage : public WampMessage
+{
+    CallMessage() : WampMessage(WampMsgCode::CALL), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+    QString procedure;
+    QVariantList args;
+    QVariantMap kwargs;
+    WampPayload payload;
+};
+struct CancelMessage : public WampMessage
+{
+    CancelMessage() : WampMessage(WampMsgCode::CANCEL), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+};
+struct ResultMessage : public WampMessage
+{
+    ResultMessage() : WampMessage(WampMsgCode::RESULT), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap details;
+    QVariantList args;
+    QVariantMap kwargs;
+};
+struct RegisterMessage : public WampMessage
+{
+    RegisterMessage() : WampMessage(WampMsgCode::REGISTER), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+    QString procedure;
+};
+struct RegisteredMessage : public WampMessage
+{
+    RegisteredMessage() : WampMessage(WampMsgCode::REGISTERED), requestId(0), registrationId(0) {}
+    qulonglong requestId;
+    qulonglong registrationId;
+};
+struct UnregisterMessage : public WampMessage
+{
+    UnregisterMessage() : WampMessage(WampMsgCode::UNREGISTER), requestId(0), registrationId(0) {}
+    qulonglong requestId;
+    qulonglong registrationId;
+};
+struct UnregisteredMessage : public WampMessage
+{
+    UnregisteredMessage() : WampMessage(WampMsgCode::UNREGISTERED), requestId(0) {}
+    qulonglong requestId;
+};
+struct InvocationMessage : public WampMessage
+{
+    InvocationMessage() : WampMessage(WampMsgCode::INVOCATION), requestId(0), registrationId(0) {}
+    qulonglong requestId;
+    qulonglong registrationId;
+    QVariantMap details;
+    QVariantList args;
+    QVariantMap kwargs;
+};
+struct InterruptMessage : public WampMessage
+{
+    InterruptMessage() : WampMessage(WampMsgCode::INTERRUPT), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+};
+struct YieldMessage : public WampMessage
+{
+    YieldMessage() : WampMessage(WampMsgCode::YIELD), requestId(0) {}
+    qulonglong requestId;
+    QVariantMap options;
+    QVariantList args;
+    QVariantMap kwargs;
+    WampPayload payload;
+};
+
+// Typed message straight from a message array that was never encoded, as handed over in process
+WampMessagePointer toWampMessage(const QVariantList& message);
+
+template<typename T>
+const T& message_cast(const WampMessagePointer& message)
+{
+    return *static_cast<const T*>(message.data());
+}
+}
+#endif // WAMPMESSAGE_H
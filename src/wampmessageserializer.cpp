@@ -1,105 +1,63 @@
 #include "wampmessageserializer.h"
 #include "wamp_symbols.h"
+#include "wampmessage.h"
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QJsonObject>
 #include <msgpack.hpp>
-#include <sstream>
 #include <QDebug>
 #include <QDateTime>
 #include <QUrl>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QLocale>
+#include <QtNumeric>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QCborStreamWriter>
+#include <QCborStreamReader>
+#endif
+
+namespace QFlow{
+// Extension type of the msgpack timestamp, https://github.com/msgpack/msgpack/blob/master/spec.md#timestamp-extension-type
+const int8_t MSGPACK_TIMESTAMP_TYPE = -1;
+// Appended to the subprotocol to tell apart serializers that send native timestamps.
+const QString NATIVE_TIMESTAMPS_FORMAT_SUFFIX = QStringLiteral("+timestamps");
+
+QDateTime readMsgpackTimestamp(const msgpack::object& o)
+{
+    const uchar* data = reinterpret_cast<const uchar*>(o.via.ext.data());
+    qint64 seconds = 0;
+    quint32 nanoseconds = 0;
+    switch(o.via.ext.size)
+    {
+    case 4:
+        seconds = qFromBigEndian<quint32>(data);
+        break;
+    case 8:
+    {
+        quint64 value = qFromBigEndian<quint64>(data);
+        nanoseconds = quint32(value >> 34);
+        seconds = qint64(value & 0x3ffffffffULL);
+        break;
+    }
+    case 12:
+        nanoseconds = qFromBigEndian<quint32>(data);
+        seconds = qint64(qFromBigEndian<quint64>(data + 4));
+        break;
+    default:
+        return QDateTime();
+    }
+    return QDateTime::fromMSecsSinceEpoch(seconds * 1000 + nanoseconds / 1000000, Qt::UTC);
+}
+}
 
 namespace msgpack {
 MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
 namespace adaptor {
 
-template<>
-struct pack<QVariant> {
-    template <typename Stream>
-    packer<Stream>& operator()(msgpack::packer<Stream>& o, QVariant const& v) const {
-        if((QMetaType::Type)v.type() == QMetaType::Bool)
-        {
-            o.pack(v.toBool());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::QString)
-        {
-            o.pack(v.toString().toStdString());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::Int)
-        {
-            o.pack_int(v.toInt());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::ULongLong)
-        {
-            o.pack_unsigned_long_long(v.toULongLong());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::Float)
-        {
-            o.pack_float(v.toFloat());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::Double)
-        {
-            o.pack_double(v.toDouble());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::QByteArray)
-        {
-            QByteArray arr = v.toByteArray();
-            o.pack_bin(arr.length());
-            o.pack_bin_body(arr.data(), arr.length());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::QVariantList ||
-                (QMetaType::Type)v.type() == QMetaType::QStringList)
-        {
-            o.pack(v.toList());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::QVariantMap)
-        {
-            o.pack(v.toMap());
-        }
-        else if((QMetaType::Type)v.type() == QMetaType::QDateTime)
-        {
-            QString utcStr = v.toDateTime().toUTC().toString(Qt::ISODate);
-            o.pack(utcStr.toStdString());
-        }
-        else if ((QMetaType::Type)v.type() == QMetaType::QUrl)
-        {
-            o.pack(v.toUrl().toString().toStdString());
-        }
-        else if(v.canConvert<int>())
-        {
-            o.pack_int(v.toInt());
-        }
-        else
-        {
-            qWarning() << "Could not serialize " << v.typeName();
-        }
-        return o;
-    }
-};
-template<>
-struct pack<QVariantList> {
-    template <typename Stream>
-    packer<Stream>& operator()(msgpack::packer<Stream>& o, QVariantList const& arr) const {
-        o.pack_array(arr.length());
-        for(QVariant var: arr)
-        {
-            o.pack(var);
-        }
-        return o;
-    }
-};
-template<>
-struct pack<QVariantMap> {
-    template <typename Stream>
-    packer<Stream>& operator()(msgpack::packer<Stream>& o, QVariantMap const& map) const {
-        o.pack_map(map.count());
-        for(QString key: map.keys())
-        {
-            o.pack(key.toStdString());
-            o.pack(map[key]);
-        }
-        return o;
-    }
-};
 template<>
 struct convert<QVariant> {
     msgpack::object const& operator()(msgpack::object const& o, QVariant& v) const {
@@ -137,6 +95,10 @@ struct convert<QVariant> {
         {
             v = QVariant(o.as<QVariantMap>());
         }
+        else if(o.type == msgpack::type::EXT && o.via.ext.type() == QFlow::MSGPACK_TIMESTAMP_TYPE)
+        {
+            v = QVariant(QFlow::readMsgpackTimestamp(o));
+        }
         else
         {
             qWarning() << "Could not deserialize " << o.type;
@@ -162,8 +124,7 @@ template<>
 struct convert<QString> {
     msgpack::object const& operator()(msgpack::object const& o, QString& v) const {
         if (o.type != msgpack::type::STR) throw msgpack::type_error();
-        QString str = QString::fromStdString(o.as<std::string>());
-        v = str;
+        v = QString::fromUtf8(o.via.str.ptr, int(o.via.str.size));
         return o;
     }
 };
@@ -187,103 +148,2030 @@ struct convert<QVariantMap> {
 }
 }
 
-QVariant toBase64(const QVariant& var)
+namespace QFlow{
+
+// Strings up to this many UTF-16 code units are encoded on the stack, which covers URIs and map keys.
+const int INLINE_STRING_LENGTH = 256;
+// Output buffers are pre-sized from the previous frame, clamped to these bounds.
+const int MIN_SIZE_HINT = 256;
+const int MAX_SIZE_HINT = 64 * 1024;
+
+int encodeUtf8(const QString& str, char* out)
+{
+    char* cursor = out;
+    const ushort* src = str.utf16();
+    const ushort* end = src + str.size();
+    while(src != end)
+    {
+        uint u = *src++;
+        if(u < 0x80)
+        {
+            *cursor++ = char(u);
+            continue;
+        }
+        if(u < 0x800)
+        {
+            *cursor++ = char(0xc0 | (u >> 6));
+            *cursor++ = char(0x80 | (u & 0x3f));
+            continue;
+        }
+        if(QChar::isHighSurrogate(u) && src != end && QChar::isLowSurrogate(*src))
+        {
+            uint ucs4 = QChar::surrogateToUcs4(ushort(u), *src++);
+            *cursor++ = char(0xf0 | (ucs4 >> 18));
+            *cursor++ = char(0x80 | ((ucs4 >> 12) & 0x3f));
+            *cursor++ = char(0x80 | ((ucs4 >> 6) & 0x3f));
+            *cursor++ = char(0x80 | (ucs4 & 0x3f));
+            continue;
+        }
+        if(QChar::isSurrogate(u)) u = QChar::ReplacementCharacter;
+        *cursor++ = char(0xe0 | (u >> 12));
+        *cursor++ = char(0x80 | ((u >> 6) & 0x3f));
+        *cursor++ = char(0x80 | (u & 0x3f));
+    }
+    return int(cursor - out);
+}
+
+class QByteArrayStream
+{
+public:
+    explicit QByteArrayStream(QByteArray& buffer) : _buffer(buffer)
+    {
+    }
+    void write(const char* data, size_t size)
+    {
+        _buffer.append(data, int(size));
+    }
+private:
+    QByteArray& _buffer;
+};
+
+class MsgpackWriter
 {
-    if((QMetaType::Type)var.type() == QMetaType::QByteArray)
+public:
+    MsgpackWriter(QByteArray& buffer, bool nativeTimestamps = false) : _stream(buffer), _packer(_stream),
+        _nativeTimestamps(nativeTimestamps)
+    {
+    }
+    void write(const QVariant& v)
+    {
+        switch((QMetaType::Type)v.type())
+        {
+        case QMetaType::UnknownType:
+        case QMetaType::Nullptr:
+            _packer.pack_nil();
+            break;
+        case QMetaType::Bool:
+            if(v.toBool()) _packer.pack_true();
+            else _packer.pack_false();
+            break;
+        case QMetaType::QString:
+            write(v.toString());
+            break;
+        case QMetaType::Int:
+            _packer.pack_int(v.toInt());
+            break;
+        case QMetaType::UInt:
+            _packer.pack_unsigned_int(v.toUInt());
+            break;
+        case QMetaType::LongLong:
+            _packer.pack_long_long(v.toLongLong());
+            break;
+        case QMetaType::ULongLong:
+            _packer.pack_unsigned_long_long(v.toULongLong());
+            break;
+        case QMetaType::Float:
+            _packer.pack_float(v.toFloat());
+            break;
+        case QMetaType::Double:
+            _packer.pack_double(v.toDouble());
+            break;
+        case QMetaType::QByteArray:
+        {
+            const QByteArray& arr = *reinterpret_cast<const QByteArray*>(v.constData());
+            _packer.pack_bin(arr.size());
+            _packer.pack_bin_body(arr.constData(), arr.size());
+            break;
+        }
+        case QMetaType::QVariantList:
+            write(*reinterpret_cast<const QVariantList*>(v.constData()));
+            break;
+        case QMetaType::QStringList:
+        {
+            const QStringList& list = *reinterpret_cast<const QStringList*>(v.constData());
+            _packer.pack_array(list.size());
+            for(const QString& str: list) write(str);
+            break;
+        }
+        case QMetaType::QVariantMap:
+            write(*reinterpret_cast<const QVariantMap*>(v.constData()));
+            break;
+        case QMetaType::QDateTime:
+            if(_nativeTimestamps) writeTimestamp(v.toDateTime());
+            else write(v.toDateTime().toUTC().toString(Qt::ISODate));
+            break;
+        case QMetaType::QUrl:
+            write(v.toUrl().toString());
+            break;
+        default:
+            if(v.canConvert<int>())
+            {
+                _packer.pack_int(v.toInt());
+            }
+            else
+            {
+                qWarning() << "Could not serialize " << v.typeName();
+                _packer.pack_nil();
+            }
+        }
+    }
+    void writeArrayHeader(int size)
+    {
+        _packer.pack_array(size);
+    }
+    void write(const QVariantList& list)
     {
-        QByteArray ba = var.toByteArray();
-        return QVariant(ba.toBase64());
+        _packer.pack_array(list.size());
+        for(const QVariant& var: list) write(var);
     }
-    else if((QMetaType::Type)var.type() == QMetaType::QVariantList)
+    void write(const QVariantMap& map)
     {
-        QVariantList list = var.toList();
-        for(int i=0;i<list.length();i++)
+        _packer.pack_map(map.size());
+        for(auto it = map.constBegin(); it != map.constEnd(); ++it)
         {
-            list[i] = toBase64(list[i]);
+            write(it.key());
+            write(it.value());
         }
-        return QVariant(list);
     }
-    else if((QMetaType::Type)var.type() == QMetaType::QVariantMap)
+    void write(const QString& str)
     {
-        QVariantMap map = var.toMap();
-        for(QString key: map.keys())
+        if(str.size() <= INLINE_STRING_LENGTH)
         {
-            map[key] = toBase64(map[key]);
+            char utf8[INLINE_STRING_LENGTH * 3];
+            int size = encodeUtf8(str, utf8);
+            _packer.pack_str(size);
+            _packer.pack_str_body(utf8, size);
+            return;
         }
-        return QVariant(map);
+        QByteArray utf8 = str.toUtf8();
+        _packer.pack_str(utf8.size());
+        _packer.pack_str_body(utf8.constData(), utf8.size());
     }
-    return var;
-}
-
-namespace QFlow{
+    // Uses the smallest of the 32, 64 and 96 bit timestamp layouts that holds the value.
+    void writeTimestamp(const QDateTime& dateTime)
+    {
+        qint64 msecs = dateTime.toMSecsSinceEpoch();
+        qint64 seconds = msecs / 1000;
+        qint64 remainder = msecs % 1000;
+        if(remainder < 0)
+        {
+            remainder += 1000;
+            seconds--;
+        }
+        quint32 nanoseconds = quint32(remainder * 1000000);
+        uchar data[12];
+        if((quint64(seconds) >> 34) == 0)
+        {
+            if(nanoseconds == 0 && (quint64(seconds) >> 32) == 0)
+            {
+                qToBigEndian<quint32>(quint32(seconds), data);
+                _packer.pack_ext(4, MSGPACK_TIMESTAMP_TYPE);
+                _packer.pack_ext_body(reinterpret_cast<const char*>(data), 4);
+                return;
+            }
+            qToBigEndian<quint64>((quint64(nanoseconds) << 34) | quint64(seconds), data);
+            _packer.pack_ext(8, MSGPACK_TIMESTAMP_TYPE);
+            _packer.pack_ext_body(reinterpret_cast<const char*>(data), 8);
+            return;
+        }
+        qToBigEndian<quint32>(nanoseconds, data);
+        qToBigEndian<quint64>(quint64(seconds), data + 4);
+        _packer.pack_ext(12, MSGPACK_TIMESTAMP_TYPE);
+        _packer.pack_ext_body(reinterpret_cast<const char*>(data), 12);
+    }
+private:
+    QByteArrayStream _stream;
+    msgpack::packer<QByteArrayStream> _packer;
+    bool _nativeTimestamps;
+};
 
-WampMessageSerializer::WampMessageSerializer(QObject *parent) : QObject(parent)
+// Writes compact JSON straight from the QVariant tree. Binaries become strings holding
+// a NUL character followed by their base64 encoding, as the WAMP JSON serialization requires.
+class JsonWriter
 {
+public:
+    explicit JsonWriter(QByteArray& buffer) : _buffer(buffer)
+    {
+    }
+    void write(const QVariant& v)
+    {
+        switch((QMetaType::Type)v.type())
+        {
+        case QMetaType::UnknownType:
+        case QMetaType::Nullptr:
+            _buffer.append("null", 4);
+            break;
+        case QMetaType::Bool:
+            if(v.toBool()) _buffer.append("true", 4);
+            else _buffer.append("false", 5);
+            break;
+        case QMetaType::QString:
+            write(*reinterpret_cast<const QString*>(v.constData()));
+            break;
+        case QMetaType::Int:
+        case QMetaType::LongLong:
+            _buffer.append(QByteArray::number(v.toLongLong()));
+            break;
+        case QMetaType::UInt:
+        case QMetaType::ULongLong:
+            _buffer.append(QByteArray::number(v.toULongLong()));
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            writeDouble(v.toDouble());
+            break;
+        case QMetaType::QByteArray:
+        {
+            const QByteArray& arr = *reinterpret_cast<const QByteArray*>(v.constData());
+            _buffer.append("\"\\u0000", 7);
+            _buffer.append(arr.toBase64());
+            _buffer.append('"');
+            break;
+        }
+        case QMetaType::QVariantList:
+            write(*reinterpret_cast<const QVariantList*>(v.constData()));
+            break;
+        case QMetaType::QStringList:
+        {
+            const QStringList& list = *reinterpret_cast<const QStringList*>(v.constData());
+            _buffer.append('[');
+            for(int i=0; i<list.size(); i++)
+            {
+                if(i > 0) _buffer.append(',');
+                write(list[i]);
+            }
+            _buffer.append(']');
+            break;
+        }
+        case QMetaType::QVariantMap:
+            write(*reinterpret_cast<const QVariantMap*>(v.constData()));
+            break;
+        case QMetaType::QDateTime:
+            write(v.toDateTime().toUTC().toString(Qt::ISODate));
+            break;
+        case QMetaType::QUrl:
+            write(v.toUrl().toString());
+            break;
+        default:
+            if(v.canConvert<int>())
+            {
+                _buffer.append(QByteArray::number(v.toInt()));
+            }
+            else
+            {
+                qWarning() << "Could not serialize " << v.typeName();
+                _buffer.append("null", 4);
+            }
+        }
+    }
+    // Writes the elements without the enclosing brackets.
+    void writeElements(const QVariantList& list)
+    {
+        for(int i=0; i<list.size(); i++)
+        {
+            if(i > 0) _buffer.append(',');
+            write(list[i]);
+        }
+    }
+    void write(const QVariantList& list)
+    {
+        _buffer.append('[');
+        writeElements(list);
+        _buffer.append(']');
+    }
+    void write(const QVariantMap& map)
+    {
+        _buffer.append('{');
+        for(auto it = map.constBegin(); it != map.constEnd(); ++it)
+        {
+            if(it != map.constBegin()) _buffer.append(',');
+            write(it.key());
+            _buffer.append(':');
+            write(it.value());
+        }
+        _buffer.append('}');
+    }
+    void write(const QString& str)
+    {
+        if(str.size() <= INLINE_STRING_LENGTH)
+        {
+            char utf8[INLINE_STRING_LENGTH * 3];
+            int size = encodeUtf8(str, utf8);
+            writeEscaped(utf8, size);
+            return;
+        }
+        QByteArray utf8 = str.toUtf8();
+        writeEscaped(utf8.constData(), utf8.size());
+    }
+private:
+    void writeEscaped(const char* utf8, int size)
+    {
+        static const char hex[] = "0123456789abcdef";
+        _buffer.append('"');
+        int run = 0;
+        for(int i=0; i<size; i++)
+        {
+            uchar c = uchar(utf8[i]);
+            if(c >= 0x20 && c != '"' && c != '\\') continue;
+            _buffer.append(utf8 + run, i - run);
+            run = i + 1;
+            switch(c)
+            {
+            case '"': _buffer.append("\\\"", 2); break;
+            case '\\': _buffer.append("\\\\", 2); break;
+            case '\b': _buffer.append("\\b", 2); break;
+            case '\f': _buffer.append("\\f", 2); break;
+            case '\n': _buffer.append("\\n", 2); break;
+            case '\r': _buffer.append("\\r", 2); break;
+            case '\t': _buffer.append("\\t", 2); break;
+            default:
+            {
+                char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                _buffer.append(escape, 6);
+            }
+            }
+        }
+        _buffer.append(utf8 + run, size - run);
+        _buffer.append('"');
+    }
+    void writeDouble(double d)
+    {
+        // JSON has no representation for NaN and infinities
+        if(!qIsFinite(d))
+        {
+            _buffer.append("null", 4);
+            return;
+        }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+        _buffer.append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+#else
+        _buffer.append(QByteArray::number(d, 'g', 17));
+#endif
+    }
+    QByteArray& _buffer;
+};
 
+// Converts parsed JSON to variants, restoring binaries sent as NUL-prefixed base64 strings.
+QVariant fromJson(const QJsonValue& value);
+QVariantList fromJson(const QJsonArray& array)
+{
+    QVariantList list;
+    list.reserve(array.size());
+    for(const QJsonValue& value: array) list.append(fromJson(value));
+    return list;
 }
-WampMessageSerializer::~WampMessageSerializer()
+QVariantMap fromJson(const QJsonObject& object)
 {
-
+    QVariantMap map;
+    for(auto it = object.constBegin(); it != object.constEnd(); ++it) map.insert(it.key(), fromJson(it.value()));
+    return map;
 }
-bool WampMessageSerializer::isBinary() const
+QVariant fromJson(const QJsonValue& value)
 {
-    return false;
+    switch(value.type())
+    {
+    case QJsonValue::String:
+    {
+        QString str = value.toString();
+        if(str.startsWith(QChar(0))) return QByteArray::fromBase64(str.midRef(1).toLatin1());
+        return str;
+    }
+    case QJsonValue::Array:
+        return fromJson(value.toArray());
+    case QJsonValue::Object:
+        return fromJson(value.toObject());
+    default:
+        return value.toVariant();
+    }
 }
-WampMessageSerializer* WampMessageSerializer::create(const QString &name)
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+// Epoch based date/time, RFC 7049 section 2.4.1
+const quint64 CBOR_EPOCH_DATETIME_TAG = 1;
+
+void writeCborArrayHeader(QByteArray& buffer, quint64 size)
 {
-    if(name == KEY_WAMP_JSON_SUB) return new JsonMessageSerializer();
-    else if(name == KEY_WAMP_MSGPACK_SUB) return new MsgpackMessageSerializer();
-    return nullptr;
+    const char major = char(0x80);
+    if(size < 24)
+    {
+        buffer.append(char(major | size));
+        return;
+    }
+    int bytes = size <= 0xff ? 1 : size <= 0xffff ? 2 : size <= 0xffffffffULL ? 4 : 8;
+    buffer.append(char(major | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27)));
+    for(int i=bytes-1; i>=0; i--) buffer.append(char((size >> (8 * i)) & 0xff));
 }
 
-JsonMessageSerializer::JsonMessageSerializer(QObject *parent) : WampMessageSerializer(parent)
+class CborWriter
 {
+public:
+    explicit CborWriter(QByteArray& buffer) : _writer(&buffer)
+    {
+    }
+    void write(const QVariant& v)
+    {
+        switch((QMetaType::Type)v.type())
+        {
+        case QMetaType::UnknownType:
+        case QMetaType::Nullptr:
+            _writer.append(nullptr);
+            break;
+        case QMetaType::Bool:
+            _writer.append(v.toBool());
+            break;
+        case QMetaType::QString:
+            write(*reinterpret_cast<const QString*>(v.constData()));
+            break;
+        case QMetaType::Int:
+        case QMetaType::LongLong:
+            _writer.append(qint64(v.toLongLong()));
+            break;
+        case QMetaType::UInt:
+        case QMetaType::ULongLong:
+            _writer.append(quint64(v.toULongLong()));
+            break;
+        case QMetaType::Float:
+            _writer.append(v.toFloat());
+            break;
+        case QMetaType::Double:
+            _writer.append(v.toDouble());
+            break;
+        case QMetaType::QByteArray:
+            _writer.append(*reinterpret_cast<const QByteArray*>(v.constData()));
+            break;
+        case QMetaType::QVariantList:
+            write(*reinterpret_cast<const QVariantList*>(v.constData()));
+            break;
+        case QMetaType::QStringList:
+        {
+            const QStringList& list = *reinterpret_cast<const QStringList*>(v.constData());
+            _writer.startArray(quint64(list.size()));
+            for(const QString& str: list) write(str);
+            _writer.endArray();
+            break;
+        }
+        case QMetaType::QVariantMap:
+            write(*reinterpret_cast<const QVariantMap*>(v.constData()));
+            break;
+        case QMetaType::QDateTime:
+        {
+            qint64 msecs = v.toDateTime().toMSecsSinceEpoch();
+            _writer.append(QCborTag(CBOR_EPOCH_DATETIME_TAG));
+            if(msecs % 1000 == 0) _writer.append(qint64(msecs / 1000));
+            else _writer.append(double(msecs) / 1000);
+            break;
+        }
+        case QMetaType::QUrl:
+            write(v.toUrl().toString());
+            break;
+        default:
+            if(v.canConvert<int>())
+            {
+                _writer.append(qint64(v.toInt()));
+            }
+            else
+            {
+                qWarning() << "Could not serialize " << v.typeName();
+                _writer.append(nullptr);
+            }
+        }
+    }
+    void write(const QVariantList& list)
+    {
+        _writer.startArray(quint64(list.size()));
+        for(const QVariant& var: list) write(var);
+        _writer.endArray();
+    }
+    void write(const QVariantMap& map)
+    {
+        _writer.startMap(quint64(map.size()));
+        for(auto it = map.constBegin(); it != map.constEnd(); ++it)
+        {
+            write(it.key());
+            write(it.value());
+        }
+        _writer.endMap();
+    }
+    void write(const QString& str)
+    {
+        if(str.size() <= INLINE_STRING_LENGTH)
+        {
+            char utf8[INLINE_STRING_LENGTH * 3];
+            int size = encodeUtf8(str, utf8);
+            _writer.appendTextString(utf8, size);
+            return;
+        }
+        QByteArray utf8 = str.toUtf8();
+        _writer.appendTextString(utf8.constData(), utf8.size());
+    }
+private:
+    QCborStreamWriter _writer;
+};
 
+// Reads complete items, converting epoch and ISO date/time tags to QDateTime and
+// failing as soon as an item exceeds the decode limits.
+class CborValueReader
+{
+public:
+    explicit CborValueReader(const WampDecodeLimits& limits) : _limits(limits), _elements(0)
+    {
+    }
+    // depth is the nesting depth of the container holding the item, 0 for a top-level item.
+    bool read(QCborStreamReader& reader, QVariant& value, int depth);
+private:
+    const WampDecodeLimits& _limits;
+    int _elements;
+};
+bool CborValueReader::read(QCborStreamReader& reader, QVariant& value, int depth)
+{
+    if(++_elements > _limits.maxElements) return false;
+    switch(reader.type())
+    {
+    case QCborStreamReader::UnsignedInteger:
+        value = qulonglong(reader.toUnsignedInteger());
+        reader.next();
+        break;
+    case QCborStreamReader::NegativeInteger:
+        value = qlonglong(reader.toInteger());
+        reader.next();
+        break;
+    case QCborStreamReader::ByteArray:
+    {
+        if(reader.isLengthKnown() && reader.length() > quint64(_limits.maxStringLength)) return false;
+        QByteArray data;
+        auto chunk = reader.readByteArray();
+        while(chunk.status == QCborStreamReader::Ok)
+        {
+            data.append(chunk.data);
+            if(data.size() > _limits.maxStringLength) return false;
+            chunk = reader.readByteArray();
+        }
+        if(chunk.status == QCborStreamReader::Error) return false;
+        value = data;
+        break;
+    }
+    case QCborStreamReader::String:
+    {
+        if(reader.isLengthKnown() && reader.length() > quint64(_limits.maxStringLength)) return false;
+        QString str;
+        auto chunk = reader.readString();
+        while(chunk.status == QCborStreamReader::Ok)
+        {
+            str.append(chunk.data);
+            if(str.size() > _limits.maxStringLength) return false;
+            chunk = reader.readString();
+        }
+        if(chunk.status == QCborStreamReader::Error) return false;
+        value = str;
+        break;
+    }
+    case QCborStreamReader::Array:
+    {
+        if(depth + 1 > _limits.maxDepth) return false;
+        QVariantList list;
+        if(reader.isLengthKnown()) list.reserve(int(qMin<quint64>(reader.length(), 1024)));
+        if(!reader.enterContainer()) return false;
+        while(reader.hasNext())
+        {
+            QVariant element;
+            if(!read(reader, element, depth + 1)) return false;
+            list.append(element);
+        }
+        if(reader.lastError() != QCborError::NoError || !reader.leaveContainer()) return false;
+        value = list;
+        break;
+    }
+    case QCborStreamReader::Map:
+    {
+        if(depth + 1 > _limits.maxDepth) return false;
+        QVariantMap map;
+        if(!reader.enterContainer()) return false;
+        while(reader.hasNext())
+        {
+            QVariant key, element;
+            if(!read(reader, key, depth + 1) || !read(reader, element, depth + 1)) return false;
+            map.insert(key.toString(), element);
+        }
+        if(reader.lastError() != QCborError::NoError || !reader.leaveContainer()) return false;
+        value = map;
+        break;
+    }
+    case QCborStreamReader::Tag:
+    {
+        QCborTag tag = reader.toTag();
+        if(!reader.next()) return false;
+        QVariant tagged;
+        if(!read(reader, tagged, depth)) return false;
+        if(quint64(tag) == CBOR_EPOCH_DATETIME_TAG)
+        {
+            value = QDateTime::fromMSecsSinceEpoch(qint64(tagged.toDouble() * 1000), Qt::UTC);
+        }
+        else if(quint64(tag) == quint64(QCborKnownTags::DateTimeString))
+        {
+            value = QDateTime::fromString(tagged.toString(), Qt::ISODate);
+        }
+        else value = tagged;
+        break;
+    }
+    case QCborStreamReader::SimpleType:
+        if(reader.isTrue()) value = true;
+        else if(reader.isFalse()) value = false;
+        else value = QVariant();
+        reader.next();
+        break;
+    case QCborStreamReader::Float16:
+        value = double(float(reader.toFloat16()));
+        reader.next();
+        break;
+    case QCborStreamReader::Float:
+        value = reader.toFloat();
+        reader.next();
+        break;
+    case QCborStreamReader::Double:
+        value = reader.toDouble();
+        reader.next();
+        break;
+    default:
+        return false;
+    }
+    return reader.lastError() == QCborError::NoError;
 }
-JsonMessageSerializer::~JsonMessageSerializer()
+#endif
+}
+
+namespace QFlow{
+
+// Index of the first args/kwargs element of the messages the router can pass through
+// without decoding their payload, -1 for all other messages.
+int payloadIndex(WampMsgCode code)
 {
+    switch(code)
+    {
+    case WampMsgCode::CALL:
+    case WampMsgCode::PUBLISH:
+        return 4;
+    case WampMsgCode::YIELD:
+        return 3;
+    default:
+        return -1;
+    }
+}
 
+// WAMP ids are integers from 0 to 2^53, the range a double holds exactly
+const qulonglong MAX_WAMP_ID = 9007199254740992ULL;
+bool wampIdFromDouble(double value, qulonglong& id)
+{
+    if(!(value >= 0 && value <= double(MAX_WAMP_ID)) || value != std::floor(value)) return false;
+    id = qulonglong(value);
+    return true;
 }
-QVariantList JsonMessageSerializer::deserialize(const QByteArray &message)
+
+bool readMsgpackLength(const char* data, size_t size, size_t& offset, int bytes, quint64& value)
 {
-    QJsonDocument doc = QJsonDocument::fromJson(message);
-    QJsonArray arr = doc.array();
-    return arr.toVariantList();
+    if(size - offset < size_t(bytes)) return false;
+    value = 0;
+    for(int i=0; i<bytes; i++) value = (value << 8) | uchar(data[offset++]);
+    return true;
 }
-QByteArray JsonMessageSerializer::serialize(const QVariantList &arr)
+bool readMsgpackArrayHeader(const char* data, size_t size, size_t& offset, quint64& count)
 {
-    QVariant listVarBase64 = toBase64(QVariant(arr));
-    QJsonArray jsonArr = QJsonArray::fromVariantList(listVarBase64.toList());
-    QJsonDocument doc(jsonArr);
-    QByteArray message = doc.toJson();
-    return message;
+    if(offset >= size) return false;
+    uchar type = uchar(data[offset++]);
+    if((type & 0xf0) == 0x90)
+    {
+        count = type & 0x0f;
+        return true;
+    }
+    if(type == 0xdc) return readMsgpackLength(data, size, offset, 2, count);
+    if(type == 0xdd) return readMsgpackLength(data, size, offset, 4, count);
+    return false;
 }
-
-MsgpackMessageSerializer::MsgpackMessageSerializer(QObject *parent) : WampMessageSerializer(parent)
+// Walks msgpack objects without materializing them and enforces the decode limits on the way,
+// so oversized or deeply nested frames are rejected before anything is unpacked.
+class MsgpackScanner
 {
+public:
+    MsgpackScanner(const char* data, size_t size, const WampDecodeLimits& limits) : _data(data), _size(size),
+        _limits(limits), _elements(0)
+    {
+    }
+    // Advances offset past one complete object held by a container depth levels deep.
+    bool skip(size_t& offset, int depth)
+    {
+        QVarLengthArray<quint64, 16> pending;
+        pending.append(1);
+        while(!pending.isEmpty())
+        {
+            if(pending.last() == 0)
+            {
+                pending.removeLast();
+                continue;
+            }
+            pending.last()--;
+            if(offset >= _size || ++_elements > _limits.maxElements) return false;
+            uchar type = uchar(_data[offset++]);
+            quint64 body = 0;
+            quint64 children = 0;
+            bool sized = false;
+            if(type <= 0x7f || type >= 0xe0)
+            {
+            }
+            else if(type <= 0x8f) children = 2 * (type & 0x0f);
+            else if(type <= 0x9f) children = type & 0x0f;
+            else if(type <= 0xbf)
+            {
+                body = type & 0x1f;
+                sized = true;
+            }
+            else
+            {
+                bool ok = true;
+                switch(type)
+                {
+                case 0xc0: case 0xc2: case 0xc3: break;
+                case 0xc4: case 0xd9: ok = readLength(offset, 1, body); sized = true; break;
+                case 0xc5: case 0xda: ok = readLength(offset, 2, body); sized = true; break;
+                case 0xc6: case 0xdb: ok = readLength(offset, 4, body); sized = true; break;
+                case 0xc7: ok = readLength(offset, 1, body); body += 1; sized = true; break;
+                case 0xc8: ok = readLength(offset, 2, body); body += 1; sized = true; break;
+                case 0xc9: ok = readLength(offset, 4, body); body += 1; sized = true; break;
+                case 0xca: case 0xce: case 0xd2: body = 4; break;
+                case 0xcb: case 0xcf: case 0xd3: body = 8; break;
+                case 0xcc: case 0xd0: body = 1; break;
+                case 0xcd: case 0xd1: body = 2; break;
+                case 0xd4: body = 2; break;
+                case 0xd5: body = 3; break;
+                case 0xd6: body = 5; break;
+                case 0xd7: body = 9; break;
+                case 0xd8: body = 17; break;
+                case 0xdc: ok = readLength(offset, 2, children); break;
+                case 0xdd: ok = readLength(offset, 4, children); break;
+                case 0xde: ok = readLength(offset, 2, children); children *= 2; break;
+                case 0xdf: ok = readLength(offset, 4, children); children *= 2; break;
+                default: ok = false;
+                }
+                if(!ok) return false;
+            }
+            // ext bodies carry one extra byte for their type
+            if(sized && body > quint64(_limits.maxStringLength) + 1) return false;
+            if(body > _size - offset) return false;
+            offset += body;
+            if(children > 0)
+            {
+                if(depth + pending.size() > _limits.maxDepth) return false;
+                // every object takes at least one byte
+                if(children > _size - offset) return false;
+                pending.append(children);
+            }
+        }
+        return true;
+    }
+private:
+    bool readLength(size_t& offset, int bytes, quint64& value)
+    {
+        return readMsgpackLength(_data, _size, offset, bytes, value);
+    }
+    const char* _data;
+    size_t _size;
+    const WampDecodeLimits& _limits;
+    int _elements;
+};
 
+msgpack::unpack_limit unpackLimit(const WampDecodeLimits& limits)
+{
+    size_t elements = size_t(limits.maxElements);
+    size_t length = size_t(limits.maxStringLength);
+    return msgpack::unpack_limit(elements, elements, length, length, length, size_t(limits.maxDepth));
 }
-MsgpackMessageSerializer::~MsgpackMessageSerializer()
+
+// One pass over the raw text that rejects frames exceeding the decode limits before
+// they are handed to the JSON parser. Syntax is left for the parser to check.
+bool checkJsonLimits(const QByteArray& json, const WampDecodeLimits& limits)
 {
+    if(json.size() > limits.maxFrameSize) return false;
+    const char* data = json.constData();
+    int size = json.size();
+    int depth = 0;
+    int elements = 0;
+    for(int pos=0; pos<size; pos++)
+    {
+        char c = data[pos];
+        if(c == '"')
+        {
+            int start = ++pos;
+            while(pos < size && data[pos] != '"')
+            {
+                if(data[pos] == '\\') pos++;
+                pos++;
+            }
+            if(pos - start > limits.maxStringLength || ++elements > limits.maxElements) return false;
+        }
+        else if(c == '[' || c == '{')
+        {
+            if(++depth > limits.maxDepth || ++elements > limits.maxElements) return false;
+        }
+        else if(c == ']' || c == '}')
+        {
+            depth--;
+        }
+        else if(c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')
+        {
+            if(++elements > limits.maxElements) return false;
+            while(pos + 1 < size && data[pos + 1] != ',' && data[pos + 1] != ']' && data[pos + 1] != '}') pos++;
+        }
+    }
+    return true;
+}
 
+void skipJsonWhitespace(const char* data, int size, int& pos)
+{
+    while(pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')) pos++;
 }
-QVariantList MsgpackMessageSerializer::deserialize(const QByteArray &message)
+bool skipJsonValue(const char* data, int size, int& pos);
+bool skipJsonString(const char* data, int size, int& pos)
 {
-    msgpack::unpacked result;
-    msgpack::unpack(result, message.data(), message.length());
-    msgpack::object deserialized = result.get();
-    QVariantList arr = deserialized.as<QVariantList>();
-    return arr;
+    if(pos >= size || data[pos] != '"') return false;
+    pos++;
+    while(pos < size && data[pos] != '"')
+    {
+        uchar c = uchar(data[pos]);
+        if(c < 0x20) return false;
+        if(c == '\\')
+        {
+            if(++pos >= size) return false;
+            switch(data[pos])
+            {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                for(int k=0; k<4; k++)
+                {
+                    if(++pos >= size) return false;
+                    char h = data[pos];
+                    if(!((h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') || (h >= 'A' && h <= 'F'))) return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        pos++;
+    }
+    if(pos >= size) return false;
+    pos++;
+    return true;
 }
-QByteArray MsgpackMessageSerializer::serialize(const QVariantList &arr)
+bool skipJsonDigits(const char* data, int size, int& pos)
 {
-    std::stringstream buffer;
-    msgpack::pack(buffer, arr);
-    QByteArray message = QByteArray::fromStdString(buffer.str());
-    return message;
+    int start = pos;
+    while(pos < size && data[pos] >= '0' && data[pos] <= '9') pos++;
+    return pos > start;
 }
-bool MsgpackMessageSerializer::isBinary() const
+bool skipJsonNumber(const char* data, int size, int& pos)
+{
+    if(pos < size && data[pos] == '-') pos++;
+    if(pos < size && data[pos] == '0') pos++;
+    else if(!skipJsonDigits(data, size, pos)) return false;
+    if(pos < size && data[pos] == '.')
+    {
+        pos++;
+        if(!skipJsonDigits(data, size, pos)) return false;
+    }
+    if(pos < size && (data[pos] == 'e' || data[pos] == 'E'))
+    {
+        pos++;
+        if(pos < size && (data[pos] == '+' || data[pos] == '-')) pos++;
+        if(!skipJsonDigits(data, size, pos)) return false;
+    }
+    return true;
+}
+bool skipJsonLiteral(const char* data, int size, int& pos, const char* literal)
+{
+    int length = int(qstrlen(literal));
+    if(size - pos < length || qstrncmp(data + pos, literal, uint(length)) != 0) return false;
+    pos += length;
+    return true;
+}
+bool skipJsonContainer(const char* data, int size, int& pos, char close, bool object)
+{
+    pos++;
+    skipJsonWhitespace(data, size, pos);
+    if(pos < size && data[pos] == close)
+    {
+        pos++;
+        return true;
+    }
+    while(pos < size)
+    {
+        if(object)
+        {
+            if(!skipJsonString(data, size, pos)) return false;
+            skipJsonWhitespace(data, size, pos);
+            if(pos >= size || data[pos] != ':') return false;
+            pos++;
+            skipJsonWhitespace(data, size, pos);
+        }
+        if(!skipJsonValue(data, size, pos)) return false;
+        skipJsonWhitespace(data, size, pos);
+        if(pos >= size) return false;
+        if(data[pos] == close)
+        {
+            pos++;
+            return true;
+        }
+        if(data[pos] != ',') return false;
+        pos++;
+        skipJsonWhitespace(data, size, pos);
+    }
+    return false;
+}
+// Advances pos past one JSON value, checking it against the JSON grammar so that a
+// passthrough payload forwarded without a full parse is still well formed.
+// Nesting is bounded by checkJsonLimits before this runs.
+bool skipJsonValue(const char* data, int size, int& pos)
+{
+    if(pos >= size) return false;
+    switch(data[pos])
+    {
+    case '"':
+        return skipJsonString(data, size, pos);
+    case '[':
+        return skipJsonContainer(data, size, pos, ']', false);
+    case '{':
+        return skipJsonContainer(data, size, pos, '}', true);
+    case 't':
+        return skipJsonLiteral(data, size, pos, "true");
+    case 'f':
+        return skipJsonLiteral(data, size, pos, "false");
+    case 'n':
+        return skipJsonLiteral(data, size, pos, "null");
+    default:
+        return skipJsonNumber(data, size, pos);
+    }
+}
+// Records where each top-level element of a JSON array starts and ends.
+bool scanJsonArray(const QByteArray& json, QVector<int>& starts, QVector<int>& ends)
+{
+    const char* data = json.constData();
+    int size = json.size();
+    int pos = 0;
+    skipJsonWhitespace(data, size, pos);
+    if(pos >= size || data[pos] != '[') return false;
+    pos++;
+    skipJsonWhitespace(data, size, pos);
+    if(pos < size && data[pos] == ']') return true;
+    while(pos < size)
+    {
+        starts.append(pos);
+        if(!skipJsonValue(data, size, pos)) return false;
+        ends.append(pos);
+        skipJsonWhitespace(data, size, pos);
+        if(pos >= size) return false;
+        if(data[pos] == ']') return true;
+        if(data[pos] != ',') return false;
+        pos++;
+        skipJsonWhitespace(data, size, pos);
+    }
+    return false;
+}
+
+class VariantListReader
+{
+public:
+    explicit VariantListReader(const QVariantList& list) : _list(list)
+    {
+    }
+    int size() const
+    {
+        return _list.size();
+    }
+    qulonglong id(int i) const
+    {
+        return i < _list.size() ? _list[i].toULongLong() : 0;
+    }
+    bool isValid() const
+    {
+        return true;
+    }
+    QString string(int i) const
+    {
+        return i < _list.size() ? _list[i].toString() : QString();
+    }
+    QVariantMap map(int i) const
+    {
+        return i < _list.size() ? _list[i].toMap() : QVariantMap();
+    }
+    QVariantList list(int i) const
+    {
+        return i < _list.size() ? _list[i].toList() : QVariantList();
+    }
+    bool hasPayload() const
+    {
+        return false;
+    }
+    WampPayload payload(int /*i*/) const
+    {
+        return WampPayload();
+    }
+private:
+    const QVariantList& _list;
+};
+
+// Locates the elements of a msgpack message up front. Ids and strings are read in place, maps
+// and lists are unpacked only when they are read, and payload elements that are passed through
+// are never unpacked at all.
+class MsgpackReader
+{
+public:
+    MsgpackReader(const QByteArray& message, bool passthrough, const QString& format, const WampDecodeLimits& limits) :
+        _message(message), _passthrough(passthrough), _format(format), _limit(unpackLimit(limits)), _limits(limits),
+        _invalid(false)
+    {
+    }
+    bool parse()
+    {
+        const char* data = _message.constData();
+        size_t size = size_t(_message.size());
+        if(_message.size() > _limits.maxFrameSize) return false;
+        size_t offset = 0;
+        quint64 count = 0;
+        if(!readMsgpackArrayHeader(data, size, offset, count) || count > size - offset) return false;
+        if(count > quint64(_limits.maxElements)) return false;
+        MsgpackScanner scanner(data, size, _limits);
+        _offsets.reserve(int(count) + 1);
+        for(quint64 i=0; i<count; i++)
+        {
+            _offsets.append(offset);
+            if(!scanner.skip(offset, 1)) return false;
+        }
+        _offsets.append(offset);
+        return true;
+    }
+    int size() const
+    {
+        return _offsets.size() - 1;
+    }
+    // Read in place, the scanner already checked that the element is complete
+    qulonglong id(int i) const
+    {
+        if(i >= size()) return 0;
+        const char* data = _message.constData();
+        size_t end = _offsets[i + 1];
+        size_t offset = _offsets[i];
+        uchar type = uchar(data[offset++]);
+        quint64 value = 0;
+        qulonglong id = 0;
+        if(type <= 0x7f) return type;
+        switch(type)
+        {
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            readMsgpackLength(data, end, offset, 1 << (type - 0xcc), value);
+            if(value <= MAX_WAMP_ID) return value;
+            break;
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+        {
+            int bytes = 1 << (type - 0xd0);
+            readMsgpackLength(data, end, offset, bytes, value);
+            // a set sign bit is a negative id
+            if(!(value >> (8 * bytes - 1)) && value <= MAX_WAMP_ID) return value;
+            break;
+        }
+        case 0xca:
+        {
+            quint32 bits = qFromBigEndian<quint32>(data + offset);
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            if(wampIdFromDouble(f, id)) return id;
+            break;
+        }
+        case 0xcb:
+        {
+            quint64 bits = qFromBigEndian<quint64>(data + offset);
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            if(wampIdFromDouble(d, id)) return id;
+            break;
+        }
+        default:
+            break;
+        }
+        _invalid = true;
+        return 0;
+    }
+    // false once a non-integer id, an id outside the WAMP range or a malformed payload was read
+    bool isValid() const
+    {
+        return !_invalid;
+    }
+    QString string(int i) const
+    {
+        if(i >= size()) return QString();
+        const char* data = _message.constData();
+        size_t offset = _offsets[i];
+        uchar type = uchar(data[offset++]);
+        quint64 length = 0;
+        if((type & 0xe0) == 0xa0) length = type & 0x1f;
+        else if(type >= 0xd9 && type <= 0xdb) readMsgpackLength(data, _offsets[i + 1], offset, 1 << (type - 0xd9), length);
+        else return QString();
+        return QString::fromUtf8(data + offset, int(length));
+    }
+    QVariantMap map(int i) const
+    {
+        msgpack::unpacked result;
+        if(!unpack(i, result) || result.get().type != msgpack::type::MAP) return QVariantMap();
+        return result.get().as<QVariantMap>();
+    }
+    QVariantList list(int i) const
+    {
+        msgpack::unpacked result;
+        if(!unpack(i, result) || result.get().type != msgpack::type::ARRAY) return QVariantList();
+        return result.get().as<QVariantList>();
+    }
+    bool hasPayload() const
+    {
+        return _passthrough;
+    }
+    WampPayload payload(int i) const
+    {
+        WampPayload payload;
+        payload.format = _format;
+        if(i >= size()) return payload;
+        payload.count = size() - i;
+        // the payload is forwarded unparsed, so its shape is checked from the lead bytes
+        if(payload.count > 2 || !isArray(leadByte(i)) || (payload.count == 2 && !isMap(leadByte(i + 1))))
+        {
+            _invalid = true;
+            return WampPayload();
+        }
+        payload.data = _message.mid(int(_offsets[i]), int(_offsets.last() - _offsets[i]));
+        return payload;
+    }
+private:
+    uchar leadByte(int i) const
+    {
+        return uchar(_message.at(int(_offsets[i])));
+    }
+    static bool isArray(uchar b)
+    {
+        return (b >= 0x90 && b <= 0x9f) || b == 0xdc || b == 0xdd;
+    }
+    static bool isMap(uchar b)
+    {
+        return (b >= 0x80 && b <= 0x8f) || b == 0xde || b == 0xdf;
+    }
+    bool unpack(int i, msgpack::unpacked& result) const
+    {
+        if(i >= size()) return false;
+        size_t offset = _offsets[i];
+        msgpack::unpack(result, _message.constData(), _offsets[i + 1], offset, nullptr, nullptr, _limit);
+        return true;
+    }
+    const QByteArray& _message;
+    bool _passthrough;
+    QString _format;
+    msgpack::unpack_limit _limit;
+    const WampDecodeLimits& _limits;
+    QVector<size_t> _offsets;
+    mutable bool _invalid;
+};
+
+class JsonReader
+{
+public:
+    // array holds at least the header elements; starts/ends locate all elements in message
+    // when the payload is passed through.
+    explicit JsonReader(const QJsonArray& array) : _array(array), _message(NULL), _starts(NULL), _ends(NULL),
+        _invalid(false)
+    {
+    }
+    JsonReader(const QJsonArray& array, const QByteArray& message, const QVector<int>& starts, const QVector<int>& ends) :
+        _array(array), _message(&message), _starts(&starts), _ends(&ends), _invalid(false)
+    {
+    }
+    int size() const
+    {
+        return _starts ? _starts->size() : _array.size();
+    }
+    qulonglong id(int i) const
+    {
+        if(i >= _array.size()) return 0;
+        if(!_array.at(i).isDouble())
+        {
+            _invalid = true;
+            return 0;
+        }
+        qulonglong id = 0;
+        if(!wampIdFromDouble(_array.at(i).toDouble(), id)) _invalid = true;
+        return id;
+    }
+    // false once a non-integer id, an id outside the WAMP range or a malformed payload was read
+    bool isValid() const
+    {
+        return !_invalid;
+    }
+    QString string(int i) const
+    {
+        return i < _array.size() ? _array.at(i).toString() : QString();
+    }
+    QVariantMap map(int i) const
+    {
+        return i < _array.size() ? fromJson(_array.at(i).toObject()) : QVariantMap();
+    }
+    QVariantList list(int i) const
+    {
+        return i < _array.size() ? fromJson(_array.at(i).toArray()) : QVariantList();
+    }
+    bool hasPayload() const
+    {
+        return _message != NULL;
+    }
+    WampPayload payload(int i) const
+    {
+        WampPayload payload;
+        payload.format = KEY_WAMP_JSON_SUB;
+        if(i >= size()) return payload;
+        payload.count = size() - i;
+        // the payload is forwarded unparsed, so its shape is checked from the lead characters
+        if(payload.count > 2 || _message->at(_starts->at(i)) != '[' ||
+           (payload.count == 2 && _message->at(_starts->at(i + 1)) != '{'))
+        {
+            _invalid = true;
+            return WampPayload();
+        }
+        payload.data = _message->mid(_starts->at(i), _ends->last() - _starts->at(i));
+        return payload;
+    }
+private:
+    const QJsonArray& _array;
+    const QByteArray* _message;
+    const QVector<int>* _starts;
+    const QVector<int>* _ends;
+    mutable bool _invalid;
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+// Same approach as MsgpackReader: element boundaries are located with one skipping pass
+// and each header element is read on demand.
+class CborReader
+{
+public:
+    CborReader(const QByteArray& message, bool passthrough, const WampDecodeLimits& limits) : _message(message),
+        _passthrough(passthrough), _limits(limits), _invalid(false)
+    {
+    }
+    bool parse()
+    {
+        if(_message.size() > _limits.maxFrameSize) return false;
+        QCborStreamReader reader(_message);
+        if(!reader.isArray() || !reader.enterContainer()) return false;
+        while(reader.hasNext())
+        {
+            if(_offsets.size() >= _limits.maxElements) return false;
+            _offsets.append(int(reader.currentOffset()));
+            if(!reader.next(_limits.maxDepth)) return false;
+        }
+        if(reader.lastError() != QCborError::NoError) return false;
+        _offsets.append(int(reader.currentOffset()));
+        return true;
+    }
+    int size() const
+    {
+        return _offsets.size() - 1;
+    }
+    qulonglong id(int i) const
+    {
+        QVariant value = element(i);
+        qulonglong id = 0;
+        switch((QMetaType::Type)value.type())
+        {
+        case QMetaType::ULongLong:
+            id = value.toULongLong();
+            if(id > MAX_WAMP_ID) _invalid = true;
+            break;
+        case QMetaType::LongLong:
+        case QMetaType::Int:
+            if(value.toLongLong() < 0 || value.toULongLong() > MAX_WAMP_ID) _invalid = true;
+            else id = value.toULongLong();
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            if(!wampIdFromDouble(value.toDouble(), id)) _invalid = true;
+            break;
+        default:
+            if(i < size()) _invalid = true;
+            break;
+        }
+        return _invalid ? 0 : id;
+    }
+    // false once a non-integer id, an id outside the WAMP range or a malformed payload was read
+    bool isValid() const
+    {
+        return !_invalid;
+    }
+    QString string(int i) const
+    {
+        return element(i).toString();
+    }
+    QVariantMap map(int i) const
+    {
+        return element(i).toMap();
+    }
+    QVariantList list(int i) const
+    {
+        return element(i).toList();
+    }
+    bool hasPayload() const
+    {
+        return _passthrough;
+    }
+    WampPayload payload(int i) const
+    {
+        WampPayload payload;
+        payload.format = KEY_WAMP_CBOR_SUB;
+        if(i >= size()) return payload;
+        payload.count = size() - i;
+        // the payload is forwarded unparsed, so its shape is checked from the major types
+        if(payload.count > 2 || majorType(i) != 4 || (payload.count == 2 && majorType(i + 1) != 5))
+        {
+            _invalid = true;
+            return WampPayload();
+        }
+        payload.data = _message.mid(_offsets[i], _offsets.last() - _offsets[i]);
+        return payload;
+    }
+private:
+    int majorType(int i) const
+    {
+        return uchar(_message.at(_offsets[i])) >> 5;
+    }
+    QVariant element(int i) const
+    {
+        QVariant value;
+        if(i >= size()) return value;
+        QCborStreamReader reader(_message.constData() + _offsets[i], _offsets[i + 1] - _offsets[i]);
+        CborValueReader valueReader(_limits);
+        if(!valueReader.read(reader, value, 1)) return QVariant();
+        return value;
+    }
+    const QByteArray& _message;
+    bool _passthrough;
+    const WampDecodeLimits& _limits;
+    QVector<int> _offsets;
+    mutable bool _invalid;
+};
+#endif
+
+// Builds the typed message for the layouts defined by the WAMP basic and advanced profiles.
+// Returns a null pointer when the message is too short for its type or the type is unknown.
+// Readers with a payload leave args/kwargs of CALL, YIELD and PUBLISH encoded in WampPayload.
+template<typename Reader>
+WampMessagePointer decodeFields(const Reader& r)
+{
+    if(r.size() < 2) return WampMessagePointer();
+    switch((WampMsgCode)r.id(0))
+    {
+    case WampMsgCode::HELLO:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<HelloMessage> msg = QSharedPointer<HelloMessage>::create();
+        msg->realm = r.string(1);
+        msg->details = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::WELCOME:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<WelcomeMessage> msg = QSharedPointer<WelcomeMessage>::create();
+        msg->sessionId = r.id(1);
+        msg->details = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::ABORT:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<AbortMessage> msg = QSharedPointer<AbortMessage>::create();
+        msg->details = r.map(1);
+        msg->reason = r.string(2);
+        return msg;
+    }
+    case WampMsgCode::CHALLENGE:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<ChallengeMessage> msg = QSharedPointer<ChallengeMessage>::create();
+        msg->authMethod = r.string(1);
+        msg->extra = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::AUTHENTICATE:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<AuthenticateMessage> msg = QSharedPointer<AuthenticateMessage>::create();
+        msg->signature = r.string(1).toUtf8();
+        msg->extra = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::GOODBYE:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<GoodbyeMessage> msg = QSharedPointer<GoodbyeMessage>::create();
+        msg->details = r.map(1);
+        msg->reason = r.string(2);
+        return msg;
+    }
+    case WampMsgCode::ERROR:
+    {
+        if(r.size() < 5) break;
+        QSharedPointer<ErrorMessage> msg = QSharedPointer<ErrorMessage>::create();
+        msg->requestType = int(r.id(1));
+        msg->requestId = r.id(2);
+        msg->details = r.map(3);
+        msg->error = r.string(4);
+        msg->args = r.list(5);
+        msg->kwargs = r.map(6);
+        return msg;
+    }
+    case WampMsgCode::PUBLISH:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<PublishMessage> msg = QSharedPointer<PublishMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        msg->topic = r.string(3);
+        if(r.hasPayload())
+        {
+            msg->payload = r.payload(4);
+            return msg;
+        }
+        msg->args = r.list(4);
+        msg->kwargs = r.map(5);
+        return msg;
+    }
+    case WampMsgCode::PUBLISHED:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<PublishedMessage> msg = QSharedPointer<PublishedMessage>::create();
+        msg->requestId = r.id(1);
+        msg->publicationId = r.id(2);
+        return msg;
+    }
+    case WampMsgCode::SUBSCRIBE:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<SubscribeMessage> msg = QSharedPointer<SubscribeMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        msg->topic = r.string(3);
+        return msg;
+    }
+    case WampMsgCode::SUBSCRIBED:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<SubscribedMessage> msg = QSharedPointer<SubscribedMessage>::create();
+        msg->requestId = r.id(1);
+        msg->subscriptionId = r.id(2);
+        return msg;
+    }
+    case WampMsgCode::UNSUBSCRIBE:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<UnsubscribeMessage> msg = QSharedPointer<UnsubscribeMessage>::create();
+        msg->requestId = r.id(1);
+        msg->subscriptionId = r.id(2);
+        return msg;
+    }
+    case WampMsgCode::UNSUBSCRIBED:
+    {
+        if(r.size() < 2) break;
+        QSharedPointer<UnsubscribedMessage> msg = QSharedPointer<UnsubscribedMessage>::create();
+        msg->requestId = r.id(1);
+        return msg;
+    }
+    case WampMsgCode::EVENT:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<EventMessage> msg = QSharedPointer<EventMessage>::create();
+        msg->subscriptionId = r.id(1);
+        msg->publicationId = r.id(2);
+        msg->details = r.map(3);
+        msg->args = r.list(4);
+        msg->kwargs = r.map(5);
+        return msg;
+    }
+    case WampMsgCode::CALL:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<CallMessage> msg = QSharedPointer<CallMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        msg->procedure = r.string(3);
+        if(r.hasPayload())
+        {
+            msg->payload = r.payload(4);
+            return msg;
+        }
+        msg->args = r.list(4);
+        msg->kwargs = r.map(5);
+        return msg;
+    }
+    case WampMsgCode::CANCEL:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<CancelMessage> msg = QSharedPointer<CancelMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::RESULT:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<ResultMessage> msg = QSharedPointer<ResultMessage>::create();
+        msg->requestId = r.id(1);
+        msg->details = r.map(2);
+        msg->args = r.list(3);
+        msg->kwargs = r.map(4);
+        return msg;
+    }
+    case WampMsgCode::REGISTER:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<RegisterMessage> msg = QSharedPointer<RegisterMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        msg->procedure = r.string(3);
+        return msg;
+    }
+    case WampMsgCode::REGISTERED:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<RegisteredMessage> msg = QSharedPointer<RegisteredMessage>::create();
+        msg->requestId = r.id(1);
+        msg->registrationId = r.id(2);
+        return msg;
+    }
+    case WampMsgCode::UNREGISTER:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<UnregisterMessage> msg = QSharedPointer<UnregisterMessage>::create();
+        msg->requestId = r.id(1);
+        msg->registrationId = r.id(2);
+        return msg;
+    }
+    case WampMsgCode::UNREGISTERED:
+    {
+        if(r.size() < 2) break;
+        QSharedPointer<UnregisteredMessage> msg = QSharedPointer<UnregisteredMessage>::create();
+        msg->requestId = r.id(1);
+        return msg;
+    }
+    case WampMsgCode::INVOCATION:
+    {
+        if(r.size() < 4) break;
+        QSharedPointer<InvocationMessage> msg = QSharedPointer<InvocationMessage>::create();
+        msg->requestId = r.id(1);
+        msg->registrationId = r.id(2);
+        msg->details = r.map(3);
+        msg->args = r.list(4);
+        msg->kwargs = r.map(5);
+        return msg;
+    }
+    case WampMsgCode::INTERRUPT:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<InterruptMessage> msg = QSharedPointer<InterruptMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        return msg;
+    }
+    case WampMsgCode::YIELD:
+    {
+        if(r.size() < 3) break;
+        QSharedPointer<YieldMessage> msg = QSharedPointer<YieldMessage>::create();
+        msg->requestId = r.id(1);
+        msg->options = r.map(2);
+        if(r.hasPayload())
+        {
+            msg->payload = r.payload(3);
+            return msg;
+        }
+        msg->args = r.list(3);
+        msg->kwargs = r.map(4);
+        return msg;
+    }
+    default:
+        break;
+    }
+    return WampMessagePointer();
+}
+// A message holding an out of range id or a malformed payload is rejected as a whole
+template<typename Reader>
+WampMessagePointer decodeMessage(const Reader& r)
+{
+    WampMessagePointer msg = decodeFields(r);
+    return r.isValid() ? msg : WampMessagePointer();
+}
+}
+
+namespace QFlow{
+
+WampMessagePointer toWampMessage(const QVariantList &message)
+{
+    return decodeMessage(VariantListReader(message));
+}
+WampMessageSerializer::WampMessageSerializer(QObject *parent) : QObject(parent)
+{
+
+}
+WampMessageSerializer::~WampMessageSerializer()
+{
+
+}
+WampDecodeLimits WampMessageSerializer::limits() const
+{
+    return _limits;
+}
+void WampMessageSerializer::setLimits(const WampDecodeLimits &limits)
+{
+    _limits = limits;
+}
+bool WampMessageSerializer::isBinary() const
+{
+    return false;
+}
+WampMessagePointer WampMessageSerializer::decode(const QByteArray &message, bool /*passthrough*/)
+{
+    QVariantList arr = deserialize(message);
+    return decodeMessage(VariantListReader(arr));
+}
+QString WampMessageSerializer::format() const
+{
+    return subprotocol();
+}
+bool WampMessageSerializer::setNativeTimestamps(bool /*enabled*/)
+{
+    return false;
+}
+WampMessageSerializer* WampMessageSerializer::create(const QString &name)
+{
+    if(name.endsWith(NATIVE_TIMESTAMPS_FORMAT_SUFFIX))
+    {
+        WampMessageSerializer* serializer = create(name.left(name.size() - NATIVE_TIMESTAMPS_FORMAT_SUFFIX.size()));
+        if(serializer) serializer->setNativeTimestamps(true);
+        return serializer;
+    }
+    if(name == KEY_WAMP_JSON_SUB) return new JsonMessageSerializer();
+    else if(name == KEY_WAMP_MSGPACK_SUB) return new MsgpackMessageSerializer();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    else if(name == KEY_WAMP_CBOR_SUB) return new CborMessageSerializer();
+#endif
+    return nullptr;
+}
+QStringList WampMessageSerializer::subprotocols()
+{
+    QStringList names;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    names.append(KEY_WAMP_CBOR_SUB);
+#endif
+    names.append(KEY_WAMP_MSGPACK_SUB);
+    names.append(KEY_WAMP_JSON_SUB);
+    return names;
+}
+
+JsonMessageSerializer::JsonMessageSerializer(QObject *parent) : WampMessageSerializer(parent),
+    _sizeHint(MIN_SIZE_HINT)
+{
+
+}
+JsonMessageSerializer::~JsonMessageSerializer()
+{
+
+}
+QVariantList JsonMessageSerializer::deserialize(const QByteArray &message)
+{
+    if(!checkJsonLimits(message, _limits)) return QVariantList();
+    QJsonDocument doc = QJsonDocument::fromJson(message);
+    return fromJson(doc.array());
+}
+WampMessagePointer JsonMessageSerializer::decode(const QByteArray &message, bool passthrough)
+{
+    if(!checkJsonLimits(message, _limits)) return WampMessagePointer();
+    if(passthrough)
+    {
+        QVector<int> starts, ends;
+        if(!scanJsonArray(message, starts, ends) || starts.isEmpty()) return WampMessagePointer();
+        int index = payloadIndex((WampMsgCode)message.mid(starts[0], ends[0] - starts[0]).toInt());
+        if(index > 0 && index <= starts.size())
+        {
+            // parse the header elements only; the payload stays as it came off the wire
+            QByteArray header = message.left(ends[index - 1]);
+            header.append(']');
+            QJsonDocument doc = QJsonDocument::fromJson(header);
+            if(!doc.isArray()) return WampMessagePointer();
+            QJsonArray arr = doc.array();
+            return decodeMessage(JsonReader(arr, message, starts, ends));
+        }
+    }
+    QJsonDocument doc = QJsonDocument::fromJson(message);
+    if(!doc.isArray()) return WampMessagePointer();
+    QJsonArray arr = doc.array();
+    return decodeMessage(JsonReader(arr));
+}
+QVariantList JsonMessageSerializer::deserializePayload(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray json;
+    json.reserve(payload.data.size() + 2);
+    json.append('[');
+    json.append(payload.data);
+    json.append(']');
+    return fromJson(QJsonDocument::fromJson(json).array());
+}
+QByteArray JsonMessageSerializer::serialize(const QVariantList &arr)
+{
+    QByteArray message;
+    message.reserve(_sizeHint);
+    JsonWriter writer(message);
+    writer.write(arr);
+    _sizeHint = qBound(MIN_SIZE_HINT, message.size(), MAX_SIZE_HINT);
+    return message;
+}
+WampPayload JsonMessageSerializer::serializePayload(const QVariantList &elements)
+{
+    WampPayload payload;
+    payload.format = format();
+    payload.count = elements.size();
+    JsonWriter writer(payload.data);
+    writer.writeElements(elements);
+    return payload;
+}
+QByteArray JsonMessageSerializer::serialize(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT + payload.data.size());
+    JsonWriter writer(message);
+    message.append('[');
+    writer.writeElements(head);
+    if(payload.count > 0)
+    {
+        if(!head.isEmpty()) message.append(',');
+        message.append(payload.data);
+    }
+    message.append(']');
+    return message;
+}
+QByteArray JsonMessageSerializer::serializeHead(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT);
+    JsonWriter writer(message);
+    message.append('[');
+    writer.writeElements(head);
+    if(payload.count > 0 && !head.isEmpty()) message.append(',');
+    return message;
+}
+QByteArray JsonMessageSerializer::serializeTail(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(payload.data.size() + 1);
+    if(payload.count > 0) message.append(payload.data);
+    message.append(']');
+    return message;
+}
+QString JsonMessageSerializer::subprotocol() const
+{
+    return KEY_WAMP_JSON_SUB;
+}
+
+MsgpackMessageSerializer::MsgpackMessageSerializer(QObject *parent) : WampMessageSerializer(parent),
+    _sizeHint(MIN_SIZE_HINT), _nativeTimestamps(false)
+{
+
+}
+MsgpackMessageSerializer::~MsgpackMessageSerializer()
+{
+
+}
+QVariantList MsgpackMessageSerializer::deserialize(const QByteArray &message)
+{
+    if(message.size() > _limits.maxFrameSize) return QVariantList();
+    size_t offset = 0;
+    if(!MsgpackScanner(message.constData(), size_t(message.size()), _limits).skip(offset, 0)) return QVariantList();
+    try
+    {
+        msgpack::unpacked result;
+        offset = 0;
+        msgpack::unpack(result, message.constData(), size_t(message.size()), offset, nullptr, nullptr, unpackLimit(_limits));
+        msgpack::object deserialized = result.get();
+        if(deserialized.type != msgpack::type::ARRAY) return QVariantList();
+        return deserialized.as<QVariantList>();
+    }
+    catch(const std::exception& e)
+    {
+        qWarning() << "Could not deserialize msgpack message:" << e.what();
+        return QVariantList();
+    }
+}
+WampMessagePointer MsgpackMessageSerializer::decode(const QByteArray &message, bool passthrough)
+{
+    try
+    {
+        MsgpackReader reader(message, passthrough, format(), _limits);
+        if(!reader.parse()) return WampMessagePointer();
+        return decodeMessage(reader);
+    }
+    catch(const std::exception& e)
+    {
+        qWarning() << "Could not decode msgpack message:" << e.what();
+        return WampMessagePointer();
+    }
+}
+QByteArray MsgpackMessageSerializer::serialize(const QVariantList &arr)
+{
+    QByteArray message;
+    message.reserve(_sizeHint);
+    MsgpackWriter writer(message, _nativeTimestamps);
+    writer.write(arr);
+    _sizeHint = qBound(MIN_SIZE_HINT, message.size(), MAX_SIZE_HINT);
+    return message;
+}
+QVariantList MsgpackMessageSerializer::deserializePayload(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QVariantList elements;
+    size_t offset = 0;
+    msgpack::unpack_limit limit = unpackLimit(_limits);
+    try
+    {
+        for(int i=0; i<payload.count; i++)
+        {
+            msgpack::unpacked result;
+            msgpack::unpack(result, payload.data.constData(), size_t(payload.data.size()), offset, nullptr, nullptr, limit);
+            elements.append(result.get().as<QVariant>());
+        }
+    }
+    catch(const std::exception& e)
+    {
+        qWarning() << "Could not deserialize msgpack payload:" << e.what();
+    }
+    return elements;
+}
+WampPayload MsgpackMessageSerializer::serializePayload(const QVariantList &elements)
+{
+    WampPayload payload;
+    payload.format = format();
+    payload.count = elements.size();
+    MsgpackWriter writer(payload.data, _nativeTimestamps);
+    for(const QVariant& element: elements) writer.write(element);
+    return payload;
+}
+QByteArray MsgpackMessageSerializer::serialize(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT + payload.data.size());
+    MsgpackWriter writer(message, _nativeTimestamps);
+    writer.writeArrayHeader(head.size() + payload.count);
+    for(const QVariant& element: head) writer.write(element);
+    message.append(payload.data);
+    return message;
+}
+QByteArray MsgpackMessageSerializer::serializeHead(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT);
+    MsgpackWriter writer(message, _nativeTimestamps);
+    writer.writeArrayHeader(head.size() + payload.count);
+    for(const QVariant& element: head) writer.write(element);
+    return message;
+}
+QByteArray MsgpackMessageSerializer::serializeTail(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    return payload.data;
+}
+QString MsgpackMessageSerializer::subprotocol() const
+{
+    return KEY_WAMP_MSGPACK_SUB;
+}
+QString MsgpackMessageSerializer::format() const
+{
+    if(_nativeTimestamps) return subprotocol() + NATIVE_TIMESTAMPS_FORMAT_SUFFIX;
+    return subprotocol();
+}
+bool MsgpackMessageSerializer::setNativeTimestamps(bool enabled)
+{
+    _nativeTimestamps = enabled;
+    return true;
+}
+bool MsgpackMessageSerializer::isBinary() const
+{
+    return true;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+CborMessageSerializer::CborMessageSerializer(QObject *parent) : WampMessageSerializer(parent),
+    _sizeHint(MIN_SIZE_HINT)
+{
+
+}
+CborMessageSerializer::~CborMessageSerializer()
+{
+
+}
+QByteArray CborMessageSerializer::serialize(const QVariantList &arr)
+{
+    QByteArray message;
+    message.reserve(_sizeHint);
+    CborWriter writer(message);
+    writer.write(arr);
+    _sizeHint = qBound(MIN_SIZE_HINT, message.size(), MAX_SIZE_HINT);
+    return message;
+}
+QVariantList CborMessageSerializer::deserialize(const QByteArray &message)
+{
+    if(message.size() > _limits.maxFrameSize) return QVariantList();
+    QCborStreamReader reader(message);
+    QVariant value;
+    CborValueReader valueReader(_limits);
+    if(!valueReader.read(reader, value, 0)) return QVariantList();
+    return value.toList();
+}
+WampMessagePointer CborMessageSerializer::decode(const QByteArray &message, bool passthrough)
+{
+    CborReader reader(message, passthrough, _limits);
+    if(!reader.parse()) return WampMessagePointer();
+    return decodeMessage(reader);
+}
+WampPayload CborMessageSerializer::serializePayload(const QVariantList &elements)
+{
+    WampPayload payload;
+    payload.format = format();
+    payload.count = elements.size();
+    CborWriter writer(payload.data);
+    for(const QVariant& element: elements) writer.write(element);
+    return payload;
+}
+QVariantList CborMessageSerializer::deserializePayload(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QVariantList elements;
+    QCborStreamReader reader(payload.data);
+    CborValueReader valueReader(_limits);
+    for(int i=0; i<payload.count; i++)
+    {
+        QVariant element;
+        if(!valueReader.read(reader, element, 1)) break;
+        elements.append(element);
+    }
+    return elements;
+}
+QByteArray CborMessageSerializer::serialize(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT + payload.data.size());
+    // the header is written by hand as the stream writer insists on closing the arrays it opens
+    writeCborArrayHeader(message, quint64(head.size() + payload.count));
+    CborWriter writer(message);
+    for(const QVariant& element: head) writer.write(element);
+    message.append(payload.data);
+    return message;
+}
+QByteArray CborMessageSerializer::serializeHead(const QVariantList &head, const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    QByteArray message;
+    message.reserve(MIN_SIZE_HINT);
+    writeCborArrayHeader(message, quint64(head.size() + payload.count));
+    CborWriter writer(message);
+    for(const QVariant& element: head) writer.write(element);
+    return message;
+}
+QByteArray CborMessageSerializer::serializeTail(const WampPayload &payload)
+{
+    Q_ASSERT(payload.format == format());
+    return payload.data;
+}
+QString CborMessageSerializer::subprotocol() const
+{
+    return KEY_WAMP_CBOR_SUB;
+}
+bool CborMessageSerializer::isBinary() const
 {
     return true;
 }
+#endif
 }
@@ -3,10 +3,26 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QStringList>
 #include <QSharedPointer>
+#include "wampmessage.h"
 
 namespace QFlow{
 
+// Bounds on what a serializer decodes from a single frame. Frames exceeding them are
+// rejected as malformed instead of being unpacked.
+struct WampDecodeLimits
+{
+    WampDecodeLimits() : maxFrameSize(16 * 1024 * 1024), maxDepth(64), maxElements(1024 * 1024),
+        maxStringLength(16 * 1024 * 1024)
+    {
+    }
+    int maxFrameSize;       // bytes of the encoded frame
+    int maxDepth;           // nesting of arrays and maps, the message array itself is level 1
+    int maxElements;        // values in the whole frame, map keys included
+    int maxStringLength;    // bytes of a single string or binary
+};
+
 class WampMessageSerializer : public QObject
 {
 public:
@@ -14,8 +30,29 @@ public:
     virtual ~WampMessageSerializer();
     virtual QByteArray serialize(const QVariantList& arr) = 0;
     virtual QVariantList deserialize(const QByteArray& message) = 0;
+    // With passthrough, CALL, YIELD and PUBLISH keep their args/kwargs encoded in WampMessage payloads.
+    virtual WampMessagePointer decode(const QByteArray& message, bool passthrough = false);
+    virtual WampPayload serializePayload(const QVariantList& elements) = 0;
+    virtual QVariantList deserializePayload(const WampPayload& payload) = 0;
+    virtual QByteArray serialize(const QVariantList& head, const WampPayload& payload) = 0;
+    // serialize(head, payload) in two parts, head followed by tail on the wire. The tail only
+    // depends on the payload, so the frames of one publication can share it.
+    virtual QByteArray serializeHead(const QVariantList& head, const WampPayload& payload) = 0;
+    virtual QByteArray serializeTail(const WampPayload& payload) = 0;
+    virtual QString subprotocol() const = 0;
+    // Identifies the exact payload encoding: the subprotocol plus any negotiated options.
+    // Payloads are only spliced between serializers of the same format; create() accepts formats too.
+    virtual QString format() const;
+    // Switches QDateTime encoding to the format's native timestamp type, if it has an optional one.
+    virtual bool setNativeTimestamps(bool enabled);
     virtual bool isBinary() const;
+    WampDecodeLimits limits() const;
+    void setLimits(const WampDecodeLimits& limits);
     static WampMessageSerializer* create(const QString& name);
+    // Subprotocols of the available serializers, most efficient first.
+    static QStringList subprotocols();
+protected:
+    WampDecodeLimits _limits;
 };
 class JsonMessageSerializer : public WampMessageSerializer
 {
@@ -24,6 +61,15 @@ public:
     virtual ~JsonMessageSerializer();
     QByteArray serialize(const QVariantList& arr) override;
     QVariantList deserialize(const QByteArray& message) override;
+    WampMessagePointer decode(const QByteArray& message, bool passthrough = false) override;
+    WampPayload serializePayload(const QVariantList& elements) override;
+    QVariantList deserializePayload(const WampPayload& payload) override;
+    QByteArray serialize(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeHead(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeTail(const WampPayload& payload) override;
+    QString subprotocol() const override;
+private:
+    int _sizeHint;
 };
 
 class MsgpackMessageSerializer : public WampMessageSerializer
@@ -33,7 +79,40 @@ public:
     virtual ~MsgpackMessageSerializer();
     QByteArray serialize(const QVariantList& arr) override;
     QVariantList deserialize(const QByteArray& message) override;
+    WampMessagePointer decode(const QByteArray& message, bool passthrough = false) override;
+    WampPayload serializePayload(const QVariantList& elements) override;
+    QVariantList deserializePayload(const WampPayload& payload) override;
+    QByteArray serialize(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeHead(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeTail(const WampPayload& payload) override;
+    QString subprotocol() const override;
+    QString format() const override;
+    bool setNativeTimestamps(bool enabled) override;
+    bool isBinary() const Q_DECL_OVERRIDE;
+private:
+    int _sizeHint;
+    bool _nativeTimestamps;
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+class CborMessageSerializer : public WampMessageSerializer
+{
+public:
+    explicit CborMessageSerializer(QObject* parent = NULL);
+    virtual ~CborMessageSerializer();
+    QByteArray serialize(const QVariantList& arr) override;
+    QVariantList deserialize(const QByteArray& message) override;
+    WampMessagePointer decode(const QByteArray& message, bool passthrough = false) override;
+    WampPayload serializePayload(const QVariantList& elements) override;
+    QVariantList deserializePayload(const WampPayload& payload) override;
+    QByteArray serialize(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeHead(const QVariantList& head, const WampPayload& payload) override;
+    QByteArray serializeTail(const WampPayload& payload) override;
+    QString subprotocol() const override;
     bool isBinary() const Q_DECL_OVERRIDE;
+private:
+    int _sizeHint;
 };
+#endif
 }
 #endif // WAMPMESSAGESERIALIZER_H
@@ -0,0 +1,40 @@
+#include "wamptransport.h"
+
+namespace QFlow{
+
+WampTransport::WampTransport(QObject *parent) : QObject(parent)
+{
+}
+WampTransport::~WampTransport()
+{
+
+}
+void WampTransport::sendBatch(const QList<FrameBatcher::Frame> &frames)
+{
+    for(const FrameBatcher::Frame& frame: frames)
+    {
+        send(frame.joined(), frame.binary);
+    }
+}
+bool WampTransport::writesBatches() const
+{
+    return false;
+}
+PeerCredentials WampTransport::peerCredentials() const
+{
+    return PeerCredentials();
+}
+bool WampTransport::carriesMessages() const
+{
+    return false;
+}
+void WampTransport::sendMessage(const QVariantList &/*message*/)
+{
+}
+void WampTransport::setReadingPaused(bool /*paused*/)
+{
+}
+void WampTransport::open()
+{
+}
+}
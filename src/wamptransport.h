@@ -0,0 +1,64 @@
+#ifndef WAMPTRANSPORT_H
+#define WAMPTRANSPORT_H
+
+#include "framebatcher.h"
+#include <QObject>
+#include <QHostAddress>
+#include <QVariant>
+
+namespace QFlow{
+
+// Process on the other end of a local socket, as reported by the kernel (SO_PEERCRED)
+struct PeerCredentials
+{
+    PeerCredentials() : valid(false), pid(-1), uid(0), gid(0)
+    {
+    }
+    bool valid;
+    qint64 pid;
+    uint uid;
+    uint gid;
+};
+
+// Message based connection a WAMP session runs over. send(), sendBatch() and bytesToWrite()
+// may be called from any thread, the signals are emitted in the transport's thread.
+class WampTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WampTransport(QObject* parent = NULL);
+    virtual ~WampTransport();
+    virtual void send(const QByteArray& message, bool binary) = 0;
+    // Messages of one batch, transports that can write them at once override this.
+    // The default joins each frame's payload to its data and sends them one by one.
+    virtual void sendBatch(const QList<FrameBatcher::Frame>& frames);
+    // True when sendBatch() writes a batch at once. For other transports batching only adds
+    // latency, senders write to them directly.
+    virtual bool writesBatches() const;
+    // Bytes handed to the transport that did not reach the network yet
+    virtual qint64 bytesToWrite() const = 0;
+    // Serializer negotiated with the peer, valid once opened
+    virtual QString subprotocol() const = 0;
+    virtual QHostAddress peerAddress() const = 0;
+    // Only transports over Unix domain sockets know their peer's credentials
+    virtual PeerCredentials peerCredentials() const;
+    // In-process transports pass messages unserialized through sendMessage() and wampMessageReceived()
+    virtual bool carriesMessages() const;
+    virtual void sendMessage(const QVariantList& message);
+    // Stops delivering received messages until resumed, the peer is then held back by the
+    // transport's own flow control. Called in the transport's thread, the default ignores it.
+    virtual void setReadingPaused(bool paused);
+public Q_SLOTS:
+    // Client side: starts connecting, opened() follows once the peer accepted
+    virtual void open();
+    virtual void close() = 0;
+Q_SIGNALS:
+    void opened();
+    void closed();
+    // message may point into the transport's receive buffer, it is only valid during the emission
+    void messageReceived(const QByteArray& message);
+    void wampMessageReceived(const QVariantList& message);
+    void bytesWritten(qint64 bytes);
+};
+}
+#endif // WAMPTRANSPORT_H
@@ -0,0 +1,55 @@
+#include "websockettransport.h"
+#include "websocketconnection.h"
+
+namespace QFlow{
+
+WebSocketTransport::WebSocketTransport(WebSocketConnection *connection, QObject *parent) : WampTransport(parent),
+    _connection(connection)
+{
+    connectSignals();
+}
+WebSocketTransport::WebSocketTransport(const QUrl &url, const QStringList &subprotocols, QObject *parent) :
+    WampTransport(parent), _connection(new WebSocketConnection())
+{
+    _connection->setUri(url.url());
+    _connection->setRequestedSubprotocols(subprotocols);
+    connectSignals();
+}
+WebSocketTransport::~WebSocketTransport()
+{
+    if(_connection) _connection->deleteLater();
+}
+void WebSocketTransport::connectSignals()
+{
+    QObject::connect(_connection.data(), &WebSocketConnection::opened, this, &WampTransport::opened);
+    QObject::connect(_connection.data(), &WebSocketConnection::closed, this, &WampTransport::closed);
+    QObject::connect(_connection.data(), &WebSocketConnection::messageReceived, this, &WampTransport::messageReceived);
+    QObject::connect(_connection.data(), SIGNAL(bytesWritten(qint64)), this, SIGNAL(bytesWritten(qint64)));
+}
+void WebSocketTransport::send(const QByteArray &message, bool binary)
+{
+    if(!_connection) return;
+    if(binary) _connection->sendBinary(message);
+    else _connection->sendText(QString::fromUtf8(message));
+}
+qint64 WebSocketTransport::bytesToWrite() const
+{
+    return _connection ? _connection->bytesToWrite() : 0;
+}
+QString WebSocketTransport::subprotocol() const
+{
+    return _connection ? _connection->subprotocol() : QString();
+}
+QHostAddress WebSocketTransport::peerAddress() const
+{
+    return _connection ? _connection->peerAddress() : QHostAddress();
+}
+void WebSocketTransport::open()
+{
+    if(_connection) _connection->connect();
+}
+void WebSocketTransport::close()
+{
+    if(_connection) _connection->close();
+}
+}
@@ -0,0 +1,34 @@
+#ifndef WEBSOCKETTRANSPORT_H
+#define WEBSOCKETTRANSPORT_H
+
+#include "wamptransport.h"
+#include <QPointer>
+#include <QUrl>
+
+namespace QFlow{
+
+class WebSocketConnection;
+
+// WampTransport over a WebSocketConnection, one WebSocket message per WAMP message
+class WebSocketTransport : public WampTransport
+{
+    Q_OBJECT
+public:
+    // Server side, for a connection WebSocketServer accepted
+    explicit WebSocketTransport(WebSocketConnection* connection, QObject* parent = NULL);
+    // Client side, offering subprotocols in order of preference
+    WebSocketTransport(const QUrl& url, const QStringList& subprotocols, QObject* parent = NULL);
+    ~WebSocketTransport();
+    void send(const QByteArray& message, bool binary) override;
+    qint64 bytesToWrite() const override;
+    QString subprotocol() const override;
+    QHostAddress peerAddress() const override;
+public Q_SLOTS:
+    void open() override;
+    void close() override;
+private:
+    void connectSignals();
+    QPointer<WebSocketConnection> _connection;
+};
+}
+#endif // WEBSOCKETTRANSPORT_H